@@ -2,3 +2,9 @@ int openUrl( const char* url );
 int suspendScreensaving( Display* dpy, int suspend );
 int mailTo( const char* subject, const char* body, const char* to,
     const char* cc, const char* bcc, const char** attachments, int att_count );
+
+typedef struct DesktopSettings DesktopSettings;
+void initSettings( Display* dpy );
+void settingsEvent( XEvent* ev );
+const DesktopSettings* desktopSettings( Display* dpy );
+const char* findSetting( const DesktopSettings* settings, const char* key );
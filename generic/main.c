@@ -1,3 +1,4 @@
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -70,7 +71,16 @@ static int caps[] =
 /*    DAPI_COMMAND_MAILTO,*/
     DAPI_COMMAND_LOCALFILE,
     DAPI_COMMAND_UPLOADFILE,
-    DAPI_COMMAND_REMOVETEMPORARYLOCALFILE
+    DAPI_COMMAND_REMOVETEMPORARYLOCALFILE,
+    DAPI_COMMAND_STATS,
+    DAPI_COMMAND_SHAREDMEMORY,
+    DAPI_COMMAND_LOCALFILEFD,
+    DAPI_COMMAND_PROGRESSNOTIFICATIONS,
+    DAPI_COMMAND_TRANSFERPROGRESS,
+    DAPI_COMMAND_SUBSCRIBE,
+    DAPI_COMMAND_SCREENSAVERSUSPENDED,
+    DAPI_COMMAND_HANDSHAKE,
+    DAPI_COMMAND_GETSETTINGS
     };
 
 static void processCommandCapabilities( DapiConnection* conn, int seq )
@@ -86,6 +96,26 @@ static void processCommandCapabilities( DapiConnection* conn, int seq )
     capabilities.data = caps;
     dapi_writeReplyCapabilities( conn, seq, capabilities, 1 );
     }
+
+static void processCommandHandshake( DapiConnection* conn, int seq )
+    {
+    int client_version;
+    int client_features;
+    int version;
+    intarr capabilities;
+    if( !dapi_readCommandHandshake( conn, &client_version, &client_features ))
+        {
+        closeConnection( conn );
+        return;
+        }
+    debug( "Handshake %d: %d %d", dapi_socket( conn ), client_version, client_features );
+    version = client_version < DAPI_PROTOCOL_VERSION ? client_version : DAPI_PROTOCOL_VERSION;
+    capabilities.count = sizeof( caps ) / sizeof( caps[ 0 ] );
+    capabilities.data = caps;
+    dapi_writeReplyHandshake( conn, seq, version, 0, capabilities, 1 );
+    /* the following replies use the agreed encoding */
+    dapi_setProtocolVersion( conn, version );
+    }
     
 static void processCommandOpenUrl( DapiConnection* conn, int seq )
     {
@@ -116,6 +146,31 @@ static void processCommandButtonOrder( DapiConnection* conn, int seq )
     dapi_writeReplyButtonOrder( conn, seq, 1 );
     }
 
+static void processCommandGetSettings( DapiConnection* conn, int seq )
+    {
+    stringarr keys;
+    stringarr values;
+    const DesktopSettings* settings;
+    int i;
+    if( !dapi_readCommandGetSettings( conn, &keys ))
+        {
+        closeConnection( conn );
+        return;
+        }
+    debug( "Get settings %d: %d keys", dapi_socket( conn ), keys.count );
+    /* all values come from the same snapshot */
+    settings = desktopSettings( dpy );
+    values.count = keys.count;
+    values.data = malloc(( keys.count > 0 ? keys.count : 1 ) * sizeof( char* ));
+    for( i = 0;
+         i < keys.count;
+         ++i )
+        values.data[ i ] = ( char* ) findSetting( settings, keys.data[ i ] );
+    dapi_writeReplyGetSettings( conn, seq, values, 1 );
+    free( values.data );
+    dapi_freestringarr( keys );
+    }
+
 static void processCommandExecuteUrl( DapiConnection* conn, int seq )
     {
     char* url;
@@ -148,11 +203,24 @@ static void processCommandRunAsUser( DapiConnection* conn, int seq )
     dapi_freeWindowInfo( winfo );
     }
 
+static int suspend_count = 0;
+
+static void notifyScreensaverSuspended( void )
+    {
+    int i;
+    for( i = 0;
+         i < num_connections;
+         ++i )
+        if( connections[ i ] != NULL
+            && dapi_isSubscribed( connections[ i ], DAPI_COMMAND_SCREENSAVERSUSPENDED ))
+            dapi_writeReplyScreensaverSuspended( connections[ i ], 0, suspend_count > 0 );
+    }
+
 static void processCommandSuspendScreensaving( DapiConnection* conn, int seq )
     {
     int suspend;
     int ok;
-    static int suspend_count = 0;
+    int was_suspended = suspend_count > 0;
     if( !dapi_readCommandSuspendScreensaving( conn, &suspend ))
         {
         closeConnection( conn );
@@ -168,6 +236,19 @@ static void processCommandSuspendScreensaving( DapiConnection* conn, int seq )
         suspend_count = 0;
     ok = suspendScreensaving( dpy, suspend_count > 0 );
     dapi_writeReplySuspendScreensaving( conn, seq, ok ? 1 : 0 );
+    if( was_suspended != ( suspend_count > 0 ))
+        notifyScreensaverSuspended();
+    }
+
+static void processCommandScreensaverSuspended( DapiConnection* conn, int seq )
+    {
+    if( !dapi_readCommandScreensaverSuspended( conn ))
+        {
+        closeConnection( conn );
+        return;
+        }
+    debug( "Screensaver suspended %d", dapi_socket( conn ));
+    dapi_writeReplyScreensaverSuspended( conn, seq, suspend_count > 0 );
     }
 
 static void processCommandMailTo( DapiConnection* conn, int seq )
@@ -198,6 +279,16 @@ static void processCommandMailTo( DapiConnection* conn, int seq )
     dapi_freeWindowInfo( winfo );
     }
 
+static const char* localPath( const char* file )
+    {
+    if( file[ 0 ] == '/' )
+        return file;  /* is it already local */
+    else if( strncmp( file, "file:///", strlen( "file:///" )) == 0 )
+        return file + strlen( "file://" ); /* local url */
+    else
+        return NULL;
+    }
+
 static void processCommandLocalFile( DapiConnection* conn, int seq )
     {
     char* file;
@@ -211,18 +302,38 @@ static void processCommandLocalFile( DapiConnection* conn, int seq )
         return;
         }
     debug( "Local file %d: %s %s %d", dapi_socket( conn ), file, local, allow_download );
-    if( file[ 0 ] == '/' )
-        result = file;  /* is it already local */
-    else if( strncmp( file, "file:///", strlen( "file:///" )) == 0 )
-        result = file + strlen( "file://" ); /* local url */
-    else
-        result = NULL;
+    result = localPath( file );
     /* local is unused, no real downloading */
     dapi_writeReplyLocalFile( conn, seq, result );
     free( file );
     dapi_freeWindowInfo( winfo );
     }
 
+static void processCommandLocalFileFd( DapiConnection* conn, int seq )
+    {
+    char* file;
+    char* local;
+    int allow_download;
+    const char* result;
+    int fd = -1;
+    DapiWindowInfo winfo;
+    if( !dapi_readCommandLocalFileFd( conn, &file, &local, &allow_download, &winfo ))
+        {
+        closeConnection( conn );
+        return;
+        }
+    debug( "Local file fd %d: %s %s %d", dapi_socket( conn ), file, local, allow_download );
+    result = localPath( file );
+    if( result != NULL )
+        fd = open( result, O_RDONLY | O_CLOEXEC );
+    dapi_writeReplyLocalFileFd( conn, seq, fd >= 0 ? result : NULL, fd, fd >= 0 );
+    if( fd >= 0 )
+        close( fd );
+    free( file );
+    free( local );
+    dapi_freeWindowInfo( winfo );
+    }
+
 static void processCommandUploadFile( DapiConnection* conn, int seq )
     {
     char* local;
@@ -264,6 +375,78 @@ static void processCommandRemoveTemporaryLocalFile( DapiConnection* conn, int se
     }
 
 
+static void processCommandStats( DapiConnection* conn, int seq )
+    {
+    intarr stats;
+    if( !dapi_readCommandStats( conn ))
+        {
+        closeConnection( conn );
+        return;
+        }
+    debug( "Stats %d", dapi_socket( conn ));
+    stats = dapi_getStats();
+    dapi_writeReplyStats( conn, seq, stats, 1 );
+    dapi_freeintarr( stats );
+    }
+
+static void processCommandSharedMemory( DapiConnection* conn, int seq )
+    {
+    int threshold;
+    if( !dapi_readCommandSharedMemory( conn, &threshold ))
+        {
+        closeConnection( conn );
+        return;
+        }
+    debug( "Shared memory %d: %d", dapi_socket( conn ), threshold );
+    dapi_writeReplySharedMemory( conn, seq, dapi_setSharedMemoryThreshold( conn, threshold ));
+    }
+
+/* There are no real transfers, so there is never any progress to report. */
+static void processCommandProgressNotifications( DapiConnection* conn, int seq )
+    {
+    int interval;
+    if( !dapi_readCommandProgressNotifications( conn, &interval ))
+        {
+        closeConnection( conn );
+        return;
+        }
+    debug( "Progress notifications %d: %d", dapi_socket( conn ), interval );
+    dapi_writeReplyProgressNotifications( conn, seq, 1 );
+    }
+
+static void processCommandTransferProgress( DapiConnection* conn, int seq )
+    {
+    int transfer;
+    if( !dapi_readCommandTransferProgress( conn, &transfer ))
+        {
+        closeConnection( conn );
+        return;
+        }
+    debug( "Transfer progress %d: %d", dapi_socket( conn ), transfer );
+    dapi_writeReplyTransferProgress( conn, seq, NULL, 0, 0, 0, 0 );
+    }
+
+static void processCommandSubscribe( DapiConnection* conn, int seq )
+    {
+    intarr events;
+    int ok = 1;
+    int i;
+    if( !dapi_readCommandSubscribe( conn, &events ))
+        {
+        closeConnection( conn );
+        return;
+        }
+    debug( "Subscribe %d: %d events", dapi_socket( conn ), events.count );
+    for( i = 0;
+         i < events.count;
+         ++i )
+        if( events.data[ i ] != DAPI_COMMAND_SCREENSAVERSUSPENDED )
+            ok = 0; /* no address book */
+    dapi_setSubscriptions( conn, events );
+    dapi_writeReplySubscribe( conn, seq, ok );
+    dapi_freeintarr( events );
+    }
+
 static void processCommand( DapiConnection* conn )
     {
     int command;
@@ -282,6 +465,9 @@ static void processCommand( DapiConnection* conn )
         case DAPI_COMMAND_CAPABILITIES:
             processCommandCapabilities( conn, seq );
             return;
+        case DAPI_COMMAND_HANDSHAKE:
+            processCommandHandshake( conn, seq );
+            return;
         case DAPI_COMMAND_OPENURL:
             processCommandOpenUrl( conn, seq );
             return;
@@ -303,22 +489,73 @@ static void processCommand( DapiConnection* conn )
         case DAPI_COMMAND_LOCALFILE:
             processCommandLocalFile( conn, seq );
             return;
+        case DAPI_COMMAND_LOCALFILEFD:
+            processCommandLocalFileFd( conn, seq );
+            return;
         case DAPI_COMMAND_UPLOADFILE:
             processCommandUploadFile( conn, seq );
             return;
         case DAPI_COMMAND_REMOVETEMPORARYLOCALFILE:
             processCommandRemoveTemporaryLocalFile( conn, seq );
             return;
+        case DAPI_COMMAND_STATS:
+            processCommandStats( conn, seq );
+            return;
+        case DAPI_COMMAND_SHAREDMEMORY:
+            processCommandSharedMemory( conn, seq );
+            return;
+        case DAPI_COMMAND_PROGRESSNOTIFICATIONS:
+            processCommandProgressNotifications( conn, seq );
+            return;
+        case DAPI_COMMAND_TRANSFERPROGRESS:
+            processCommandTransferProgress( conn, seq );
+            return;
+        case DAPI_COMMAND_SUBSCRIBE:
+            processCommandSubscribe( conn, seq );
+            return;
+        case DAPI_COMMAND_SCREENSAVERSUSPENDED:
+            processCommandScreensaverSuspended( conn, seq );
+            return;
+        case DAPI_COMMAND_GETSETTINGS:
+            processCommandGetSettings( conn, seq );
+            return;
         default:
             debug( "Unknown command %d: %d", dapi_socket( conn ), command );
             return;
         }
     }
 
+static void processXEvents( void )
+    {
+    while( XPending( dpy ))
+        {
+        XEvent ev;
+        XNextEvent( dpy, &ev );
+        settingsEvent( &ev );
+        }
+    }
+
+/* Processes all complete commands received so far, the rest waits for more data. */
+static void processData( int pos )
+    {
+    DapiConnection* conn = connections[ pos ];
+    int ok = dapi_receiveData( conn );
+    /* the replies to all the commands are sent together */
+    dapi_beginBatch( conn );
+    /* connections[ pos ] is reset if the connection gets closed */
+    while( connections[ pos ] == conn && dapi_hasCommand( conn ))
+        processCommand( conn );
+    if( connections[ pos ] == conn && !dapi_endBatch( conn ))
+        ok = 0;
+    if( !ok && connections[ pos ] == conn )
+        closeConnection( conn );
+    }
+
 int main( int argc, char* argv[] )
     {
     int i;
     int mainsock;
+    int idle_timeout;
     dpy = XOpenDisplay( NULL );
     if( dpy == NULL )
         {
@@ -328,10 +565,19 @@ int main( int argc, char* argv[] )
     mainsock = dapi_bindSocket();
     if( mainsock < 0 )
         return 2;
+    initSettings( dpy );
+    idle_timeout = dapi_idleTimeout();
     for(;;)
         {
         fd_set in;
+        fd_set out;
+        int active = 0;
+        int ready;
+        /* replies to requests made while handling commands (e.g. the XSync
+           in readXSettings()) may have queued events, select() wouldn't see them */
+        processXEvents();
         FD_ZERO( &in );
+        FD_ZERO( &out );
         FD_SET( mainsock, &in );
         int maxsock = mainsock;
         for( i = 0;
@@ -341,27 +587,45 @@ int main( int argc, char* argv[] )
                 {
                 int sock = dapi_socket( connections[ i ] );
                 FD_SET( sock, &in );
+                if( dapi_hasUnsentData( connections[ i ] ))
+                    FD_SET( sock, &out );
                 if( sock > maxsock )
                     maxsock = sock;
+                ++active;
                 }
         FD_SET( XConnectionNumber( dpy ), &in );
         if( XConnectionNumber( dpy ) > maxsock )
             maxsock = XConnectionNumber( dpy );
-        select( maxsock + 1, &in, NULL, NULL, NULL );
-        if( FD_ISSET( XConnectionNumber( dpy ), &in ))
+        /* exit when idle, the daemon gets started again when needed */
+        if( idle_timeout > 0 && active == 0 && suspend_count == 0 )
             {
-            while( XPending( dpy ))
+            struct timeval timeout;
+            timeout.tv_sec = idle_timeout / 1000;
+            timeout.tv_usec = idle_timeout % 1000 * 1000;
+            ready = select( maxsock + 1, &in, &out, NULL, &timeout );
+            if( ready == 0 )
                 {
-                XEvent ev;
-                XNextEvent( dpy, &ev );
+                debug( "Exiting after %d ms without clients", idle_timeout );
+                return 0;
                 }
             }
+        else
+            ready = select( maxsock + 1, &in, &out, NULL, NULL );
+        if( ready < 0 )
+            continue;
+        if( FD_ISSET( XConnectionNumber( dpy ), &in ))
+            processXEvents();
         for( i = 0;
              i < num_connections;
              ++i )
             {
+            if( connections[ i ] != NULL && FD_ISSET( dapi_socket( connections[ i ] ), &out ))
+                {
+                if( !dapi_sendData( connections[ i ] ))
+                    closeConnection( connections[ i ] );
+                }
             if( connections[ i ] != NULL && FD_ISSET( dapi_socket( connections[ i ] ), &in ))
-                processCommand( connections[ i ] );
+                processData( i );
             }
         if( FD_ISSET( mainsock, &in ))
             {
@@ -0,0 +1,330 @@
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+
+#include "commands.h"
+
+/* Desktop settings for GetSettings, taken from the XSETTINGS manager
+   (see the XSETTINGS specification at freedesktop.org) or, if there's none
+   running, from the GTK settings.ini. The current settings are kept as
+   an immutable snapshot that is replaced as a whole when they change, so
+   one reply never mixes old and new values. */
+
+typedef struct Setting
+    {
+    char* name;
+    char* value;
+    } Setting;
+
+struct DesktopSettings
+    {
+    Setting* settings; /* sorted by name */
+    int count;
+    };
+
+static DesktopSettings* snapshot = NULL;
+static int snapshot_valid = 0;
+static Atom selection_atom = None;
+static Atom settings_atom = None;
+static Atom manager_atom = None;
+static Window manager = None;
+static char settings_file[ 1024 ];
+static time_t settings_file_mtime = 0;
+
+/* settings.ini keys and their XSETTINGS names */
+static const char* const gtk_keys[][ 2 ] =
+    {
+    { "gtk-double-click-time", "Net/DoubleClickTime" },
+    { "gtk-dnd-drag-threshold", "Net/DndDragThreshold" },
+    { "gtk-cursor-blink", "Net/CursorBlink" },
+    { "gtk-cursor-blink-time", "Net/CursorBlinkTime" },
+    { "gtk-theme-name", "Net/ThemeName" },
+    { "gtk-icon-theme-name", "Net/IconThemeName" },
+    { "gtk-font-name", "Gtk/FontName" }
+    };
+
+static int compareSettings( const void* s1, const void* s2 )
+    {
+    return strcmp((( const Setting* ) s1 )->name, (( const Setting* ) s2 )->name );
+    }
+
+/* A repeated key replaces the earlier value, the snapshot must have unique
+   names for bsearch(). */
+static void addSetting( DesktopSettings* settings, const char* name, int name_len,
+    const char* value, int value_len )
+    {
+    Setting* s = NULL;
+    int i;
+    for( i = 0;
+         i < settings->count;
+         ++i )
+        if( strncmp( settings->settings[ i ].name, name, name_len ) == 0
+            && settings->settings[ i ].name[ name_len ] == '\0' )
+            {
+            s = &settings->settings[ i ];
+            free( s->value );
+            break;
+            }
+    if( s == NULL )
+        {
+        settings->settings = realloc( settings->settings, ( settings->count + 1 ) * sizeof( Setting ));
+        s = &settings->settings[ settings->count++ ];
+        s->name = malloc( name_len + 1 );
+        memcpy( s->name, name, name_len );
+        s->name[ name_len ] = '\0';
+        }
+    s->value = malloc( value_len + 1 );
+    memcpy( s->value, value, value_len );
+    s->value[ value_len ] = '\0';
+    }
+
+static void freeSettings( DesktopSettings* settings )
+    {
+    int i;
+    if( settings == NULL )
+        return;
+    for( i = 0;
+         i < settings->count;
+         ++i )
+        {
+        free( settings->settings[ i ].name );
+        free( settings->settings[ i ].value );
+        }
+    free( settings->settings );
+    free( settings );
+    }
+
+static unsigned int card16( const unsigned char* data, int msb_first )
+    {
+    return msb_first ? ( data[ 0 ] << 8 ) | data[ 1 ] : ( data[ 1 ] << 8 ) | data[ 0 ];
+    }
+
+static unsigned int card32( const unsigned char* data, int msb_first )
+    {
+    if( msb_first )
+        return (( unsigned int ) data[ 0 ] << 24 ) | ( data[ 1 ] << 16 ) | ( data[ 2 ] << 8 ) | data[ 3 ];
+    return (( unsigned int ) data[ 3 ] << 24 ) | ( data[ 2 ] << 16 ) | ( data[ 1 ] << 8 ) | data[ 0 ];
+    }
+
+/* Parses the _XSETTINGS_SETTINGS property, returns 0 if it's malformed. */
+static int parseXSettings( DesktopSettings* settings, const unsigned char* data, unsigned long size )
+    {
+    unsigned long pos = 12;
+    unsigned int count;
+    unsigned int i;
+    int msb_first;
+    if( size < 12 )
+        return 0;
+    msb_first = data[ 0 ] == MSBFirst;
+    count = card32( data + 8, msb_first );
+    for( i = 0;
+         i < count;
+         ++i )
+        {
+        char value[ 64 ];
+        int type;
+        unsigned int name_len;
+        unsigned int len;
+        const unsigned char* name;
+        if( pos + 4 > size )
+            return 0;
+        type = data[ pos ];
+        name_len = card16( data + pos + 2, msb_first );
+        name = data + pos + 4;
+        /* name padded to 4 bytes, then the serial of the last change */
+        pos += 4 + (( name_len + 3 ) & ~3U ) + 4;
+        if( pos > size )
+            return 0;
+        switch( type )
+            {
+            case 0: /* integer */
+                if( pos + 4 > size )
+                    return 0;
+                len = snprintf( value, sizeof( value ), "%d", ( int ) card32( data + pos, msb_first ));
+                addSetting( settings, ( const char* ) name, name_len, value, len );
+                pos += 4;
+                break;
+            case 1: /* string */
+                if( pos + 4 > size )
+                    return 0;
+                len = card32( data + pos, msb_first );
+                if( len > size - pos - 4 )
+                    return 0;
+                addSetting( settings, ( const char* ) name, name_len, ( const char* ) data + pos + 4, len );
+                pos += 4 + (( len + 3 ) & ~3U );
+                break;
+            case 2: /* color */
+                if( pos + 8 > size )
+                    return 0;
+                len = snprintf( value, sizeof( value ), "%u,%u,%u,%u", card16( data + pos, msb_first ),
+                    card16( data + pos + 2, msb_first ), card16( data + pos + 4, msb_first ),
+                    card16( data + pos + 6, msb_first ));
+                addSetting( settings, ( const char* ) name, name_len, value, len );
+                pos += 8;
+                break;
+            default:
+                return 0;
+            }
+        }
+    return 1;
+    }
+
+static int ignoreErrors( Display* dpy, XErrorEvent* ev )
+    {
+    ( void ) dpy;
+    ( void ) ev;
+    return 0;
+    }
+
+/* The manager window may be destroyed at any time, so errors are ignored. */
+static int readXSettings( Display* dpy, DesktopSettings* settings )
+    {
+    XErrorHandler old_handler;
+    Atom type;
+    int format;
+    unsigned long size;
+    unsigned long after;
+    unsigned char* data = NULL;
+    int ok = 0;
+    XGrabServer( dpy );
+    manager = XGetSelectionOwner( dpy, selection_atom );
+    if( manager != None )
+        {
+        old_handler = XSetErrorHandler( ignoreErrors );
+        XSelectInput( dpy, manager, PropertyChangeMask | StructureNotifyMask );
+        if( XGetWindowProperty( dpy, manager, settings_atom, 0, 0x7fffffff, False, settings_atom,
+                &type, &format, &size, &after, &data ) == Success
+            && type == settings_atom && format == 8 )
+            ok = parseXSettings( settings, data, size );
+        XSync( dpy, False );
+        XSetErrorHandler( old_handler );
+        if( data != NULL )
+            XFree( data );
+        }
+    XUngrabServer( dpy );
+    XFlush( dpy );
+    return ok;
+    }
+
+static void readSettingsFile( DesktopSettings* settings )
+    {
+    char line[ 1024 ];
+    int in_settings = 0;
+    FILE* f = fopen( settings_file, "r" );
+    if( f == NULL )
+        return;
+    while( fgets( line, sizeof( line ), f ) != NULL )
+        {
+        char* key = line;
+        char* value;
+        char* end;
+        unsigned int i;
+        while( *key == ' ' || *key == '\t' )
+            ++key;
+        if( *key == '[' )
+            {
+            in_settings = strncmp( key, "[Settings]", 10 ) == 0;
+            continue;
+            }
+        value = strchr( key, '=' );
+        if( !in_settings || value == NULL || *key == '#' )
+            continue;
+        for( end = value;
+             end > key && ( end[ -1 ] == ' ' || end[ -1 ] == '\t' );
+             --end )
+            ;
+        *end = '\0';
+        ++value;
+        while( *value == ' ' || *value == '\t' )
+            ++value;
+        for( end = value + strlen( value );
+             end > value && ( end[ -1 ] == '\n' || end[ -1 ] == ' ' || end[ -1 ] == '\t' );
+             --end )
+            ;
+        if( end - value >= 2 && *value == '"' && end[ -1 ] == '"' )
+            {
+            ++value;
+            --end;
+            }
+        for( i = 0;
+             i < sizeof( gtk_keys ) / sizeof( gtk_keys[ 0 ] );
+             ++i )
+            if( strcmp( gtk_keys[ i ][ 0 ], key ) == 0 )
+                addSetting( settings, gtk_keys[ i ][ 1 ], strlen( gtk_keys[ i ][ 1 ] ), value, end - value );
+        }
+    fclose( f );
+    }
+
+static time_t settingsFileMtime( void )
+    {
+    struct stat st;
+    return stat( settings_file, &st ) == 0 ? st.st_mtime : 0;
+    }
+
+void initSettings( Display* dpy )
+    {
+    char name[ 64 ];
+    const char* config = getenv( "XDG_CONFIG_HOME" );
+    snprintf( name, sizeof( name ), "_XSETTINGS_S%d", DefaultScreen( dpy ));
+    selection_atom = XInternAtom( dpy, name, False );
+    settings_atom = XInternAtom( dpy, "_XSETTINGS_SETTINGS", False );
+    manager_atom = XInternAtom( dpy, "MANAGER", False );
+    /* a new manager announces itself with a MANAGER client message to the root window */
+    XSelectInput( dpy, DefaultRootWindow( dpy ), StructureNotifyMask );
+    if( config != NULL && config[ 0 ] != '\0' )
+        snprintf( settings_file, sizeof( settings_file ), "%s/gtk-3.0/settings.ini", config );
+    else
+        snprintf( settings_file, sizeof( settings_file ), "%s/.config/gtk-3.0/settings.ini",
+            getenv( "HOME" ) != NULL ? getenv( "HOME" ) : "" );
+    }
+
+void settingsEvent( XEvent* ev )
+    {
+    if( ev->type == ClientMessage && ev->xclient.message_type == manager_atom
+        && ( Atom ) ev->xclient.data.l[ 1 ] == selection_atom )
+        snapshot_valid = 0;
+    else if( ev->type == PropertyNotify && ev->xproperty.window == manager
+        && ev->xproperty.atom == settings_atom )
+        snapshot_valid = 0;
+    else if( ev->type == DestroyNotify && manager != None && ev->xdestroywindow.window == manager )
+        snapshot_valid = 0;
+    }
+
+const DesktopSettings* desktopSettings( Display* dpy )
+    {
+    DesktopSettings* settings;
+    /* without a manager there are no events, the file is checked every time */
+    if( snapshot_valid && manager == None && settingsFileMtime() != settings_file_mtime )
+        snapshot_valid = 0;
+    if( snapshot_valid )
+        return snapshot;
+    settings = calloc( 1, sizeof( DesktopSettings ));
+    if( !readXSettings( dpy, settings ))
+        {
+        freeSettings( settings );
+        settings = calloc( 1, sizeof( DesktopSettings ));
+        settings_file_mtime = settingsFileMtime();
+        readSettingsFile( settings );
+        }
+    addSetting( settings, "Dapi/ButtonOrder", strlen( "Dapi/ButtonOrder" ), "1", 1 );
+    qsort( settings->settings, settings->count, sizeof( Setting ), compareSettings );
+    freeSettings( snapshot );
+    snapshot = settings;
+    snapshot_valid = 1;
+    return snapshot;
+    }
+
+const char* findSetting( const DesktopSettings* settings, const char* key )
+    {
+    Setting s;
+    const Setting* found;
+    s.name = ( char* ) key;
+    found = bsearch( &s, settings->settings, settings->count, sizeof( Setting ), compareSettings );
+    return found != NULL ? found->value : "";
+    }
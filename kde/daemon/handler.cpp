@@ -6,25 +6,75 @@
 #include "kabchandler.h"
 
 #include <dcopref.h>
+#include <qfile.h>
+#include <qfileinfo.h>
 #include <qsocketnotifier.h>
+#include <qtimer.h>
 #include <kapplication.h>
 #include <kdebug.h>
+#include <kconfig.h>
+#include <kglobal.h>
 #include <kglobalsettings.h>
+#include <kicontheme.h>
+#include <kipc.h>
 #include <kio/netaccess.h>
 #include <kprocess.h>
 #include <krun.h>
 #include <stdlib.h>
 #include <ktempfile.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <X11/Xlib.h>
 #ifdef HAVE_DPMS
 #include <X11/extensions/dpms.h>
 #endif
 
-KDapiHandler::KDapiHandler()
+KDapiHandler::KDapiHandler( int timeout )
+    : kabchandler( NULL ), screensaver_suspended( false ), idle_timeout( timeout ), button_order( 0 )
     {
+    idle_timer = new QTimer( this );
+    connect( idle_timer, SIGNAL( timeout()), SLOT( idleTimeout()));
+    export_timer = new QTimer( this );
+    connect( export_timer, SIGNAL( timeout()), SLOT( continueExports()));
+    // settings replies are cached until the settings change
+    kapp->addKipcEventMask( KIPC::SettingsChanged );
+    kapp->addKipcEventMask( KIPC::IconChanged );
+    connect( kapp, SIGNAL( settingsChanged( int )), SLOT( settingsChanged()));
+    connect( kapp, SIGNAL( kdisplayStyleChanged()), SLOT( settingsChanged()));
+    connect( kapp, SIGNAL( kdisplayFontChanged()), SLOT( settingsChanged()));
+    connect( kapp, SIGNAL( iconChanged( int )), SLOT( settingsChanged()));
     setupSocket();
-    kabchandler = new KABCHandler(this);
+    updateIdleTimer();
+    }
+
+// Loading all address book resources is expensive and many sessions never use
+// the address book, so it is loaded only when a client needs it.
+KABCHandler* KDapiHandler::addressBook()
+    {
+    if( kabchandler == NULL )
+        {
+        kabchandler = new KABCHandler( this );
+        connect( kabchandler, SIGNAL( changed( int, const QStringList& )),
+            SLOT( addressBookChanged( int, const QStringList& )));
+        }
+    return kabchandler;
+    }
+
+void KDapiHandler::updateIdleTimer()
+    {
+    if( idle_timeout > 0 && connections.isEmpty() && transfers.isEmpty())
+        idle_timer->start( idle_timeout, true );
+    else
+        idle_timer->stop();
+    }
+
+void KDapiHandler::idleTimeout()
+    {
+    if( !connections.isEmpty() || !transfers.isEmpty())
+        return;
+    kdDebug() << "Exiting after " << idle_timeout << " ms without clients" << endl;
+    kapp->quit();
     }
 
 KDapiHandler::~KDapiHandler()
@@ -51,20 +101,74 @@ void KDapiHandler::processMainSocketData()
     data.conn = conn;
     data.notifier = new QSocketNotifier( dapi_socket( data.conn ), QSocketNotifier::Read, this );
     connect( data.notifier, SIGNAL( activated( int )), SLOT( processSocketData( int )));
+    // enabled only while there are replies that couldn't be sent immediately
+    data.write_notifier = new QSocketNotifier( dapi_socket( data.conn ), QSocketNotifier::Write, this );
+    data.write_notifier->setEnabled( false );
+    connect( data.write_notifier, SIGNAL( activated( int )), SLOT( sendSocketData( int )));
     data.screensaver_suspend = false;
+    data.progress_interval = 0;
     connections.append( data );
+    updateIdleTimer();
     }
 
-void KDapiHandler::processSocketData( int sock )
+KDapiHandler::ConnectionList::Iterator KDapiHandler::findConnection( int sock )
     {
     for( ConnectionList::Iterator it = connections.begin();
          it != connections.end();
          ++it )
         if( dapi_socket((*it).conn ) == sock )
-            {
-            processCommand( *it );
-            break;
-            }
+            return it;
+    return connections.end();
+    }
+
+void KDapiHandler::processSocketData( int sock )
+    {
+    ConnectionList::Iterator it = findConnection( sock );
+    if( it == connections.end())
+        return;
+    bool ok = dapi_receiveData( (*it).conn );
+    // the replies to all the commands are sent together
+    dapi_beginBatch( (*it).conn );
+    // only complete commands are processed, the rest waits for more data
+    while( dapi_hasCommand( (*it).conn ))
+        {
+        processCommand( *it );
+        // the connection may have been closed
+        it = findConnection( sock );
+        if( it == connections.end())
+            return;
+        }
+    if( !dapi_endBatch( (*it).conn ))
+        ok = false;
+    if( !ok )
+        {
+        closeSocket( *it );
+        return;
+        }
+    updateWriteNotifiers();
+    }
+
+void KDapiHandler::sendSocketData( int sock )
+    {
+    ConnectionList::Iterator it = findConnection( sock );
+    if( it == connections.end())
+        return;
+    if( !dapi_sendData( (*it).conn ))
+        {
+        closeSocket( *it );
+        return;
+        }
+    updateWriteNotifiers();
+    // the next vCard chunk is written once the previous one is sent
+    scheduleExports();
+    }
+
+void KDapiHandler::updateWriteNotifiers()
+    {
+    for( ConnectionList::Iterator it = connections.begin();
+         it != connections.end();
+         ++it )
+        (*it).write_notifier->setEnabled( dapi_hasUnsentData( (*it).conn ));
     }
 
 void KDapiHandler::processCommand( ConnectionData& conn )
@@ -84,6 +188,9 @@ void KDapiHandler::processCommand( ConnectionData& conn )
         case DAPI_COMMAND_CAPABILITIES:
             processCommandCapabilities( conn, seq );
             return;
+        case DAPI_COMMAND_HANDSHAKE:
+            processCommandHandshake( conn, seq );
+            return;
         case DAPI_COMMAND_OPENURL:
             processCommandOpenUrl( conn, seq );
             return;
@@ -105,6 +212,9 @@ void KDapiHandler::processCommand( ConnectionData& conn )
         case DAPI_COMMAND_LOCALFILE:
             processCommandLocalFile( conn, seq );
             return;
+        case DAPI_COMMAND_LOCALFILEFD:
+            processCommandLocalFileFd( conn, seq );
+            return;
         case DAPI_COMMAND_UPLOADFILE:
             processCommandUploadFile( conn, seq );
             return;
@@ -129,13 +239,44 @@ void KDapiHandler::processCommand( ConnectionData& conn )
         case DAPI_COMMAND_ADDRESSBOOKGETVCARD30:
             processCommandAddressBookGetVCard30( conn, seq );
             return;
+        case DAPI_COMMAND_STATS:
+            processCommandStats( conn, seq );
+            return;
+        case DAPI_COMMAND_SHAREDMEMORY:
+            processCommandSharedMemory( conn, seq );
+            return;
+        case DAPI_COMMAND_PROGRESSNOTIFICATIONS:
+            processCommandProgressNotifications( conn, seq );
+            return;
+        case DAPI_COMMAND_TRANSFERPROGRESS:
+            processCommandTransferProgress( conn, seq );
+            return;
+        case DAPI_COMMAND_SUBSCRIBE:
+            processCommandSubscribe( conn, seq );
+            return;
+        case DAPI_COMMAND_ADDRESSBOOKCHANGES:
+            processCommandAddressBookChanges( conn, seq );
+            return;
+        case DAPI_COMMAND_SCREENSAVERSUSPENDED:
+            processCommandScreensaverSuspended( conn, seq );
+            return;
+        case DAPI_COMMAND_GETSETTINGS:
+            processCommandGetSettings( conn, seq );
+            return;
+        case DAPI_COMMAND_ADDRESSBOOKEXPORTVCARD30:
+            processCommandAddressBookExportVCard30( conn, seq );
+            return;
+        case DAPI_COMMAND_ADDRESSBOOKFINDBYEMAIL:
+            processCommandAddressBookFindByEmail( conn, seq );
+            return;
         }
     }
 
 void KDapiHandler::closeSocket( ConnectionData& conn )
     {
-    dapi_close( conn.conn );
     delete conn.notifier;
+    delete conn.write_notifier;
+    dapi_close( conn.conn );
     for( ConnectionList::Iterator it = connections.begin();
          it != connections.end();
          ++it )
@@ -145,6 +286,7 @@ void KDapiHandler::closeSocket( ConnectionData& conn )
             break;
             }
     updateScreensaving();
+    updateIdleTimer();
     }
 
 void KDapiHandler::processCommandInit( ConnectionData& conn, int seq )
@@ -170,7 +312,19 @@ static int caps[] =
     DAPI_COMMAND_MAILTO,
     DAPI_COMMAND_LOCALFILE,
     DAPI_COMMAND_UPLOADFILE,
-    DAPI_COMMAND_REMOVETEMPORARYLOCALFILE
+    DAPI_COMMAND_REMOVETEMPORARYLOCALFILE,
+    DAPI_COMMAND_STATS,
+    DAPI_COMMAND_SHAREDMEMORY,
+    DAPI_COMMAND_LOCALFILEFD,
+    DAPI_COMMAND_PROGRESSNOTIFICATIONS,
+    DAPI_COMMAND_TRANSFERPROGRESS,
+    DAPI_COMMAND_SUBSCRIBE,
+    DAPI_COMMAND_ADDRESSBOOKCHANGES,
+    DAPI_COMMAND_SCREENSAVERSUSPENDED,
+    DAPI_COMMAND_HANDSHAKE,
+    DAPI_COMMAND_GETSETTINGS,
+    DAPI_COMMAND_ADDRESSBOOKEXPORTVCARD30,
+    DAPI_COMMAND_ADDRESSBOOKFINDBYEMAIL
     };
 
 void KDapiHandler::processCommandCapabilities( ConnectionData& conn, int seq )
@@ -186,6 +340,24 @@ void KDapiHandler::processCommandCapabilities( ConnectionData& conn, int seq )
     dapi_writeReplyCapabilities( conn.conn, seq, capabilities, 1 );
     }
 
+void KDapiHandler::processCommandHandshake( ConnectionData& conn, int seq )
+    {
+    int client_version;
+    int client_features;
+    intarr capabilities;
+    if( !dapi_readCommandHandshake( conn.conn, &client_version, &client_features ))
+        {
+        closeSocket( conn );
+        return;
+        }
+    int version = QMIN( client_version, int( DAPI_PROTOCOL_VERSION ));
+    capabilities.count = sizeof( caps ) / sizeof( caps[ 0 ] );
+    capabilities.data = caps;
+    dapi_writeReplyHandshake( conn.conn, seq, version, 0, capabilities, 1 );
+    // the following replies use the agreed encoding
+    dapi_setProtocolVersion( conn.conn, version );
+    }
+
 void KDapiHandler::processCommandOpenUrl( ConnectionData& conn, int seq )
     {
     char* url;
@@ -223,9 +395,71 @@ void KDapiHandler::processCommandButtonOrder( ConnectionData& conn, int seq )
         closeSocket( conn );
         return;
         }
-    int order = KGlobalSettings::buttonLayout();
-    // TODO KDE has actually more layouts, but I have no idea what they're supposed to mean
-    dapi_writeReplyButtonOrder( conn.conn, seq, order == 1 ? 2 : 1 );
+    dapi_writeReplyButtonOrder( conn.conn, seq, buttonOrder());
+    }
+
+int KDapiHandler::buttonOrder()
+    {
+    if( button_order == 0 )
+        {
+        int order = KGlobalSettings::buttonLayout();
+        // TODO KDE has actually more layouts, but I have no idea what they're supposed to mean
+        button_order = order == 1 ? 2 : 1;
+        }
+    return button_order;
+    }
+
+// The settings use the XSETTINGS names, so that dapi_generic can return
+// the same values from the XSETTINGS manager.
+const KDapiHandler::SettingsMap& KDapiHandler::desktopSettings()
+    {
+    if( !settings.isEmpty())
+        return settings;
+    SettingsMap snapshot;
+    snapshot[ "Dapi/ButtonOrder" ] = QCString().setNum( buttonOrder());
+    snapshot[ "Net/DoubleClickTime" ] = QCString().setNum( QApplication::doubleClickInterval());
+    snapshot[ "Net/DndDragThreshold" ] = QCString().setNum( KGlobalSettings::dndEventDelay());
+    snapshot[ "Net/CursorBlink" ] = QApplication::cursorFlashTime() > 0 ? "1" : "0";
+    snapshot[ "Net/CursorBlinkTime" ] = QCString().setNum( QApplication::cursorFlashTime());
+    KConfigGroup general( KGlobal::config(), "General" );
+    snapshot[ "Net/ThemeName" ] = general.readEntry( "widgetStyle" ).utf8();
+    snapshot[ "Net/IconThemeName" ] = KIconTheme::current().utf8();
+    QFont font = KGlobalSettings::generalFont();
+    snapshot[ "Gtk/FontName" ] = QString( "%1 %2" ).arg( font.family()).arg( font.pointSize()).utf8();
+    // replaced as a whole, one reply never mixes old and new values
+    settings = snapshot;
+    return settings;
+    }
+
+void KDapiHandler::processCommandGetSettings( ConnectionData& conn, int seq )
+    {
+    stringarr keys;
+    if( !dapi_readCommandGetSettings( conn.conn, &keys ))
+        {
+        closeSocket( conn );
+        return;
+        }
+    const SettingsMap& snapshot = desktopSettings();
+    stringarr values;
+    values.count = keys.count;
+    values.data = ( char** ) malloc( sizeof( char* ) * ( keys.count + 1 ));
+    for( int i = 0;
+         i < keys.count;
+         ++i )
+        {
+        SettingsMap::ConstIterator it = snapshot.find( QString::fromUtf8( keys.data[ i ] ));
+        // unknown settings are empty
+        values.data[ i ] = ( char* )( it != snapshot.end() ? (*it).data() : "" );
+        }
+    dapi_writeReplyGetSettings( conn.conn, seq, values, 1 );
+    free( values.data );
+    dapi_freestringarr( keys );
+    }
+
+void KDapiHandler::settingsChanged()
+    {
+    button_order = 0;
+    settings.clear();
     }
 
 void KDapiHandler::processCommandRunAsUser( ConnectionData& conn, int seq )
@@ -285,6 +519,15 @@ void KDapiHandler::updateScreensaving()
 #endif
     DCOPRef ref( "kdesktop", "KScreensaverIface" );
     ref.call( "enable", !suspend );
+    if( suspend == screensaver_suspended )
+        return;
+    screensaver_suspended = suspend;
+    for( ConnectionList::ConstIterator it = connections.begin();
+         it != connections.end();
+         ++it )
+        if( dapi_isSubscribed( (*it).conn, DAPI_COMMAND_SCREENSAVERSUSPENDED ))
+            dapi_writeReplyScreensaverSuspended( (*it).conn, 0, suspend );
+    updateWriteNotifiers();
     }
 
 void KDapiHandler::processCommandMailTo( ConnectionData& conn, int seq )
@@ -319,14 +562,40 @@ void KDapiHandler::processCommandMailTo( ConnectionData& conn, int seq )
     }
 
 static QValueList< KTempFile* > tempfiles;
+// downloads shared by several requests, removed only after all of them are done
+static QMap< QString, int > tempfile_shares;
 
 static void removeTempFile( const QString file )
     {
+    QMap< QString, int >::Iterator shares = tempfile_shares.find( file );
+    if( shares != tempfile_shares.end())
+        {
+        if( --(*shares) == 0 )
+            tempfile_shares.remove( shares );
+        return;
+        }
+    for( QValueList< KTempFile* >::Iterator it = tempfiles.begin();
+         it != tempfiles.end();
+         ++it )
+        if( (*it)->name() == file )
+            {
+            delete *it;
+            tempfiles.remove( it );
+            return;
+            }
+    }
+
+// A failed download is replied to without the file, so no request (neither the one
+// that started it nor the joined ones) will ever remove it.
+static void discardTempFile( const QString file )
+    {
+    tempfile_shares.remove( file );
     for( QValueList< KTempFile* >::Iterator it = tempfiles.begin();
          it != tempfiles.end();
          ++it )
         if( (*it)->name() == file )
             {
+            (*it)->unlink();
             delete *it;
             tempfiles.remove( it );
             return;
@@ -344,16 +613,61 @@ void KDapiHandler::processCommandLocalFile( ConnectionData& conn, int seq )
         closeSocket( conn );
         return;
         }
+    localFile( conn, seq, file, local, allow_download, winfo, false );
+    }
+
+void KDapiHandler::processCommandLocalFileFd( ConnectionData& conn, int seq )
+    {
+    char* file;
+    char* local;
+    int allow_download;
+    DapiWindowInfo winfo;
+    if( !dapi_readCommandLocalFileFd( conn.conn, &file, &local, &allow_download, &winfo ))
+        {
+        closeSocket( conn );
+        return;
+        }
+    localFile( conn, seq, file, local, allow_download, winfo, true );
+    }
+
+// With fd the file is opened here, so that the client doesn't race with
+// RemoveTemporaryLocalFile or anybody else replacing the file.
+static int openLocalFile( const QString& result )
+    {
+    return result.isEmpty() ? -1 : open( QFile::encodeName( result ), O_RDONLY | O_CLOEXEC );
+    }
+
+// The result is converted and the file opened by the caller, so that it's done
+// only once when replying to several requests.
+static void writeLocalFileReply( DapiConnection* conn, int seq, const QCString& result, int fd,
+    bool with_fd )
+    {
+    if( !with_fd )
+        dapi_writeReplyLocalFile( conn, seq, result.isEmpty() ? NULL : result.data());
+    else
+        dapi_writeReplyLocalFileFd( conn, seq, fd >= 0 ? result.data() : NULL, fd, fd >= 0 );
+    }
+
+void KDapiHandler::localFile( ConnectionData& conn, int seq, char* file, char* local,
+    int allow_download, DapiWindowInfo winfo, bool with_fd )
+    {
     KURL url = KURL::fromPathOrURL( QString::fromUtf8( file ));
     free( file );
+    QString target = QString::fromUtf8( local );
+    free( local );
     QString result;
     if( !url.isValid())
         ; // result is empty
     else if( url.isLocalFile())
         result = url.path();
+    else if( allow_download && target.isEmpty() && joinDownload( conn, seq, url, with_fd ))
+        {
+        dapi_freeWindowInfo( winfo );
+        // will write reply asynchronously
+        return;
+        }
     else if( allow_download )
         {
-        QString target = QString::fromUtf8( local );
         KTempFile* tmp = NULL;
         KURL dest;
         if( !target.isEmpty())
@@ -367,22 +681,81 @@ void KDapiHandler::processCommandLocalFile( ConnectionData& conn, int seq )
         KIO::FileCopyJob* job = KIO::file_copy( url, dest, -1, true, false );
         KDapiFakeWidget* widget = winfo.window != 0 ? new KDapiFakeWidget( winfo.window ) : NULL;
         job->setWindow( widget );
-        KDapiDownloadJob* upload = new KDapiDownloadJob( job, conn.conn, seq, widget );
-        connect( job, SIGNAL( result( KIO::Job* )), upload, SLOT( done()));
+        KDapiDownloadJob* download = new KDapiDownloadJob( job, conn.conn, seq, widget,
+            conn.progress_interval, with_fd, tmp != NULL );
+        connect( job, SIGNAL( result( KIO::Job* )), download, SLOT( done()));
+        addTransfer( download );
         dapi_freeWindowInfo( winfo );
         // will write reply asynchronously
         return;
         }
-    dapi_writeReplyLocalFile( conn.conn, seq, result.utf8());
+    int fd = with_fd ? openLocalFile( result ) : -1;
+    writeLocalFileReply( conn.conn, seq, result.utf8(), fd, with_fd );
+    if( fd >= 0 )
+        close( fd );
     dapi_freeWindowInfo( winfo );
     }
 
+// Several clients often want the same file at the same time (e.g. an attachment
+// opened by more applications), they share one download to a temporary file.
+bool KDapiHandler::joinDownload( ConnectionData& conn, int seq, const KURL& url, bool with_fd )
+    {
+    for( QPtrListIterator< KDapiTransferJob > it( transfers );
+         it.current() != NULL;
+         ++it )
+        if( it.current()->canJoin( url ))
+            {
+            it.current()->join( conn.conn, seq, conn.progress_interval, with_fd );
+            return true;
+            }
+    return false;
+    }
+
+bool KDapiTransferJob::canJoin( const KURL& ) const
+    {
+    return false;
+    }
+
+bool KDapiDownloadJob::canJoin( const KURL& src ) const
+    {
+    return temp && job->srcURL() == src;
+    }
+
+void KDapiTransferJob::join( DapiConnection* c, int s, int interval, bool with_fd )
+    {
+    Request request;
+    request.conn = c;
+    request.seq = s;
+    request.progress_interval = interval;
+    request.with_fd = with_fd;
+    joined.append( request );
+    if( interval > 0 && ( progress_interval <= 0 || interval < progress_interval ))
+        progress_interval = interval;
+    // every request removes the temporary file when done with it
+    ++tempfile_shares[ job->destURL().path() ];
+    }
+
 void KDapiDownloadJob::done()
     {
-    if( job->error() == 0 )
-        dapi_writeReplyLocalFile( conn, seq, job->destURL().path().utf8());
-    else
-        dapi_writeReplyLocalFile( conn, seq, NULL );
+    QString file = job->error() == 0 ? job->destURL().path() : QString::null;
+    QCString result = file.utf8();
+    bool need_fd = with_fd;
+    for( QValueList< Request >::ConstIterator it = joined.begin();
+         it != joined.end();
+         ++it )
+        need_fd = need_fd || (*it).with_fd;
+    int fd = need_fd ? openLocalFile( file ) : -1;
+    writeLocalFileReply( conn, seq, result, fd, with_fd );
+    for( QValueList< Request >::ConstIterator it = joined.begin();
+         it != joined.end();
+         ++it )
+        writeLocalFileReply( (*it).conn, (*it).seq, result, fd, (*it).with_fd );
+    if( fd >= 0 )
+        close( fd );
+    if( temp && job->error() != 0 )
+        discardTempFile( job->destURL().path());
+    temp = false; // nobody can join anymore until deleteLater() deletes it
+    emit replied();
     delete widget;
     deleteLater();
     }
@@ -414,8 +787,10 @@ void KDapiHandler::processCommandUploadFile( ConnectionData& conn, int seq )
         KIO::FileCopyJob* job = KIO::file_copy( src, url, -1, true, false );
         KDapiFakeWidget* widget = winfo.window != 0 ? new KDapiFakeWidget( winfo.window ) : NULL;
         job->setWindow( widget );
-        KDapiUploadJob* upload = new KDapiUploadJob( job, conn.conn, seq, remove_local, widget );
+        KDapiUploadJob* upload = new KDapiUploadJob( job, conn.conn, seq, remove_local, widget,
+            conn.progress_interval );
         connect( job, SIGNAL( result( KIO::Job* )), upload, SLOT( done()));
+        addTransfer( upload );
         dapi_freeWindowInfo( winfo );
         // will write reply asynchronously
         return;
@@ -428,9 +803,92 @@ void KDapiUploadJob::done()
     {
     // TODO this apparently returns success even with e.g. http - check somehow
     dapi_writeReplyUploadFile( conn, seq, job->error() == 0 );
+    emit replied();
     if( job->error() == 0 && remove_local )
         removeTempFile( job->srcURL().path());
     delete widget;
+    deleteLater();
+    }
+
+void KDapiHandler::addTransfer( KDapiTransferJob* transfer )
+    {
+    transfers.append( transfer );
+    connect( transfer, SIGNAL( replied()), SLOT( updateWriteNotifiers()));
+    connect( transfer, SIGNAL( destroyed( QObject* )), SLOT( transferDestroyed( QObject* )));
+    }
+
+void KDapiHandler::transferDestroyed( QObject* job )
+    {
+    transfers.removeRef( static_cast< KDapiTransferJob* >( job ));
+    updateIdleTimer();
+    }
+
+KDapiTransferJob::KDapiTransferJob( KIO::FileCopyJob* j, DapiConnection* c, int s, QWidget* w, int interval )
+    : job( j ), conn( c ), seq( s ), widget( w ), progress_interval( interval ),
+      own_progress_interval( interval ), total( 0 ), processed( 0 )
+    {
+    connect( job, SIGNAL( totalSize( KIO::Job*, KIO::filesize_t )),
+        SLOT( totalSize( KIO::Job*, KIO::filesize_t )));
+    connect( job, SIGNAL( processedSize( KIO::Job*, KIO::filesize_t )),
+        SLOT( processedSize( KIO::Job*, KIO::filesize_t )));
+    }
+
+void KDapiTransferJob::totalSize( KIO::Job*, KIO::filesize_t size )
+    {
+    total = size;
+    }
+
+void KDapiTransferJob::processedSize( KIO::Job*, KIO::filesize_t size )
+    {
+    processed = size;
+    if( progress_interval <= 0 )
+        return;
+    if( last_progress.isValid() && last_progress.elapsed() < progress_interval )
+        return;
+    last_progress.start();
+    if( own_progress_interval > 0 )
+        writeProgress( conn, seq );
+    for( QValueList< Request >::ConstIterator it = joined.begin();
+         it != joined.end();
+         ++it )
+        if( (*it).progress_interval > 0 )
+            writeProgress( (*it).conn, (*it).seq );
+    emit replied();
+    }
+
+bool KDapiTransferJob::isTransfer( DapiConnection* c, int s ) const
+    {
+    if( conn == c && seq == s )
+        return true;
+    for( QValueList< Request >::ConstIterator it = joined.begin();
+         it != joined.end();
+         ++it )
+        if( (*it).conn == c && (*it).seq == s )
+            return true;
+    return false;
+    }
+
+QString KDapiTransferJob::partialFile() const
+    {
+    return QString::null;
+    }
+
+// The part of the file that is already on the disk can be processed before
+// the transfer finishes, KIO may be writing to a .part file first though.
+QString KDapiDownloadJob::partialFile() const
+    {
+    QString file = job->destURL().path();
+    if( QFile::exists( file + ".part" ))
+        return file + ".part";
+    return file;
+    }
+
+void KDapiTransferJob::writeProgress( DapiConnection* c, int reply_seq )
+    {
+    QString file = partialFile();
+    long long readable = file.isEmpty() ? 0 : QFileInfo( file ).size();
+    dapi_writeReplyTransferProgress( c, reply_seq, file.isEmpty() ? NULL : file.utf8().data(),
+        processed, total, readable, 1 );
     }
 
 void KDapiHandler::processCommandRemoveTemporaryLocalFile( ConnectionData& conn, int seq )
@@ -454,7 +912,7 @@ void KDapiHandler::processCommandAddressBookList( ConnectionData& conn, int seq
         return;
         }
 
-    QStringList kabcUIDs = kabchandler->listUIDs();
+    QStringList kabcUIDs = addressBook()->listUIDs();
 
     stringarr idList;
     idList.data = 0;
@@ -491,7 +949,7 @@ void KDapiHandler::processCommandAddressBookGetName( ConnectionData& conn, int s
     QCString lastname;
     QCString fullname;
 
-    bool ok = kabchandler->getNames( QString::fromUtf8( id ),
+    bool ok = addressBook()->getNames( QString::fromUtf8( id ),
                                      firstname, lastname, fullname );
     free( id );
 
@@ -510,7 +968,7 @@ void KDapiHandler::processCommandAddressBookGetEmails( ConnectionData& conn, int
         }
 
     QStringList emails;
-    bool ok = kabchandler->getEmails( QString::fromUtf8( id ), emails );
+    bool ok = addressBook()->getEmails( QString::fromUtf8( id ), emails );
 
     free( id );
 
@@ -545,7 +1003,7 @@ void KDapiHandler::processCommandAddressBookFindByName( ConnectionData& conn, in
         return;
         }
 
-    QStringList kabcUIDs = kabchandler->findByName( QString::fromUtf8( id ) );
+    QStringList kabcUIDs = addressBook()->findByName( QString::fromUtf8( id ) );
 
     free( id );
 
@@ -579,7 +1037,7 @@ void KDapiHandler::processCommandAddressBookOwner( ConnectionData& conn, int seq
         return;
         }
 
-    QString ownerUID = kabchandler->owner();
+    QString ownerUID = addressBook()->owner();
 
     bool ok = !ownerUID.isEmpty();
 
@@ -595,7 +1053,7 @@ void KDapiHandler::processCommandAddressBookGetVCard30( ConnectionData& conn, in
         return;
         }
 
-    QString vcard = kabchandler->vcard30( QString::fromUtf8( id ) );
+    QString vcard = addressBook()->vcard30( QString::fromUtf8( id ) );
 
     free( id );
 
@@ -605,6 +1063,222 @@ void KDapiHandler::processCommandAddressBookGetVCard30( ConnectionData& conn, in
 
     }
 
+// The vCards are sent in chunks before the reply. Only the contact ids are
+// collected here, continueExports() converts and writes one chunk at a time.
+void KDapiHandler::processCommandAddressBookExportVCard30( ConnectionData& conn, int seq )
+    {
+    stringarr ids;
+    int chunk_size;
+    if( !dapi_readCommandAddressBookExportVCard30( conn.conn, &ids, &chunk_size ))
+        {
+        closeSocket( conn );
+        return;
+        }
+    VCardExport exp;
+    exp.seq = seq;
+    for( int i = 0;
+         i < ids.count;
+         ++i )
+        exp.uids.append( QString::fromUtf8( ids.data[ i ] ));
+    dapi_freestringarr( ids );
+    if( exp.uids.isEmpty())
+        exp.uids = addressBook()->listUIDs();
+    exp.chunk_size = chunk_size > 0 ? chunk_size : 100;
+    exp.count = 0;
+    conn.exports.append( exp );
+    scheduleExports();
+    }
+
+// Continues exports from the event loop, for connections whose previously
+// written chunk has already been sent, the others continue from sendSocketData().
+void KDapiHandler::scheduleExports()
+    {
+    for( ConnectionList::ConstIterator it = connections.begin();
+         it != connections.end();
+         ++it )
+        if( !(*it).exports.isEmpty() && !dapi_hasUnsentData( (*it).conn ))
+            {
+            export_timer->start( 0, true );
+            return;
+            }
+    }
+
+// Writes one chunk (or the final reply) of the current export of every connection
+// that has sent everything so far, so that a large export neither piles up
+// in the output buffer nor keeps the daemon from serving other clients.
+void KDapiHandler::continueExports()
+    {
+    for( ConnectionList::Iterator it = connections.begin();
+         it != connections.end();
+         ++it )
+        {
+        ConnectionData& conn = *it;
+        if( conn.exports.isEmpty() || dapi_hasUnsentData( conn.conn ))
+            continue;
+        VCardExport& exp = conn.exports.first();
+        if( exp.uids.isEmpty())
+            {
+            dapi_writeReplyAddressBookExportVCard30( conn.conn, exp.seq, exp.count, 1 );
+            conn.exports.remove( conn.exports.begin());
+            continue;
+            }
+        QStringList chunk;
+        while( !exp.uids.isEmpty() && int( chunk.count()) < exp.chunk_size )
+            {
+            chunk.append( exp.uids.first());
+            exp.uids.remove( exp.uids.begin());
+            }
+        int exported;
+        QCString vcards = addressBook()->vcards30( chunk, exported ).utf8();
+        if( exported > 0 )
+            dapi_writeReplyAddressBookVCard30Chunk( conn.conn, exp.seq, vcards.data(), exported, 1 );
+        exp.count += exported;
+        }
+    updateWriteNotifiers();
+    scheduleExports();
+    }
+
+void KDapiHandler::processCommandStats( ConnectionData& conn, int seq )
+    {
+    if( !dapi_readCommandStats( conn.conn ))
+        {
+        closeSocket( conn );
+        return;
+        }
+    intarr stats = dapi_getStats();
+    dapi_writeReplyStats( conn.conn, seq, stats, 1 );
+    dapi_freeintarr( stats );
+    }
+
+void KDapiHandler::processCommandProgressNotifications( ConnectionData& conn, int seq )
+    {
+    int interval;
+    if( !dapi_readCommandProgressNotifications( conn.conn, &interval ))
+        {
+        closeSocket( conn );
+        return;
+        }
+    // applies to transfers started afterwards
+    conn.progress_interval = interval;
+    dapi_writeReplyProgressNotifications( conn.conn, seq, 1 );
+    }
+
+void KDapiHandler::processCommandTransferProgress( ConnectionData& conn, int seq )
+    {
+    int transfer;
+    if( !dapi_readCommandTransferProgress( conn.conn, &transfer ))
+        {
+        closeSocket( conn );
+        return;
+        }
+    for( QPtrListIterator< KDapiTransferJob > it( transfers );
+         it.current() != NULL;
+         ++it )
+        if( it.current()->isTransfer( conn.conn, transfer ))
+            {
+            it.current()->writeProgress( conn.conn, seq );
+            return;
+            }
+    dapi_writeReplyTransferProgress( conn.conn, seq, NULL, 0, 0, 0, 0 );
+    }
+
+static stringarr toStringArr( const QStringList& list )
+    {
+    stringarr ret;
+    ret.count = 0;
+    ret.data = ( char** ) malloc( sizeof( char* ) * ( list.count() + 1 ));
+    for( QStringList::ConstIterator it = list.begin();
+         it != list.end();
+         ++it )
+        ret.data[ ret.count++ ] = strdup( (*it).utf8().data());
+    ret.data[ ret.count ] = NULL;
+    return ret;
+    }
+
+void KDapiHandler::processCommandSubscribe( ConnectionData& conn, int seq )
+    {
+    intarr events;
+    if( !dapi_readCommandSubscribe( conn.conn, &events ))
+        {
+        closeSocket( conn );
+        return;
+        }
+    bool ok = true;
+    for( int i = 0;
+         i < events.count;
+         ++i )
+        {
+        if( events.data[ i ] == DAPI_COMMAND_ADDRESSBOOKCHANGES )
+            addressBook(); // start watching for changes
+        else if( events.data[ i ] != DAPI_COMMAND_SCREENSAVERSUSPENDED )
+            ok = false;
+        }
+    dapi_setSubscriptions( conn.conn, events );
+    dapi_writeReplySubscribe( conn.conn, seq, ok );
+    dapi_freeintarr( events );
+    }
+
+void KDapiHandler::processCommandAddressBookChanges( ConnectionData& conn, int seq )
+    {
+    int since;
+    if( !dapi_readCommandAddressBookChanges( conn.conn, &since ))
+        {
+        closeSocket( conn );
+        return;
+        }
+    int generation = addressBook()->generation();
+    stringarr changed = toStringArr( addressBook()->changesSince( since ));
+    dapi_writeReplyAddressBookChanges( conn.conn, seq, generation, changed, since <= generation );
+    dapi_freestringarr( changed );
+    }
+
+void KDapiHandler::processCommandAddressBookFindByEmail( ConnectionData& conn, int seq )
+    {
+    char* email;
+    if( !dapi_readCommandAddressBookFindByEmail( conn.conn, &email ))
+        {
+        closeSocket( conn );
+        return;
+        }
+    stringarr ids = toStringArr( addressBook()->findByEmail( QString::fromUtf8( email )));
+    dapi_writeReplyAddressBookFindByEmail( conn.conn, seq, ids, ids.count > 0 );
+    dapi_freestringarr( ids );
+    free( email );
+    }
+
+void KDapiHandler::addressBookChanged( int generation, const QStringList& uids )
+    {
+    stringarr changed = toStringArr( uids );
+    for( ConnectionList::ConstIterator it = connections.begin();
+         it != connections.end();
+         ++it )
+        if( dapi_isSubscribed( (*it).conn, DAPI_COMMAND_ADDRESSBOOKCHANGES ))
+            dapi_writeReplyAddressBookChanges( (*it).conn, 0, generation, changed, 1 );
+    dapi_freestringarr( changed );
+    updateWriteNotifiers();
+    }
+
+void KDapiHandler::processCommandScreensaverSuspended( ConnectionData& conn, int seq )
+    {
+    if( !dapi_readCommandScreensaverSuspended( conn.conn ))
+        {
+        closeSocket( conn );
+        return;
+        }
+    dapi_writeReplyScreensaverSuspended( conn.conn, seq, screensaver_suspended );
+    }
+
+void KDapiHandler::processCommandSharedMemory( ConnectionData& conn, int seq )
+    {
+    int threshold;
+    if( !dapi_readCommandSharedMemory( conn.conn, &threshold ))
+        {
+        closeSocket( conn );
+        return;
+        }
+    dapi_writeReplySharedMemory( conn.conn, seq, dapi_setSharedMemoryThreshold( conn.conn, threshold ));
+    }
+
 QCString KDapiHandler::makeStartupInfo( const DapiWindowInfo& winfo )
     {
     WId window = winfo.window;
@@ -3,6 +3,9 @@
 
 #include <qobject.h>
 #include <qmap.h>
+#include <qptrlist.h>
+#include <qdatetime.h>
+#include <qstringlist.h>
 #include <kio/job.h>
 #include <qwidget.h>
 
@@ -10,29 +13,52 @@
 
 class KABCHandler;
 class QSocketNotifier;
+class QTimer;
+class KDapiTransferJob;
 
 class KDapiHandler
     : public QObject
     {
     Q_OBJECT
     public:
-        KDapiHandler();
+        KDapiHandler( int idle_timeout );
         virtual ~KDapiHandler();
     private slots:
         void processMainSocketData();
         void processSocketData( int sock );
+        void sendSocketData( int sock );
+        void updateWriteNotifiers();
+        void transferDestroyed( QObject* job );
+        void addressBookChanged( int generation, const QStringList& uids );
+        void idleTimeout();
+        void settingsChanged();
+        void continueExports();
     private:
+        // AddressBookExportVCard30 in progress, the contacts not exported yet
+        struct VCardExport
+            {
+            int seq;
+            QStringList uids;
+            int chunk_size;
+            int count;
+            };
         struct ConnectionData
             {
             DapiConnection* conn;
             QSocketNotifier* notifier;
+            QSocketNotifier* write_notifier;
             bool screensaver_suspend;
+            int progress_interval;
+            QValueList< VCardExport > exports; // the first one is being sent
             };
+        typedef QValueList< ConnectionData > ConnectionList;
+        ConnectionList::Iterator findConnection( int sock );
         void setupSocket();
         void closeSocket( ConnectionData& conn );
         void processCommand( ConnectionData& conn );
         void processCommandInit( ConnectionData& conn, int seq );
         void processCommandCapabilities( ConnectionData& conn, int seq );
+        void processCommandHandshake( ConnectionData& conn, int seq );
         void processCommandOpenUrl( ConnectionData& conn, int seq );
         void processCommandExecuteUrl( ConnectionData& conn, int seq );
         void processCommandButtonOrder( ConnectionData& conn, int seq );
@@ -40,6 +66,10 @@ class KDapiHandler
         void processCommandSuspendScreensaving( ConnectionData& conn, int seq );
         void processCommandMailTo( ConnectionData& conn, int seq );
         void processCommandLocalFile( ConnectionData& conn, int seq );
+        void processCommandLocalFileFd( ConnectionData& conn, int seq );
+        void localFile( ConnectionData& conn, int seq, char* file, char* local,
+            int allow_download, DapiWindowInfo winfo, bool with_fd );
+        bool joinDownload( ConnectionData& conn, int seq, const KURL& url, bool with_fd );
         void processCommandUploadFile( ConnectionData& conn, int seq );
         void processCommandRemoveTemporaryLocalFile( ConnectionData& conn, int seq );
         void processCommandAddressBookList( ConnectionData& conn, int seq );
@@ -48,12 +78,35 @@ class KDapiHandler
         void processCommandAddressBookFindByName( ConnectionData& conn, int seq );
         void processCommandAddressBookOwner( ConnectionData& conn, int seq );
         void processCommandAddressBookGetVCard30( ConnectionData& conn, int seq );
+        void processCommandAddressBookExportVCard30( ConnectionData& conn, int seq );
+        void processCommandStats( ConnectionData& conn, int seq );
+        void processCommandSharedMemory( ConnectionData& conn, int seq );
+        void processCommandProgressNotifications( ConnectionData& conn, int seq );
+        void processCommandTransferProgress( ConnectionData& conn, int seq );
+        void addTransfer( KDapiTransferJob* transfer );
+        void processCommandSubscribe( ConnectionData& conn, int seq );
+        void processCommandAddressBookChanges( ConnectionData& conn, int seq );
+        void processCommandAddressBookFindByEmail( ConnectionData& conn, int seq );
+        void processCommandScreensaverSuspended( ConnectionData& conn, int seq );
+        void processCommandGetSettings( ConnectionData& conn, int seq );
+        typedef QMap< QString, QCString > SettingsMap;
+        int buttonOrder();
+        const SettingsMap& desktopSettings();
         void updateScreensaving();
+        void updateIdleTimer();
+        void scheduleExports();
+        KABCHandler* addressBook();
         static QCString makeStartupInfo( const DapiWindowInfo& winfo );
         int mainsocket;
-        typedef QValueList< ConnectionData > ConnectionList;
         ConnectionList connections;
-        KABCHandler* kabchandler;
+        QPtrList< KDapiTransferJob > transfers;
+        KABCHandler* kabchandler; // created on first use, see addressBook()
+        bool screensaver_suspended;
+        int idle_timeout;
+        QTimer* idle_timer;
+        QTimer* export_timer;
+        int button_order; // cached until the settings change, 0 if not known
+        SettingsMap settings; // GetSettings snapshot, empty if not known
     };
 
 class KDapiFakeWidget
@@ -65,46 +118,85 @@ class KDapiFakeWidget
         virtual ~KDapiFakeWidget();
     };
 
-class KDapiDownloadJob
+// Common for downloads and uploads, tracks the progress and if requested
+// (progress interval > 0) sends it as TransferProgress notifications.
+// Other requests for the same transfer may join it, they get the same result.
+class KDapiTransferJob
     : public QObject
     {
     Q_OBJECT
     public:
-        KDapiDownloadJob( KIO::FileCopyJob* j, DapiConnection* c, int s, QWidget* w );
+        KDapiTransferJob( KIO::FileCopyJob* j, DapiConnection* c, int s, QWidget* w, int interval );
+        bool isTransfer( DapiConnection* c, int s ) const;
+        void writeProgress( DapiConnection* c, int reply_seq );
+        virtual bool canJoin( const KURL& src ) const;
+        void join( DapiConnection* c, int s, int interval, bool with_fd );
+    signals:
+        void replied(); // also after writing a progress notification
     private slots:
-        void done();
-    private:
+        void totalSize( KIO::Job*, KIO::filesize_t size );
+        void processedSize( KIO::Job*, KIO::filesize_t size );
+    protected:
+        virtual QString partialFile() const;
+        struct Request
+            {
+            DapiConnection* conn;
+            int seq;
+            int progress_interval;
+            bool with_fd;
+            };
         KIO::FileCopyJob* job;
         DapiConnection* conn;
         int seq;
         QWidget* widget;
+        QValueList< Request > joined; // requests other than the one that started it
+    private:
+        int progress_interval; // the shortest one requested
+        int own_progress_interval;
+        QTime last_progress;
+        KIO::filesize_t total;
+        KIO::filesize_t processed;
+    };
+
+class KDapiDownloadJob
+    : public KDapiTransferJob
+    {
+    Q_OBJECT
+    public:
+        KDapiDownloadJob( KIO::FileCopyJob* j, DapiConnection* c, int s, QWidget* w, int interval, bool f,
+            bool temp );
+        virtual bool canJoin( const KURL& src ) const;
+    protected:
+        virtual QString partialFile() const;
+    private slots:
+        void done();
+    private:
+        bool with_fd;
+        bool temp; // downloading to a temporary file, which can be shared
     };
 
 class KDapiUploadJob
-    : public QObject
+    : public KDapiTransferJob
     {
     Q_OBJECT
     public:
-        KDapiUploadJob( KIO::FileCopyJob* j, DapiConnection* c, int s, bool r, QWidget* w );
+        KDapiUploadJob( KIO::FileCopyJob* j, DapiConnection* c, int s, bool r, QWidget* w, int interval );
     private slots:
         void done();
     private:
-        KIO::FileCopyJob* job;
-        DapiConnection* conn;
-        int seq;
         bool remove_local;
-        QWidget* widget;
     };
 
 inline
-KDapiDownloadJob::KDapiDownloadJob( KIO::FileCopyJob* j, DapiConnection* c, int s, QWidget* w )
-    : job( j ), conn( c ), seq( s ), widget( w )
+KDapiDownloadJob::KDapiDownloadJob( KIO::FileCopyJob* j, DapiConnection* c, int s, QWidget* w, int interval, bool f,
+    bool tmp )
+    : KDapiTransferJob( j, c, s, w, interval ), with_fd( f ), temp( tmp )
     {
     }
 
 inline
-KDapiUploadJob::KDapiUploadJob( KIO::FileCopyJob* j, DapiConnection* c, int s, bool r, QWidget* w )
-    : job( j ), conn( c ), seq( s ), remove_local( r ), widget( w )
+KDapiUploadJob::KDapiUploadJob( KIO::FileCopyJob* j, DapiConnection* c, int s, bool r, QWidget* w, int interval )
+    : KDapiTransferJob( j, c, s, w, interval ), remove_local( r )
     {
     }
 
@@ -40,13 +40,20 @@ using namespace KABC;
 KABCHandler::KABCHandler(QObject* parent, const char* name)
     : QObject(parent, name),
       m_addressBook(0),
-      m_vcardConverter(0)
+      m_vcardConverter(0),
+      m_generation(1)
 {
     m_addressBook = StdAddressBook::self(true);
     QObject::connect(m_addressBook, SIGNAL(addressBookChanged(AddressBook*)),
                      this, SLOT(slotAddressBookChanged()));
 
-    m_vcardConverter = new VCardConverter();
+    AddressBook::ConstIterator it    = m_addressBook->begin();
+    AddressBook::ConstIterator endIt = m_addressBook->end();
+    for (; it != endIt; ++it)
+    {
+        m_snapshot[(*it).uid()] = *it;
+        indexEmails(*it);
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -120,6 +127,17 @@ QStringList KABCHandler::findByName(const QString& name) const
 
 ///////////////////////////////////////////////////////////////////////////////
 
+QStringList KABCHandler::findByEmail(const QString& email) const
+{
+    QMap<QString, QStringList>::ConstIterator it = m_emailIndex.find(normalizedEmail(email));
+
+    if (it == m_emailIndex.end()) return QStringList();
+
+    return it.data();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 QString KABCHandler::owner() const
 {
     return m_addressBook->whoAmI().uid();
@@ -133,11 +151,35 @@ QString KABCHandler::vcard30(const QString& uid) const
 
     if (contact.isEmpty()) return QString::null;
 
+    if (m_vcardConverter == 0) m_vcardConverter = new VCardConverter();
+
     return m_vcardConverter->createVCard(contact, VCardConverter::v3_0);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
+QString KABCHandler::vcards30(const QStringList& uids, int& count) const
+{
+    Addressee::List contacts;
+
+    QStringList::const_iterator it    = uids.begin();
+    QStringList::const_iterator endIt = uids.end();
+    for (; it != endIt; ++it)
+    {
+        Addressee contact = m_addressBook->findByUid(*it);
+        if (!contact.isEmpty()) contacts.append(contact);
+    }
+
+    count = contacts.count();
+    if (count == 0) return QString::null;
+
+    if (m_vcardConverter == 0) m_vcardConverter = new VCardConverter();
+
+    return m_vcardConverter->createVCards(contacts, VCardConverter::v3_0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 bool KABCHandler::hasNameMatch(const KABC::Addressee& contact, const QString& name)
 {
     if (contact.assembledName().lower().find(name) != -1) return true;
@@ -149,9 +191,119 @@ bool KABCHandler::hasNameMatch(const KABC::Addressee& contact, const QString& na
 
 ///////////////////////////////////////////////////////////////////////////////
 
+QString KABCHandler::normalizedEmail(const QString& email)
+{
+    // also accept addresses like "Name <user@example.com>"
+    QString address = email;
+    int start = address.find('<');
+    int end   = address.findRev('>');
+    if (start != -1 && end > start) address = address.mid(start + 1, end - start - 1);
+
+    return address.stripWhiteSpace().lower();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void KABCHandler::indexEmails(const KABC::Addressee& contact)
+{
+    QStringList emails = contact.emails();
+
+    QStringList::ConstIterator it    = emails.begin();
+    QStringList::ConstIterator endIt = emails.end();
+    for (; it != endIt; ++it)
+    {
+        QStringList& uids = m_emailIndex[normalizedEmail(*it)];
+        if (!uids.contains(contact.uid())) uids << contact.uid();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void KABCHandler::unindexEmails(const KABC::Addressee& contact)
+{
+    QStringList emails = contact.emails();
+
+    QStringList::ConstIterator it    = emails.begin();
+    QStringList::ConstIterator endIt = emails.end();
+    for (; it != endIt; ++it)
+    {
+        QMap<QString, QStringList>::Iterator entry = m_emailIndex.find(normalizedEmail(*it));
+        if (entry == m_emailIndex.end()) continue;
+
+        entry.data().remove(contact.uid());
+        if (entry.data().isEmpty()) m_emailIndex.remove(entry);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int KABCHandler::generation() const
+{
+    return m_generation;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+QStringList KABCHandler::changesSince(int since) const
+{
+    QStringList uids;
+
+    QMap<QString, int>::ConstIterator it    = m_changes.begin();
+    QMap<QString, int>::ConstIterator endIt = m_changes.end();
+    for (; it != endIt; ++it)
+    {
+        if (it.data() > since) uids << it.key();
+    }
+
+    return uids;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 void KABCHandler::slotAddressBookChanged()
 {
-    qDebug("AddressBook changed");
+    QMap<QString, Addressee> snapshot;
+    QStringList uids;
+
+    AddressBook::ConstIterator it    = m_addressBook->begin();
+    AddressBook::ConstIterator endIt = m_addressBook->end();
+    for (; it != endIt; ++it)
+    {
+        QString uid = (*it).uid();
+        snapshot[uid] = *it;
+
+        QMap<QString, Addressee>::ConstIterator old = m_snapshot.find(uid);
+        if (old == m_snapshot.end() || !(old.data() == *it)) uids << uid;
+    }
+
+    QMap<QString, Addressee>::ConstIterator oldIt    = m_snapshot.begin();
+    QMap<QString, Addressee>::ConstIterator oldEndIt = m_snapshot.end();
+    for (; oldIt != oldEndIt; ++oldIt)
+    {
+        if (!snapshot.contains(oldIt.key())) uids << oldIt.key();
+    }
+
+    // only the changed contacts need to be reindexed
+    for (QStringList::ConstIterator uidIt = uids.begin(); uidIt != uids.end(); ++uidIt)
+    {
+        QMap<QString, Addressee>::ConstIterator old = m_snapshot.find(*uidIt);
+        if (old != m_snapshot.end()) unindexEmails(old.data());
+
+        QMap<QString, Addressee>::ConstIterator current = snapshot.find(*uidIt);
+        if (current != snapshot.end()) indexEmails(current.data());
+    }
+
+    m_snapshot = snapshot;
+
+    if (uids.isEmpty()) return;
+
+    ++m_generation;
+    for (QStringList::ConstIterator uidIt = uids.begin(); uidIt != uids.end(); ++uidIt)
+    {
+        m_changes[*uidIt] = m_generation;
+    }
+
+    emit changed(m_generation, uids);
 }
 
 #include "kabchandler.moc"
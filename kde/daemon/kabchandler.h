@@ -28,8 +28,12 @@
 #define KABCHANDLER_H
 
 // Qt includes
+#include <qmap.h>
 #include <qobject.h>
 
+// KABC includes
+#include <kabc/addressee.h>
+
 // forward declarations
 namespace KABC
 {
@@ -56,18 +60,50 @@ public:
 
     QStringList findByName(const QString& uid) const;
 
+    QStringList findByEmail(const QString& email) const;
+
     QString owner() const;
 
     QString vcard30(const QString& uid) const;
 
+    // vCards of the given contacts, unknown UIDs are skipped
+    QString vcards30(const QStringList& uids, int& count) const;
+
+    int generation() const;
+
+    // UIDs of contacts added, changed or removed after the given generation
+    QStringList changesSince(int since) const;
+
+signals:
+    void changed(int generation, const QStringList& uids);
+
 private:
     KABC::StdAddressBook* m_addressBook;
 
-    KABC::VCardConverter* m_vcardConverter;
+    // created on first use
+    mutable KABC::VCardConverter* m_vcardConverter;
+
+    // addressBookChanged() doesn't say what has changed, so compare
+    // with the previous contents
+    QMap<QString, KABC::Addressee> m_snapshot;
+
+    // generation of the last change of every contact ever seen
+    QMap<QString, int> m_changes;
+
+    // UIDs of the contacts having a normalized email address,
+    // updated together with m_snapshot
+    QMap<QString, QStringList> m_emailIndex;
+
+    int m_generation;
 
 private:
     static bool hasNameMatch(const KABC::Addressee& contact, const QString& name);
 
+    static QString normalizedEmail(const QString& email);
+
+    void indexEmails(const KABC::Addressee& contact);
+    void unindexEmails(const KABC::Addressee& contact);
+
 private slots:
     void slotAddressBookChanged();
 };
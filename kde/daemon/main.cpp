@@ -5,10 +5,23 @@
 
 #include "handler.h"
 
+static KCmdLineOptions options[] =
+    {
+    { "idle-timeout <seconds>", I18N_NOOP( "Exit after the given time without clients (0 = never)" ), 0 },
+    KCmdLineLastOption
+    };
+
 int main( int argc, char* argv[] )
     {
     KCmdLineArgs::init( argc, argv, "dapi_kde", I18N_NOOP( "dapi_kde" ), I18N_NOOP( "dapi_kde" ), "0.1" );
+    KCmdLineArgs::addCmdLineOptions( options );
     KApplication app;
-    KDapiHandler handler;
+    KCmdLineArgs* args = KCmdLineArgs::parsedArgs();
+    // by default as requested by the environment, see dapi_idleTimeout()
+    int idle_timeout = dapi_idleTimeout();
+    if( args->isSet( "idle-timeout" ))
+        idle_timeout = args->getOption( "idle-timeout" ).toInt() * 1000;
+    args->clear();
+    KDapiHandler handler( idle_timeout );
     return app.exec();
     }
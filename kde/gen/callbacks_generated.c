@@ -1,314 +1,719 @@
-int dapi_callbackInit( DapiConnection* conn, dapi_Init_callback callback )
+int dapi_callbackInit( DapiConnection* conn, dapi_Init_callback callback, void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandInit( conn );
-    if( seq == 0 )
-        return 0;
-    call = malloc( sizeof( *call ));
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_INIT;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandInit( conn );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_INIT;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
-int dapi_callbackCapabilities( DapiConnection* conn, dapi_Capabilities_callback callback )
+int dapi_callbackCapabilities( DapiConnection* conn, dapi_Capabilities_callback callback,
+    void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandCapabilities( conn );
-    if( seq == 0 )
-        return 0;
-    call = malloc( sizeof( *call ));
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_CAPABILITIES;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandCapabilities( conn );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_CAPABILITIES;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
 int dapi_callbackOpenUrl( DapiConnection* conn, const char* url, DapiWindowInfo winfo,
-    dapi_OpenUrl_callback callback )
+    dapi_OpenUrl_callback callback, void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandOpenUrl( conn, url, winfo );
-    if( seq == 0 )
-        return 0;
-    call = malloc( sizeof( *call ));
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_OPENURL;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandOpenUrl( conn, url, winfo );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_OPENURL;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
 int dapi_callbackExecuteUrl( DapiConnection* conn, const char* url, DapiWindowInfo winfo,
-    dapi_ExecuteUrl_callback callback )
+    dapi_ExecuteUrl_callback callback, void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandExecuteUrl( conn, url, winfo );
-    if( seq == 0 )
-        return 0;
-    call = malloc( sizeof( *call ));
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_EXECUTEURL;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandExecuteUrl( conn, url, winfo );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_EXECUTEURL;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
-int dapi_callbackButtonOrder( DapiConnection* conn, dapi_ButtonOrder_callback callback )
+int dapi_callbackButtonOrder( DapiConnection* conn, dapi_ButtonOrder_callback callback,
+    void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandButtonOrder( conn );
-    if( seq == 0 )
-        return 0;
-    call = malloc( sizeof( *call ));
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_BUTTONORDER;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandButtonOrder( conn );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_BUTTONORDER;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
 int dapi_callbackRunAsUser( DapiConnection* conn, const char* user, const char* command,
-    DapiWindowInfo winfo, dapi_RunAsUser_callback callback )
+    DapiWindowInfo winfo, dapi_RunAsUser_callback callback, void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandRunAsUser( conn, user, command, winfo );
-    if( seq == 0 )
-        return 0;
-    call = malloc( sizeof( *call ));
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_RUNASUSER;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandRunAsUser( conn, user, command, winfo );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_RUNASUSER;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
-int dapi_callbackSuspendScreensaving( DapiConnection* conn, int suspend, dapi_SuspendScreensaving_callback callback )
+int dapi_callbackSuspendScreensaving( DapiConnection* conn, int suspend, dapi_SuspendScreensaving_callback callback,
+    void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandSuspendScreensaving( conn, suspend );
-    if( seq == 0 )
-        return 0;
-    call = malloc( sizeof( *call ));
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_SUSPENDSCREENSAVING;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandSuspendScreensaving( conn, suspend );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_SUSPENDSCREENSAVING;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
 int dapi_callbackMailTo( DapiConnection* conn, const char* subject, const char* body,
     const char* to, const char* cc, const char* bcc, stringarr attachments, DapiWindowInfo winfo,
-    dapi_MailTo_callback callback )
+    dapi_MailTo_callback callback, void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandMailTo( conn, subject, body, to, cc, bcc, attachments, winfo );
-    if( seq == 0 )
-        return 0;
-    call = malloc( sizeof( *call ));
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_MAILTO;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandMailTo( conn, subject, body, to, cc, bcc, attachments, winfo );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_MAILTO;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
 int dapi_callbackLocalFile( DapiConnection* conn, const char* remote, const char* local,
-    int allow_download, DapiWindowInfo winfo, dapi_LocalFile_callback callback )
+    int allow_download, DapiWindowInfo winfo, dapi_LocalFile_callback callback, void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandLocalFile( conn, remote, local, allow_download, winfo );
-    if( seq == 0 )
-        return 0;
-    call = malloc( sizeof( *call ));
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_LOCALFILE;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandLocalFile( conn, remote, local, allow_download, winfo );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_LOCALFILE;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
 int dapi_callbackUploadFile( DapiConnection* conn, const char* local, const char* file,
-    int remove_local, DapiWindowInfo winfo, dapi_UploadFile_callback callback )
+    int remove_local, DapiWindowInfo winfo, dapi_UploadFile_callback callback, void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandUploadFile( conn, local, file, remove_local, winfo );
-    if( seq == 0 )
-        return 0;
-    call = malloc( sizeof( *call ));
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_UPLOADFILE;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandUploadFile( conn, local, file, remove_local, winfo );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_UPLOADFILE;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
 int dapi_callbackRemoveTemporaryLocalFile( DapiConnection* conn, const char* local,
-    dapi_RemoveTemporaryLocalFile_callback callback )
+    dapi_RemoveTemporaryLocalFile_callback callback, void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
+    DapiCallbackData* call = malloc( sizeof( *call ));
+    if( call == NULL )
+        return 0;
+    dapi_lockConnection( conn );
     seq = dapi_writeCommandRemoveTemporaryLocalFile( conn, local );
-    if( seq == 0 )
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_REMOVETEMPORARYLOCALFILE;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
+    return seq;
+    }
+
+int dapi_callbackAddressBookList( DapiConnection* conn, dapi_AddressBookList_callback callback,
+    void* user_data )
+    {
+    int seq;
+    DapiCallbackData* call = malloc( sizeof( *call ));
+    if( call == NULL )
         return 0;
-    call = malloc( sizeof( *call ));
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandAddressBookList( conn );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_ADDRESSBOOKLIST;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
+    return seq;
+    }
+
+int dapi_callbackAddressBookGetName( DapiConnection* conn, const char* id, dapi_AddressBookGetName_callback callback,
+    void* user_data )
+    {
+    int seq;
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_REMOVETEMPORARYLOCALFILE;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandAddressBookGetName( conn, id );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_ADDRESSBOOKGETNAME;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
-int dapi_callbackAddressBookList( DapiConnection* conn, dapi_AddressBookList_callback callback )
+int dapi_callbackAddressBookGetEmails( DapiConnection* conn, const char* id, dapi_AddressBookGetEmails_callback callback,
+    void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandAddressBookList( conn );
-    if( seq == 0 )
+    DapiCallbackData* call = malloc( sizeof( *call ));
+    if( call == NULL )
         return 0;
-    call = malloc( sizeof( *call ));
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandAddressBookGetEmails( conn, id );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_ADDRESSBOOKGETEMAILS;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
+    return seq;
+    }
+
+int dapi_callbackAddressBookFindByName( DapiConnection* conn, const char* name, dapi_AddressBookFindByName_callback callback,
+    void* user_data )
+    {
+    int seq;
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_ADDRESSBOOKLIST;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandAddressBookFindByName( conn, name );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_ADDRESSBOOKFINDBYNAME;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
-int dapi_callbackAddressBookGetName( DapiConnection* conn, const char* id, dapi_AddressBookGetName_callback callback )
+int dapi_callbackAddressBookOwner( DapiConnection* conn, dapi_AddressBookOwner_callback callback,
+    void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandAddressBookGetName( conn, id );
-    if( seq == 0 )
+    DapiCallbackData* call = malloc( sizeof( *call ));
+    if( call == NULL )
         return 0;
-    call = malloc( sizeof( *call ));
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandAddressBookOwner( conn );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_ADDRESSBOOKOWNER;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
+    return seq;
+    }
+
+int dapi_callbackAddressBookGetVCard30( DapiConnection* conn, const char* id, dapi_AddressBookGetVCard30_callback callback,
+    void* user_data )
+    {
+    int seq;
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_ADDRESSBOOKGETNAME;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandAddressBookGetVCard30( conn, id );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_ADDRESSBOOKGETVCARD30;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
-int dapi_callbackAddressBookGetEmails( DapiConnection* conn, const char* id, dapi_AddressBookGetEmails_callback callback )
+int dapi_callbackStats( DapiConnection* conn, dapi_Stats_callback callback, void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandAddressBookGetEmails( conn, id );
-    if( seq == 0 )
+    DapiCallbackData* call = malloc( sizeof( *call ));
+    if( call == NULL )
         return 0;
-    call = malloc( sizeof( *call ));
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandStats( conn );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_STATS;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
+    return seq;
+    }
+
+int dapi_callbackSharedMemory( DapiConnection* conn, int threshold, dapi_SharedMemory_callback callback,
+    void* user_data )
+    {
+    int seq;
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_ADDRESSBOOKGETEMAILS;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandSharedMemory( conn, threshold );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_SHAREDMEMORY;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
-int dapi_callbackAddressBookFindByName( DapiConnection* conn, const char* name, dapi_AddressBookFindByName_callback callback )
+int dapi_callbackLocalFileFd( DapiConnection* conn, const char* remote, const char* local,
+    int allow_download, DapiWindowInfo winfo, dapi_LocalFileFd_callback callback, void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandAddressBookFindByName( conn, name );
-    if( seq == 0 )
+    DapiCallbackData* call = malloc( sizeof( *call ));
+    if( call == NULL )
         return 0;
-    call = malloc( sizeof( *call ));
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandLocalFileFd( conn, remote, local, allow_download, winfo );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_LOCALFILEFD;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
+    return seq;
+    }
+
+int dapi_callbackProgressNotifications( DapiConnection* conn, int interval, dapi_ProgressNotifications_callback callback,
+    void* user_data )
+    {
+    int seq;
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_ADDRESSBOOKFINDBYNAME;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandProgressNotifications( conn, interval );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_PROGRESSNOTIFICATIONS;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
-int dapi_callbackAddressBookOwner( DapiConnection* conn, dapi_AddressBookOwner_callback callback )
+int dapi_callbackTransferProgress( DapiConnection* conn, int transfer, dapi_TransferProgress_callback callback,
+    void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandAddressBookOwner( conn );
-    if( seq == 0 )
+    DapiCallbackData* call = malloc( sizeof( *call ));
+    if( call == NULL )
         return 0;
-    call = malloc( sizeof( *call ));
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandTransferProgress( conn, transfer );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_TRANSFERPROGRESS;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
+    return seq;
+    }
+
+int dapi_callbackSubscribe( DapiConnection* conn, intarr events, dapi_Subscribe_callback callback,
+    void* user_data )
+    {
+    int seq;
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_ADDRESSBOOKOWNER;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandSubscribe( conn, events );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_SUBSCRIBE;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
-int dapi_callbackAddressBookGetVCard30( DapiConnection* conn, const char* id, dapi_AddressBookGetVCard30_callback callback )
+int dapi_callbackAddressBookChanges( DapiConnection* conn, int since, dapi_AddressBookChanges_callback callback,
+    void* user_data )
     {
     int seq;
-    DapiCallbackData* call;
-    seq = dapi_writeCommandAddressBookGetVCard30( conn, id );
-    if( seq == 0 )
+    DapiCallbackData* call = malloc( sizeof( *call ));
+    if( call == NULL )
         return 0;
-    call = malloc( sizeof( *call ));
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandAddressBookChanges( conn, since );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_ADDRESSBOOKCHANGES;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
+    return seq;
+    }
+
+int dapi_callbackScreensaverSuspended( DapiConnection* conn, dapi_ScreensaverSuspended_callback callback,
+    void* user_data )
+    {
+    int seq;
+    DapiCallbackData* call = malloc( sizeof( *call ));
+    if( call == NULL )
+        return 0;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandScreensaverSuspended( conn );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_SCREENSAVERSUSPENDED;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
+    return seq;
+    }
+
+int dapi_callbackHandshake( DapiConnection* conn, int client_version, int client_features,
+    dapi_Handshake_callback callback, void* user_data )
+    {
+    int seq;
+    DapiCallbackData* call = malloc( sizeof( *call ));
+    if( call == NULL )
+        return 0;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandHandshake( conn, client_version, client_features );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_HANDSHAKE;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
+    return seq;
+    }
+
+int dapi_callbackGetSettings( DapiConnection* conn, stringarr keys, dapi_GetSettings_callback callback,
+    void* user_data )
+    {
+    int seq;
+    DapiCallbackData* call = malloc( sizeof( *call ));
+    if( call == NULL )
+        return 0;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandGetSettings( conn, keys );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_GETSETTINGS;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
+    return seq;
+    }
+
+int dapi_callbackAddressBookExportVCard30( DapiConnection* conn, stringarr contact_ids,
+    int chunk_size, dapi_AddressBookExportVCard30_callback callback, void* user_data )
+    {
+    int seq;
+    DapiCallbackData* call = malloc( sizeof( *call ));
+    if( call == NULL )
+        return 0;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandAddressBookExportVCard30( conn, contact_ids, chunk_size );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_ADDRESSBOOKEXPORTVCARD30;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
+    return seq;
+    }
+
+int dapi_callbackAddressBookVCard30Chunk( DapiConnection* conn, dapi_AddressBookVCard30Chunk_callback callback,
+    void* user_data )
+    {
+    int seq;
+    DapiCallbackData* call = malloc( sizeof( *call ));
+    if( call == NULL )
+        return 0;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandAddressBookVCard30Chunk( conn );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_ADDRESSBOOKVCARD30CHUNK;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
+    return seq;
+    }
+
+int dapi_callbackAddressBookFindByEmail( DapiConnection* conn, const char* email, dapi_AddressBookFindByEmail_callback callback,
+    void* user_data )
+    {
+    int seq;
+    DapiCallbackData* call = malloc( sizeof( *call ));
     if( call == NULL )
         return 0;
-    call->seq = seq;
-    call->callback = callback;
-    call->command = DAPI_COMMAND_ADDRESSBOOKGETVCARD30;
-    call->next = conn->callbacks;
-    conn->callbacks = call;
+    dapi_lockConnection( conn );
+    seq = dapi_writeCommandAddressBookFindByEmail( conn, email );
+    if( seq != 0 )
+        {
+        call->seq = seq;
+        call->callback = callback;
+        call->user_data = user_data;
+        call->command = DAPI_COMMAND_ADDRESSBOOKFINDBYEMAIL;
+        call->next = conn->callbacks;
+        conn->callbacks = call;
+        }
+    else
+        free( call );
+    dapi_unlockConnection( conn );
     return seq;
     }
 
@@ -320,7 +725,8 @@ static void genericCallbackDispatch( DapiConnection* conn, DapiCallbackData* dat
             {
             int ok;
             dapi_readReplyInit( conn, &ok );
-            (( dapi_Init_callback ) data->callback )( conn, data->seq, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_INIT )
+                (( dapi_Init_callback ) data->callback )( conn, data->seq, ok, data->user_data );
             break;
             }
         case DAPI_REPLY_CAPABILITIES:
@@ -328,70 +734,82 @@ static void genericCallbackDispatch( DapiConnection* conn, DapiCallbackData* dat
             intarr capabitilies;
             int ok;
             dapi_readReplyCapabilities( conn, &capabitilies, &ok );
-            (( dapi_Capabilities_callback ) data->callback )( conn, data->seq, capabitilies, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_CAPABILITIES )
+                (( dapi_Capabilities_callback ) data->callback )( conn, data->seq, capabitilies, ok, data->user_data );
+            dapi_freeintarr( capabitilies );
             break;
             }
         case DAPI_REPLY_OPENURL:
             {
             int ok;
             dapi_readReplyOpenUrl( conn, &ok );
-            (( dapi_OpenUrl_callback ) data->callback )( conn, data->seq, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_OPENURL )
+                (( dapi_OpenUrl_callback ) data->callback )( conn, data->seq, ok, data->user_data );
             break;
             }
         case DAPI_REPLY_EXECUTEURL:
             {
             int ok;
             dapi_readReplyExecuteUrl( conn, &ok );
-            (( dapi_ExecuteUrl_callback ) data->callback )( conn, data->seq, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_EXECUTEURL )
+                (( dapi_ExecuteUrl_callback ) data->callback )( conn, data->seq, ok, data->user_data );
             break;
             }
         case DAPI_REPLY_BUTTONORDER:
             {
             int order;
             dapi_readReplyButtonOrder( conn, &order );
-            (( dapi_ButtonOrder_callback ) data->callback )( conn, data->seq, order );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_BUTTONORDER )
+                (( dapi_ButtonOrder_callback ) data->callback )( conn, data->seq, order, data->user_data );
             break;
             }
         case DAPI_REPLY_RUNASUSER:
             {
             int ok;
             dapi_readReplyRunAsUser( conn, &ok );
-            (( dapi_RunAsUser_callback ) data->callback )( conn, data->seq, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_RUNASUSER )
+                (( dapi_RunAsUser_callback ) data->callback )( conn, data->seq, ok, data->user_data );
             break;
             }
         case DAPI_REPLY_SUSPENDSCREENSAVING:
             {
             int ok;
             dapi_readReplySuspendScreensaving( conn, &ok );
-            (( dapi_SuspendScreensaving_callback ) data->callback )( conn, data->seq, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_SUSPENDSCREENSAVING )
+                (( dapi_SuspendScreensaving_callback ) data->callback )( conn, data->seq, ok, data->user_data );
             break;
             }
         case DAPI_REPLY_MAILTO:
             {
             int ok;
             dapi_readReplyMailTo( conn, &ok );
-            (( dapi_MailTo_callback ) data->callback )( conn, data->seq, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_MAILTO )
+                (( dapi_MailTo_callback ) data->callback )( conn, data->seq, ok, data->user_data );
             break;
             }
         case DAPI_REPLY_LOCALFILE:
             {
             char* result;
             dapi_readReplyLocalFile( conn, &result );
-            (( dapi_LocalFile_callback ) data->callback )( conn, data->seq, result );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_LOCALFILE )
+                (( dapi_LocalFile_callback ) data->callback )( conn, data->seq, result, data->user_data );
+            free( result );
             break;
             }
         case DAPI_REPLY_UPLOADFILE:
             {
             int ok;
             dapi_readReplyUploadFile( conn, &ok );
-            (( dapi_UploadFile_callback ) data->callback )( conn, data->seq, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_UPLOADFILE )
+                (( dapi_UploadFile_callback ) data->callback )( conn, data->seq, ok, data->user_data );
             break;
             }
         case DAPI_REPLY_REMOVETEMPORARYLOCALFILE:
             {
             int ok;
             dapi_readReplyRemoveTemporaryLocalFile( conn, &ok );
-            (( dapi_RemoveTemporaryLocalFile_callback ) data->callback )( conn, data->seq, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_REMOVETEMPORARYLOCALFILE )
+                (( dapi_RemoveTemporaryLocalFile_callback ) data->callback )( conn, data->seq, ok, data->user_data );
             break;
             }
         case DAPI_REPLY_ADDRESSBOOKLIST:
@@ -399,7 +817,9 @@ static void genericCallbackDispatch( DapiConnection* conn, DapiCallbackData* dat
             stringarr idlist;
             int ok;
             dapi_readReplyAddressBookList( conn, &idlist, &ok );
-            (( dapi_AddressBookList_callback ) data->callback )( conn, data->seq, idlist, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_ADDRESSBOOKLIST )
+                (( dapi_AddressBookList_callback ) data->callback )( conn, data->seq, idlist, ok, data->user_data );
+            dapi_freestringarr( idlist );
             break;
             }
         case DAPI_REPLY_ADDRESSBOOKGETNAME:
@@ -409,7 +829,11 @@ static void genericCallbackDispatch( DapiConnection* conn, DapiCallbackData* dat
             char* fullname;
             int ok;
             dapi_readReplyAddressBookGetName( conn, &givenname, &familyname, &fullname, &ok );
-            (( dapi_AddressBookGetName_callback ) data->callback )( conn, data->seq, givenname, familyname, fullname, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_ADDRESSBOOKGETNAME )
+                (( dapi_AddressBookGetName_callback ) data->callback )( conn, data->seq, givenname, familyname, fullname, ok, data->user_data );
+            free( givenname );
+            free( familyname );
+            free( fullname );
             break;
             }
         case DAPI_REPLY_ADDRESSBOOKGETEMAILS:
@@ -417,7 +841,9 @@ static void genericCallbackDispatch( DapiConnection* conn, DapiCallbackData* dat
             stringarr emaillist;
             int ok;
             dapi_readReplyAddressBookGetEmails( conn, &emaillist, &ok );
-            (( dapi_AddressBookGetEmails_callback ) data->callback )( conn, data->seq, emaillist, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_ADDRESSBOOKGETEMAILS )
+                (( dapi_AddressBookGetEmails_callback ) data->callback )( conn, data->seq, emaillist, ok, data->user_data );
+            dapi_freestringarr( emaillist );
             break;
             }
         case DAPI_REPLY_ADDRESSBOOKFINDBYNAME:
@@ -425,7 +851,9 @@ static void genericCallbackDispatch( DapiConnection* conn, DapiCallbackData* dat
             stringarr idlist;
             int ok;
             dapi_readReplyAddressBookFindByName( conn, &idlist, &ok );
-            (( dapi_AddressBookFindByName_callback ) data->callback )( conn, data->seq, idlist, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_ADDRESSBOOKFINDBYNAME )
+                (( dapi_AddressBookFindByName_callback ) data->callback )( conn, data->seq, idlist, ok, data->user_data );
+            dapi_freestringarr( idlist );
             break;
             }
         case DAPI_REPLY_ADDRESSBOOKOWNER:
@@ -433,7 +861,9 @@ static void genericCallbackDispatch( DapiConnection* conn, DapiCallbackData* dat
             char* id;
             int ok;
             dapi_readReplyAddressBookOwner( conn, &id, &ok );
-            (( dapi_AddressBookOwner_callback ) data->callback )( conn, data->seq, id, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_ADDRESSBOOKOWNER )
+                (( dapi_AddressBookOwner_callback ) data->callback )( conn, data->seq, id, ok, data->user_data );
+            free( id );
             break;
             }
         case DAPI_REPLY_ADDRESSBOOKGETVCARD30:
@@ -441,68 +871,211 @@ static void genericCallbackDispatch( DapiConnection* conn, DapiCallbackData* dat
             char* vcard;
             int ok;
             dapi_readReplyAddressBookGetVCard30( conn, &vcard, &ok );
-            (( dapi_AddressBookGetVCard30_callback ) data->callback )( conn, data->seq, vcard, ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_ADDRESSBOOKGETVCARD30 )
+                (( dapi_AddressBookGetVCard30_callback ) data->callback )( conn, data->seq, vcard, ok, data->user_data );
+            free( vcard );
+            break;
+            }
+        case DAPI_REPLY_STATS:
+            {
+            intarr stats;
+            int ok;
+            dapi_readReplyStats( conn, &stats, &ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_STATS )
+                (( dapi_Stats_callback ) data->callback )( conn, data->seq, stats, ok, data->user_data );
+            dapi_freeintarr( stats );
+            break;
+            }
+        case DAPI_REPLY_SHAREDMEMORY:
+            {
+            int ok;
+            dapi_readReplySharedMemory( conn, &ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_SHAREDMEMORY )
+                (( dapi_SharedMemory_callback ) data->callback )( conn, data->seq, ok, data->user_data );
+            break;
+            }
+        case DAPI_REPLY_LOCALFILEFD:
+            {
+            char* result;
+            int file;
+            int ok;
+            dapi_readReplyLocalFileFd( conn, &result, &file, &ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_LOCALFILEFD )
+                (( dapi_LocalFileFd_callback ) data->callback )( conn, data->seq, result, file, ok, data->user_data );
+            free( result );
+            if( file >= 0 )
+                close( file );
+            break;
+            }
+        case DAPI_REPLY_PROGRESSNOTIFICATIONS:
+            {
+            int ok;
+            dapi_readReplyProgressNotifications( conn, &ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_PROGRESSNOTIFICATIONS )
+                (( dapi_ProgressNotifications_callback ) data->callback )( conn, data->seq, ok, data->user_data );
+            break;
+            }
+        case DAPI_REPLY_TRANSFERPROGRESS:
+            {
+            char* file;
+            long long processed;
+            long long total;
+            long long readable;
+            int ok;
+            dapi_readReplyTransferProgress( conn, &file, &processed, &total, &readable, &ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_TRANSFERPROGRESS )
+                (( dapi_TransferProgress_callback ) data->callback )( conn, data->seq, file, processed, total, readable, ok, data->user_data );
+            free( file );
+            break;
+            }
+        case DAPI_REPLY_SUBSCRIBE:
+            {
+            int ok;
+            dapi_readReplySubscribe( conn, &ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_SUBSCRIBE )
+                (( dapi_Subscribe_callback ) data->callback )( conn, data->seq, ok, data->user_data );
+            break;
+            }
+        case DAPI_REPLY_ADDRESSBOOKCHANGES:
+            {
+            int generation;
+            stringarr changed;
+            int ok;
+            dapi_readReplyAddressBookChanges( conn, &generation, &changed, &ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_ADDRESSBOOKCHANGES )
+                (( dapi_AddressBookChanges_callback ) data->callback )( conn, data->seq, generation, changed, ok, data->user_data );
+            dapi_freestringarr( changed );
+            break;
+            }
+        case DAPI_REPLY_SCREENSAVERSUSPENDED:
+            {
+            int suspended;
+            dapi_readReplyScreensaverSuspended( conn, &suspended );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_SCREENSAVERSUSPENDED )
+                (( dapi_ScreensaverSuspended_callback ) data->callback )( conn, data->seq, suspended, data->user_data );
+            break;
+            }
+        case DAPI_REPLY_HANDSHAKE:
+            {
+            int version;
+            int features;
+            intarr capabilities;
+            int ok;
+            dapi_readReplyHandshake( conn, &version, &features, &capabilities, &ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_HANDSHAKE )
+                (( dapi_Handshake_callback ) data->callback )( conn, data->seq, version, features, capabilities, ok, data->user_data );
+            dapi_freeintarr( capabilities );
+            break;
+            }
+        case DAPI_REPLY_GETSETTINGS:
+            {
+            stringarr values;
+            int ok;
+            dapi_readReplyGetSettings( conn, &values, &ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_GETSETTINGS )
+                (( dapi_GetSettings_callback ) data->callback )( conn, data->seq, values, ok, data->user_data );
+            dapi_freestringarr( values );
+            break;
+            }
+        case DAPI_REPLY_ADDRESSBOOKEXPORTVCARD30:
+            {
+            int count;
+            int ok;
+            dapi_readReplyAddressBookExportVCard30( conn, &count, &ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_ADDRESSBOOKEXPORTVCARD30 )
+                (( dapi_AddressBookExportVCard30_callback ) data->callback )( conn, data->seq, count, ok, data->user_data );
+            break;
+            }
+        case DAPI_REPLY_ADDRESSBOOKVCARD30CHUNK:
+            {
+            char* vcards;
+            int count;
+            int ok;
+            dapi_readReplyAddressBookVCard30Chunk( conn, &vcards, &count, &ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_ADDRESSBOOKVCARD30CHUNK )
+                (( dapi_AddressBookVCard30Chunk_callback ) data->callback )( conn, data->seq, vcards, count, ok, data->user_data );
+            free( vcards );
+            break;
+            }
+        case DAPI_REPLY_ADDRESSBOOKFINDBYEMAIL:
+            {
+            stringarr contact_ids;
+            int ok;
+            dapi_readReplyAddressBookFindByEmail( conn, &contact_ids, &ok );
+            if( data->callback != NULL && data->command == DAPI_COMMAND_ADDRESSBOOKFINDBYEMAIL )
+                (( dapi_AddressBookFindByEmail_callback ) data->callback )( conn, data->seq, contact_ids, ok, data->user_data );
+            dapi_freestringarr( contact_ids );
             break;
             }
         }
     }
 int dapi_callbackOpenUrl_Window( DapiConnection* conn, const char* url, long winfo,
-    dapi_OpenUrl_callback callback )
+    dapi_OpenUrl_callback callback, void* user_data )
     {
     DapiWindowInfo winfo_;
     dapi_windowInfoInitWindow( &winfo_, winfo );
-    int seq = dapi_callbackOpenUrl( conn, url, winfo_, callback );
+    int seq = dapi_callbackOpenUrl( conn, url, winfo_, callback, user_data );
     dapi_freeWindowInfo( winfo_ );
     return seq;
     }
 
 int dapi_callbackExecuteUrl_Window( DapiConnection* conn, const char* url, long winfo,
-    dapi_ExecuteUrl_callback callback )
+    dapi_ExecuteUrl_callback callback, void* user_data )
     {
     DapiWindowInfo winfo_;
     dapi_windowInfoInitWindow( &winfo_, winfo );
-    int seq = dapi_callbackExecuteUrl( conn, url, winfo_, callback );
+    int seq = dapi_callbackExecuteUrl( conn, url, winfo_, callback, user_data );
     dapi_freeWindowInfo( winfo_ );
     return seq;
     }
 
 int dapi_callbackRunAsUser_Window( DapiConnection* conn, const char* user, const char* command,
-    long winfo, dapi_RunAsUser_callback callback )
+    long winfo, dapi_RunAsUser_callback callback, void* user_data )
     {
     DapiWindowInfo winfo_;
     dapi_windowInfoInitWindow( &winfo_, winfo );
-    int seq = dapi_callbackRunAsUser( conn, user, command, winfo_, callback );
+    int seq = dapi_callbackRunAsUser( conn, user, command, winfo_, callback, user_data );
     dapi_freeWindowInfo( winfo_ );
     return seq;
     }
 
 int dapi_callbackMailTo_Window( DapiConnection* conn, const char* subject, const char* body,
     const char* to, const char* cc, const char* bcc, stringarr attachments, long winfo,
-    dapi_MailTo_callback callback )
+    dapi_MailTo_callback callback, void* user_data )
     {
     DapiWindowInfo winfo_;
     dapi_windowInfoInitWindow( &winfo_, winfo );
-    int seq = dapi_callbackMailTo( conn, subject, body, to, cc, bcc, attachments, winfo_, callback );
+    int seq = dapi_callbackMailTo( conn, subject, body, to, cc, bcc, attachments, winfo_, callback, user_data );
     dapi_freeWindowInfo( winfo_ );
     return seq;
     }
 
 int dapi_callbackLocalFile_Window( DapiConnection* conn, const char* remote, const char* local,
-    int allow_download, long winfo, dapi_LocalFile_callback callback )
+    int allow_download, long winfo, dapi_LocalFile_callback callback, void* user_data )
     {
     DapiWindowInfo winfo_;
     dapi_windowInfoInitWindow( &winfo_, winfo );
-    int seq = dapi_callbackLocalFile( conn, remote, local, allow_download, winfo_, callback );
+    int seq = dapi_callbackLocalFile( conn, remote, local, allow_download, winfo_, callback, user_data );
     dapi_freeWindowInfo( winfo_ );
     return seq;
     }
 
 int dapi_callbackUploadFile_Window( DapiConnection* conn, const char* local, const char* file,
-    int remove_local, long winfo, dapi_UploadFile_callback callback )
+    int remove_local, long winfo, dapi_UploadFile_callback callback, void* user_data )
+    {
+    DapiWindowInfo winfo_;
+    dapi_windowInfoInitWindow( &winfo_, winfo );
+    int seq = dapi_callbackUploadFile( conn, local, file, remove_local, winfo_, callback, user_data );
+    dapi_freeWindowInfo( winfo_ );
+    return seq;
+    }
+
+int dapi_callbackLocalFileFd_Window( DapiConnection* conn, const char* remote, const char* local,
+    int allow_download, long winfo, dapi_LocalFileFd_callback callback, void* user_data )
     {
     DapiWindowInfo winfo_;
     dapi_windowInfoInitWindow( &winfo_, winfo );
-    int seq = dapi_callbackUploadFile( conn, local, file, remove_local, winfo_, callback );
+    int seq = dapi_callbackLocalFileFd( conn, remote, local, allow_download, winfo_, callback, user_data );
     dapi_freeWindowInfo( winfo_ );
     return seq;
     }
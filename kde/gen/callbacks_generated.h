@@ -1,64 +1,129 @@
-typedef void( * dapi_Init_callback )( DapiConnection* conn, int seq, int ok );
-int dapi_callbackInit( DapiConnection* conn, dapi_Init_callback callback );
+typedef void( * dapi_Init_callback )( DapiConnection* conn, int seq, int ok, void* user_data );
+int dapi_callbackInit( DapiConnection* conn, dapi_Init_callback callback, void* user_data );
 typedef void( * dapi_Capabilities_callback )( DapiConnection* conn, int seq, intarr capabitilies,
-    int ok );
-int dapi_callbackCapabilities( DapiConnection* conn, dapi_Capabilities_callback callback );
-typedef void( * dapi_OpenUrl_callback )( DapiConnection* conn, int seq, int ok );
+    int ok, void* user_data );
+int dapi_callbackCapabilities( DapiConnection* conn, dapi_Capabilities_callback callback,
+    void* user_data );
+typedef void( * dapi_OpenUrl_callback )( DapiConnection* conn, int seq, int ok, void* user_data );
 int dapi_callbackOpenUrl( DapiConnection* conn, const char* url, DapiWindowInfo winfo,
-    dapi_OpenUrl_callback callback );
+    dapi_OpenUrl_callback callback, void* user_data );
 int dapi_callbackOpenUrl_Window( DapiConnection* conn, const char* url, long winfo,
-    dapi_OpenUrl_callback callback );
-typedef void( * dapi_ExecuteUrl_callback )( DapiConnection* conn, int seq, int ok );
+    dapi_OpenUrl_callback callback, void* user_data );
+typedef void( * dapi_ExecuteUrl_callback )( DapiConnection* conn, int seq, int ok,
+    void* user_data );
 int dapi_callbackExecuteUrl( DapiConnection* conn, const char* url, DapiWindowInfo winfo,
-    dapi_ExecuteUrl_callback callback );
+    dapi_ExecuteUrl_callback callback, void* user_data );
 int dapi_callbackExecuteUrl_Window( DapiConnection* conn, const char* url, long winfo,
-    dapi_ExecuteUrl_callback callback );
-typedef void( * dapi_ButtonOrder_callback )( DapiConnection* conn, int seq, int order );
-int dapi_callbackButtonOrder( DapiConnection* conn, dapi_ButtonOrder_callback callback );
-typedef void( * dapi_RunAsUser_callback )( DapiConnection* conn, int seq, int ok );
+    dapi_ExecuteUrl_callback callback, void* user_data );
+typedef void( * dapi_ButtonOrder_callback )( DapiConnection* conn, int seq, int order,
+    void* user_data );
+int dapi_callbackButtonOrder( DapiConnection* conn, dapi_ButtonOrder_callback callback,
+    void* user_data );
+typedef void( * dapi_RunAsUser_callback )( DapiConnection* conn, int seq, int ok, void* user_data );
 int dapi_callbackRunAsUser( DapiConnection* conn, const char* user, const char* command,
-    DapiWindowInfo winfo, dapi_RunAsUser_callback callback );
+    DapiWindowInfo winfo, dapi_RunAsUser_callback callback, void* user_data );
 int dapi_callbackRunAsUser_Window( DapiConnection* conn, const char* user, const char* command,
-    long winfo, dapi_RunAsUser_callback callback );
+    long winfo, dapi_RunAsUser_callback callback, void* user_data );
 typedef void( * dapi_SuspendScreensaving_callback )( DapiConnection* conn, int seq,
-    int ok );
-int dapi_callbackSuspendScreensaving( DapiConnection* conn, int suspend, dapi_SuspendScreensaving_callback callback );
-typedef void( * dapi_MailTo_callback )( DapiConnection* conn, int seq, int ok );
+    int ok, void* user_data );
+int dapi_callbackSuspendScreensaving( DapiConnection* conn, int suspend, dapi_SuspendScreensaving_callback callback,
+    void* user_data );
+typedef void( * dapi_MailTo_callback )( DapiConnection* conn, int seq, int ok, void* user_data );
 int dapi_callbackMailTo( DapiConnection* conn, const char* subject, const char* body,
     const char* to, const char* cc, const char* bcc, stringarr attachments, DapiWindowInfo winfo,
-    dapi_MailTo_callback callback );
+    dapi_MailTo_callback callback, void* user_data );
 int dapi_callbackMailTo_Window( DapiConnection* conn, const char* subject, const char* body,
     const char* to, const char* cc, const char* bcc, stringarr attachments, long winfo,
-    dapi_MailTo_callback callback );
-typedef void( * dapi_LocalFile_callback )( DapiConnection* conn, int seq, const char* result );
+    dapi_MailTo_callback callback, void* user_data );
+typedef void( * dapi_LocalFile_callback )( DapiConnection* conn, int seq, const char* result,
+    void* user_data );
 int dapi_callbackLocalFile( DapiConnection* conn, const char* remote, const char* local,
-    int allow_download, DapiWindowInfo winfo, dapi_LocalFile_callback callback );
+    int allow_download, DapiWindowInfo winfo, dapi_LocalFile_callback callback, void* user_data );
 int dapi_callbackLocalFile_Window( DapiConnection* conn, const char* remote, const char* local,
-    int allow_download, long winfo, dapi_LocalFile_callback callback );
-typedef void( * dapi_UploadFile_callback )( DapiConnection* conn, int seq, int ok );
+    int allow_download, long winfo, dapi_LocalFile_callback callback, void* user_data );
+typedef void( * dapi_UploadFile_callback )( DapiConnection* conn, int seq, int ok,
+    void* user_data );
 int dapi_callbackUploadFile( DapiConnection* conn, const char* local, const char* file,
-    int remove_local, DapiWindowInfo winfo, dapi_UploadFile_callback callback );
+    int remove_local, DapiWindowInfo winfo, dapi_UploadFile_callback callback, void* user_data );
 int dapi_callbackUploadFile_Window( DapiConnection* conn, const char* local, const char* file,
-    int remove_local, long winfo, dapi_UploadFile_callback callback );
+    int remove_local, long winfo, dapi_UploadFile_callback callback, void* user_data );
 typedef void( * dapi_RemoveTemporaryLocalFile_callback )( DapiConnection* conn, int seq,
-    int ok );
+    int ok, void* user_data );
 int dapi_callbackRemoveTemporaryLocalFile( DapiConnection* conn, const char* local,
-    dapi_RemoveTemporaryLocalFile_callback callback );
+    dapi_RemoveTemporaryLocalFile_callback callback, void* user_data );
 typedef void( * dapi_AddressBookList_callback )( DapiConnection* conn, int seq, stringarr idlist,
-    int ok );
-int dapi_callbackAddressBookList( DapiConnection* conn, dapi_AddressBookList_callback callback );
+    int ok, void* user_data );
+int dapi_callbackAddressBookList( DapiConnection* conn, dapi_AddressBookList_callback callback,
+    void* user_data );
 typedef void( * dapi_AddressBookGetName_callback )( DapiConnection* conn, int seq,
-    const char* givenname, const char* familyname, const char* fullname, int ok );
-int dapi_callbackAddressBookGetName( DapiConnection* conn, const char* id, dapi_AddressBookGetName_callback callback );
+    const char* givenname, const char* familyname, const char* fullname, int ok, void* user_data );
+int dapi_callbackAddressBookGetName( DapiConnection* conn, const char* id, dapi_AddressBookGetName_callback callback,
+    void* user_data );
 typedef void( * dapi_AddressBookGetEmails_callback )( DapiConnection* conn, int seq,
-    stringarr emaillist, int ok );
-int dapi_callbackAddressBookGetEmails( DapiConnection* conn, const char* id, dapi_AddressBookGetEmails_callback callback );
+    stringarr emaillist, int ok, void* user_data );
+int dapi_callbackAddressBookGetEmails( DapiConnection* conn, const char* id, dapi_AddressBookGetEmails_callback callback,
+    void* user_data );
 typedef void( * dapi_AddressBookFindByName_callback )( DapiConnection* conn, int seq,
-    stringarr idlist, int ok );
-int dapi_callbackAddressBookFindByName( DapiConnection* conn, const char* name, dapi_AddressBookFindByName_callback callback );
+    stringarr idlist, int ok, void* user_data );
+int dapi_callbackAddressBookFindByName( DapiConnection* conn, const char* name, dapi_AddressBookFindByName_callback callback,
+    void* user_data );
 typedef void( * dapi_AddressBookOwner_callback )( DapiConnection* conn, int seq, const char* id,
-    int ok );
-int dapi_callbackAddressBookOwner( DapiConnection* conn, dapi_AddressBookOwner_callback callback );
+    int ok, void* user_data );
+int dapi_callbackAddressBookOwner( DapiConnection* conn, dapi_AddressBookOwner_callback callback,
+    void* user_data );
 typedef void( * dapi_AddressBookGetVCard30_callback )( DapiConnection* conn, int seq,
-    const char* vcard, int ok );
-int dapi_callbackAddressBookGetVCard30( DapiConnection* conn, const char* id, dapi_AddressBookGetVCard30_callback callback );
+    const char* vcard, int ok, void* user_data );
+int dapi_callbackAddressBookGetVCard30( DapiConnection* conn, const char* id, dapi_AddressBookGetVCard30_callback callback,
+    void* user_data );
+typedef void( * dapi_Stats_callback )( DapiConnection* conn, int seq, intarr stats,
+    int ok, void* user_data );
+int dapi_callbackStats( DapiConnection* conn, dapi_Stats_callback callback, void* user_data );
+typedef void( * dapi_SharedMemory_callback )( DapiConnection* conn, int seq, int ok,
+    void* user_data );
+int dapi_callbackSharedMemory( DapiConnection* conn, int threshold, dapi_SharedMemory_callback callback,
+    void* user_data );
+typedef void( * dapi_LocalFileFd_callback )( DapiConnection* conn, int seq, const char* result,
+    int file, int ok, void* user_data );
+int dapi_callbackLocalFileFd( DapiConnection* conn, const char* remote, const char* local,
+    int allow_download, DapiWindowInfo winfo, dapi_LocalFileFd_callback callback, void* user_data );
+int dapi_callbackLocalFileFd_Window( DapiConnection* conn, const char* remote, const char* local,
+    int allow_download, long winfo, dapi_LocalFileFd_callback callback, void* user_data );
+typedef void( * dapi_ProgressNotifications_callback )( DapiConnection* conn, int seq,
+    int ok, void* user_data );
+int dapi_callbackProgressNotifications( DapiConnection* conn, int interval, dapi_ProgressNotifications_callback callback,
+    void* user_data );
+typedef void( * dapi_TransferProgress_callback )( DapiConnection* conn, int seq, const char* file,
+    long long processed, long long total, long long readable, int ok, void* user_data );
+int dapi_callbackTransferProgress( DapiConnection* conn, int transfer, dapi_TransferProgress_callback callback,
+    void* user_data );
+typedef void( * dapi_Subscribe_callback )( DapiConnection* conn, int seq, int ok, void* user_data );
+int dapi_callbackSubscribe( DapiConnection* conn, intarr events, dapi_Subscribe_callback callback,
+    void* user_data );
+typedef void( * dapi_AddressBookChanges_callback )( DapiConnection* conn, int seq,
+    int generation, stringarr changed, int ok, void* user_data );
+int dapi_callbackAddressBookChanges( DapiConnection* conn, int since, dapi_AddressBookChanges_callback callback,
+    void* user_data );
+typedef void( * dapi_ScreensaverSuspended_callback )( DapiConnection* conn, int seq,
+    int suspended, void* user_data );
+int dapi_callbackScreensaverSuspended( DapiConnection* conn, dapi_ScreensaverSuspended_callback callback,
+    void* user_data );
+typedef void( * dapi_Handshake_callback )( DapiConnection* conn, int seq, int version,
+    int features, intarr capabilities, int ok, void* user_data );
+int dapi_callbackHandshake( DapiConnection* conn, int client_version, int client_features,
+    dapi_Handshake_callback callback, void* user_data );
+typedef void( * dapi_GetSettings_callback )( DapiConnection* conn, int seq, stringarr values,
+    int ok, void* user_data );
+int dapi_callbackGetSettings( DapiConnection* conn, stringarr keys, dapi_GetSettings_callback callback,
+    void* user_data );
+typedef void( * dapi_AddressBookExportVCard30_callback )( DapiConnection* conn, int seq,
+    int count, int ok, void* user_data );
+int dapi_callbackAddressBookExportVCard30( DapiConnection* conn, stringarr contact_ids,
+    int chunk_size, dapi_AddressBookExportVCard30_callback callback, void* user_data );
+typedef void( * dapi_AddressBookVCard30Chunk_callback )( DapiConnection* conn, int seq,
+    const char* vcards, int count, int ok, void* user_data );
+int dapi_callbackAddressBookVCard30Chunk( DapiConnection* conn, dapi_AddressBookVCard30Chunk_callback callback,
+    void* user_data );
+typedef void( * dapi_AddressBookFindByEmail_callback )( DapiConnection* conn, int seq,
+    stringarr contact_ids, int ok, void* user_data );
+int dapi_callbackAddressBookFindByEmail( DapiConnection* conn, const char* email, dapi_AddressBookFindByEmail_callback callback,
+    void* user_data );
@@ -2,19 +2,13 @@ int dapi_Init( DapiConnection* conn )
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandInit( conn );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_INIT )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyInit( conn, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_INIT )
+        && dapi_readReplyInit( conn, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -23,19 +17,13 @@ int dapi_Capabilities( DapiConnection* conn, intarr* capabitilies )
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandCapabilities( conn );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_CAPABILITIES )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyCapabilities( conn, capabitilies, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_CAPABILITIES )
+        && dapi_readReplyCapabilities( conn, capabitilies, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -44,19 +32,13 @@ int dapi_OpenUrl( DapiConnection* conn, const char* url, DapiWindowInfo winfo )
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandOpenUrl( conn, url, winfo );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_OPENURL )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyOpenUrl( conn, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_OPENURL )
+        && dapi_readReplyOpenUrl( conn, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -65,19 +47,13 @@ int dapi_ExecuteUrl( DapiConnection* conn, const char* url, DapiWindowInfo winfo
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandExecuteUrl( conn, url, winfo );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_EXECUTEURL )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyExecuteUrl( conn, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_EXECUTEURL )
+        && dapi_readReplyExecuteUrl( conn, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -86,19 +62,13 @@ int dapi_ButtonOrder( DapiConnection* conn )
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandButtonOrder( conn );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_BUTTONORDER )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyButtonOrder( conn, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_BUTTONORDER )
+        && dapi_readReplyButtonOrder( conn, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -107,19 +77,13 @@ int dapi_RunAsUser( DapiConnection* conn, const char* user, const char* command,
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandRunAsUser( conn, user, command, winfo );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_RUNASUSER )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyRunAsUser( conn, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_RUNASUSER )
+        && dapi_readReplyRunAsUser( conn, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -128,19 +92,13 @@ int dapi_SuspendScreensaving( DapiConnection* conn, int suspend )
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandSuspendScreensaving( conn, suspend );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_SUSPENDSCREENSAVING )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplySuspendScreensaving( conn, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_SUSPENDSCREENSAVING )
+        && dapi_readReplySuspendScreensaving( conn, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -150,19 +108,13 @@ int dapi_MailTo( DapiConnection* conn, const char* subject, const char* body, co
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandMailTo( conn, subject, body, to, cc, bcc, attachments, winfo );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_MAILTO )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyMailTo( conn, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_MAILTO )
+        && dapi_readReplyMailTo( conn, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -172,21 +124,15 @@ char* dapi_LocalFile( DapiConnection* conn, const char* remote, const char* loca
     {
     int seq;
     char* ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandLocalFile( conn, remote, local, allow_download, winfo );
-    if( seq == 0 )
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_LOCALFILE )
+        && dapi_readReplyLocalFile( conn, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_LOCALFILE )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyLocalFile( conn, &ret ))
-        return 0;
-    if( ret[ 0 ] == '\0' )
+    if( ret != NULL && ret[ 0 ] == '\0' )
         {
         free( ret );
         ret = NULL;
@@ -199,19 +145,13 @@ int dapi_UploadFile( DapiConnection* conn, const char* local, const char* file,
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandUploadFile( conn, local, file, remove_local, winfo );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_UPLOADFILE )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyUploadFile( conn, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_UPLOADFILE )
+        && dapi_readReplyUploadFile( conn, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -220,19 +160,13 @@ int dapi_RemoveTemporaryLocalFile( DapiConnection* conn, const char* local )
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandRemoveTemporaryLocalFile( conn, local );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_REMOVETEMPORARYLOCALFILE )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyRemoveTemporaryLocalFile( conn, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_REMOVETEMPORARYLOCALFILE )
+        && dapi_readReplyRemoveTemporaryLocalFile( conn, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -241,19 +175,13 @@ int dapi_AddressBookList( DapiConnection* conn, stringarr* idlist )
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandAddressBookList( conn );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_ADDRESSBOOKLIST )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyAddressBookList( conn, idlist, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_ADDRESSBOOKLIST )
+        && dapi_readReplyAddressBookList( conn, idlist, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -263,19 +191,13 @@ int dapi_AddressBookGetName( DapiConnection* conn, const char* id, char** givenn
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandAddressBookGetName( conn, id );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_ADDRESSBOOKGETNAME )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyAddressBookGetName( conn, givenname, familyname, fullname, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_ADDRESSBOOKGETNAME )
+        && dapi_readReplyAddressBookGetName( conn, givenname, familyname, fullname, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -284,19 +206,13 @@ int dapi_AddressBookGetEmails( DapiConnection* conn, const char* id, stringarr*
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandAddressBookGetEmails( conn, id );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_ADDRESSBOOKGETEMAILS )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyAddressBookGetEmails( conn, emaillist, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_ADDRESSBOOKGETEMAILS )
+        && dapi_readReplyAddressBookGetEmails( conn, emaillist, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -305,19 +221,13 @@ int dapi_AddressBookFindByName( DapiConnection* conn, const char* name, stringar
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandAddressBookFindByName( conn, name );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_ADDRESSBOOKFINDBYNAME )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyAddressBookFindByName( conn, idlist, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_ADDRESSBOOKFINDBYNAME )
+        && dapi_readReplyAddressBookFindByName( conn, idlist, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -326,19 +236,13 @@ int dapi_AddressBookOwner( DapiConnection* conn, char** id )
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandAddressBookOwner( conn );
-    if( seq == 0 )
-        return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_ADDRESSBOOKOWNER )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyAddressBookOwner( conn, id, &ret ))
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_ADDRESSBOOKOWNER )
+        && dapi_readReplyAddressBookOwner( conn, id, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -347,19 +251,212 @@ int dapi_AddressBookGetVCard30( DapiConnection* conn, const char* id, char** vca
     {
     int seq;
     int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
     seq = dapi_writeCommandAddressBookGetVCard30( conn, id );
-    if( seq == 0 )
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_ADDRESSBOOKGETVCARD30 )
+        && dapi_readReplyAddressBookGetVCard30( conn, vcard, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
-    for(;;)
-        {
-        int comm, seq2;
-        if( !dapi_readCommand( conn, &comm, &seq2 ))
-            return 0;
-        if( seq2 == seq && comm == DAPI_REPLY_ADDRESSBOOKGETVCARD30 )
-            break; /* --> */
-        conn->generic_callback( conn, comm, seq2 );
-        }
-    if( !dapi_readReplyAddressBookGetVCard30( conn, vcard, &ret ))
+    return ret;
+    }
+
+int dapi_Stats( DapiConnection* conn, intarr* stats )
+    {
+    int seq;
+    int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
+    seq = dapi_writeCommandStats( conn );
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_STATS )
+        && dapi_readReplyStats( conn, stats, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
+        return 0;
+    return ret;
+    }
+
+int dapi_SharedMemory( DapiConnection* conn, int threshold )
+    {
+    int seq;
+    int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
+    seq = dapi_writeCommandSharedMemory( conn, threshold );
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_SHAREDMEMORY )
+        && dapi_readReplySharedMemory( conn, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
+        return 0;
+    return ret;
+    }
+
+int dapi_LocalFileFd( DapiConnection* conn, const char* remote, const char* local,
+    int allow_download, DapiWindowInfo winfo, char** result, int* file )
+    {
+    int seq;
+    int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
+    seq = dapi_writeCommandLocalFileFd( conn, remote, local, allow_download, winfo );
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_LOCALFILEFD )
+        && dapi_readReplyLocalFileFd( conn, result, file, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
+        return 0;
+    return ret;
+    }
+
+int dapi_ProgressNotifications( DapiConnection* conn, int interval )
+    {
+    int seq;
+    int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
+    seq = dapi_writeCommandProgressNotifications( conn, interval );
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_PROGRESSNOTIFICATIONS )
+        && dapi_readReplyProgressNotifications( conn, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
+        return 0;
+    return ret;
+    }
+
+int dapi_TransferProgress( DapiConnection* conn, int transfer, char** file, long long* processed,
+    long long* total, long long* readable )
+    {
+    int seq;
+    int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
+    seq = dapi_writeCommandTransferProgress( conn, transfer );
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_TRANSFERPROGRESS )
+        && dapi_readReplyTransferProgress( conn, file, processed, total, readable, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
+        return 0;
+    return ret;
+    }
+
+int dapi_Subscribe( DapiConnection* conn, intarr events )
+    {
+    int seq;
+    int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
+    seq = dapi_writeCommandSubscribe( conn, events );
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_SUBSCRIBE )
+        && dapi_readReplySubscribe( conn, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
+        return 0;
+    return ret;
+    }
+
+int dapi_AddressBookChanges( DapiConnection* conn, int since, int* generation, stringarr* changed )
+    {
+    int seq;
+    int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
+    seq = dapi_writeCommandAddressBookChanges( conn, since );
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_ADDRESSBOOKCHANGES )
+        && dapi_readReplyAddressBookChanges( conn, generation, changed, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
+        return 0;
+    return ret;
+    }
+
+int dapi_ScreensaverSuspended( DapiConnection* conn )
+    {
+    int seq;
+    int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
+    seq = dapi_writeCommandScreensaverSuspended( conn );
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_SCREENSAVERSUSPENDED )
+        && dapi_readReplyScreensaverSuspended( conn, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
+        return 0;
+    return ret;
+    }
+
+int dapi_Handshake( DapiConnection* conn, int client_version, int client_features,
+    int* version, int* features, intarr* capabilities )
+    {
+    int seq;
+    int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
+    seq = dapi_writeCommandHandshake( conn, client_version, client_features );
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_HANDSHAKE )
+        && dapi_readReplyHandshake( conn, version, features, capabilities, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
+        return 0;
+    return ret;
+    }
+
+int dapi_GetSettings( DapiConnection* conn, stringarr keys, stringarr* values )
+    {
+    int seq;
+    int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
+    seq = dapi_writeCommandGetSettings( conn, keys );
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_GETSETTINGS )
+        && dapi_readReplyGetSettings( conn, values, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
+        return 0;
+    return ret;
+    }
+
+int dapi_AddressBookExportVCard30( DapiConnection* conn, stringarr contact_ids, int chunk_size,
+    int* count )
+    {
+    int seq;
+    int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
+    seq = dapi_writeCommandAddressBookExportVCard30( conn, contact_ids, chunk_size );
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_ADDRESSBOOKEXPORTVCARD30 )
+        && dapi_readReplyAddressBookExportVCard30( conn, count, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
+        return 0;
+    return ret;
+    }
+
+int dapi_AddressBookVCard30Chunk( DapiConnection* conn, char** vcards, int* count )
+    {
+    int seq;
+    int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
+    seq = dapi_writeCommandAddressBookVCard30Chunk( conn );
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_ADDRESSBOOKVCARD30CHUNK )
+        && dapi_readReplyAddressBookVCard30Chunk( conn, vcards, count, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
+        return 0;
+    return ret;
+    }
+
+int dapi_AddressBookFindByEmail( DapiConnection* conn, const char* email, stringarr* contact_ids )
+    {
+    int seq;
+    int ret;
+    int ok_;
+    long long deadline_ = startCall( conn );
+    seq = dapi_writeCommandAddressBookFindByEmail( conn, email );
+    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_ADDRESSBOOKFINDBYEMAIL )
+        && dapi_readReplyAddressBookFindByEmail( conn, contact_ids, &ret );
+    endCall( conn, deadline_ );
+    if( !ok_ )
         return 0;
     return ret;
     }
@@ -422,3 +519,13 @@ int dapi_UploadFile_Window( DapiConnection* conn, const char* local, const char*
     return ret;
     }
 
+int dapi_LocalFileFd_Window( DapiConnection* conn, const char* remote, const char* local,
+    int allow_download, long winfo, char** result, int* file )
+    {
+    DapiWindowInfo winfo_;
+    dapi_windowInfoInitWindow( &winfo_, winfo );
+    int ret = dapi_LocalFileFd( conn, remote, local, allow_download, winfo_, result, file );
+    dapi_freeWindowInfo( winfo_ );
+    return ret;
+    }
+
@@ -29,3 +29,22 @@ int dapi_AddressBookGetEmails( DapiConnection* conn, const char* id, stringarr*
 int dapi_AddressBookFindByName( DapiConnection* conn, const char* name, stringarr* idlist );
 int dapi_AddressBookOwner( DapiConnection* conn, char** id );
 int dapi_AddressBookGetVCard30( DapiConnection* conn, const char* id, char** vcard );
+int dapi_Stats( DapiConnection* conn, intarr* stats );
+int dapi_SharedMemory( DapiConnection* conn, int threshold );
+int dapi_LocalFileFd( DapiConnection* conn, const char* remote, const char* local,
+    int allow_download, DapiWindowInfo winfo, char** result, int* file );
+int dapi_LocalFileFd_Window( DapiConnection* conn, const char* remote, const char* local,
+    int allow_download, long winfo, char** result, int* file );
+int dapi_ProgressNotifications( DapiConnection* conn, int interval );
+int dapi_TransferProgress( DapiConnection* conn, int transfer, char** file, long long* processed,
+    long long* total, long long* readable );
+int dapi_Subscribe( DapiConnection* conn, intarr events );
+int dapi_AddressBookChanges( DapiConnection* conn, int since, int* generation, stringarr* changed );
+int dapi_ScreensaverSuspended( DapiConnection* conn );
+int dapi_Handshake( DapiConnection* conn, int client_version, int client_features,
+    int* version, int* features, intarr* capabilities );
+int dapi_GetSettings( DapiConnection* conn, stringarr keys, stringarr* values );
+int dapi_AddressBookExportVCard30( DapiConnection* conn, stringarr contact_ids, int chunk_size,
+    int* count );
+int dapi_AddressBookVCard30Chunk( DapiConnection* conn, char** vcards, int* count );
+int dapi_AddressBookFindByEmail( DapiConnection* conn, const char* email, stringarr* contact_ids );
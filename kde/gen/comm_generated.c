@@ -38,7 +38,7 @@ int dapi_readCommandRunAsUser( DapiConnection* conn, char** user, char** command
 
 int dapi_readCommandSuspendScreensaving( DapiConnection* conn, int* suspend )
     {
-    readSocket( conn, suspend, sizeof( *suspend ));
+    readBool( conn, suspend );
     return 1;
     }
 
@@ -60,7 +60,7 @@ int dapi_readCommandLocalFile( DapiConnection* conn, char** remote, char** local
     {
     *remote = readString( conn );
     *local = readString( conn );
-    readSocket( conn, allow_download, sizeof( *allow_download ));
+    readBool( conn, allow_download );
     *winfo = readWindowInfo( conn );
     return 1;
     }
@@ -70,7 +70,7 @@ int dapi_readCommandUploadFile( DapiConnection* conn, char** local, char** file,
     {
     *local = readString( conn );
     *file = readString( conn );
-    readSocket( conn, remove_local, sizeof( *remove_local ));
+    readBool( conn, remove_local );
     *winfo = readWindowInfo( conn );
     return 1;
     }
@@ -115,52 +115,134 @@ int dapi_readCommandAddressBookGetVCard30( DapiConnection* conn, char** id )
     return 1;
     }
 
+int dapi_readCommandStats( DapiConnection* conn )
+    {
+    return 1;
+    }
+
+int dapi_readCommandSharedMemory( DapiConnection* conn, int* threshold )
+    {
+    readInt( conn, threshold );
+    return 1;
+    }
+
+int dapi_readCommandLocalFileFd( DapiConnection* conn, char** remote, char** local,
+    int* allow_download, DapiWindowInfo* winfo )
+    {
+    *remote = readString( conn );
+    *local = readString( conn );
+    readBool( conn, allow_download );
+    *winfo = readWindowInfo( conn );
+    return 1;
+    }
+
+int dapi_readCommandProgressNotifications( DapiConnection* conn, int* interval )
+    {
+    readInt( conn, interval );
+    return 1;
+    }
+
+int dapi_readCommandTransferProgress( DapiConnection* conn, int* transfer )
+    {
+    readInt( conn, transfer );
+    return 1;
+    }
+
+int dapi_readCommandSubscribe( DapiConnection* conn, intarr* events )
+    {
+    *events = readintarr( conn );
+    return 1;
+    }
+
+int dapi_readCommandAddressBookChanges( DapiConnection* conn, int* since )
+    {
+    readInt( conn, since );
+    return 1;
+    }
+
+int dapi_readCommandScreensaverSuspended( DapiConnection* conn )
+    {
+    return 1;
+    }
+
+int dapi_readCommandHandshake( DapiConnection* conn, int* client_version, int* client_features )
+    {
+    readInt( conn, client_version );
+    readInt( conn, client_features );
+    return 1;
+    }
+
+int dapi_readCommandGetSettings( DapiConnection* conn, stringarr* keys )
+    {
+    *keys = readstringarr( conn );
+    return 1;
+    }
+
+int dapi_readCommandAddressBookExportVCard30( DapiConnection* conn, stringarr* contact_ids,
+    int* chunk_size )
+    {
+    *contact_ids = readstringarr( conn );
+    readInt( conn, chunk_size );
+    return 1;
+    }
+
+int dapi_readCommandAddressBookVCard30Chunk( DapiConnection* conn )
+    {
+    return 1;
+    }
+
+int dapi_readCommandAddressBookFindByEmail( DapiConnection* conn, char** email )
+    {
+    *email = readString( conn );
+    return 1;
+    }
+
 int dapi_readReplyInit( DapiConnection* conn, int* ok )
     {
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
     return 1;
     }
 
 int dapi_readReplyCapabilities( DapiConnection* conn, intarr* capabitilies, int* ok )
     {
     *capabitilies = readintarr( conn );
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
     return 1;
     }
 
 int dapi_readReplyOpenUrl( DapiConnection* conn, int* ok )
     {
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
     return 1;
     }
 
 int dapi_readReplyExecuteUrl( DapiConnection* conn, int* ok )
     {
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
     return 1;
     }
 
 int dapi_readReplyButtonOrder( DapiConnection* conn, int* order )
     {
-    readSocket( conn, order, sizeof( *order ));
+    readInt( conn, order );
     return 1;
     }
 
 int dapi_readReplyRunAsUser( DapiConnection* conn, int* ok )
     {
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
     return 1;
     }
 
 int dapi_readReplySuspendScreensaving( DapiConnection* conn, int* ok )
     {
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
     return 1;
     }
 
 int dapi_readReplyMailTo( DapiConnection* conn, int* ok )
     {
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
     return 1;
     }
 
@@ -172,20 +254,20 @@ int dapi_readReplyLocalFile( DapiConnection* conn, char** result )
 
 int dapi_readReplyUploadFile( DapiConnection* conn, int* ok )
     {
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
     return 1;
     }
 
 int dapi_readReplyRemoveTemporaryLocalFile( DapiConnection* conn, int* ok )
     {
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
     return 1;
     }
 
 int dapi_readReplyAddressBookList( DapiConnection* conn, stringarr* idlist, int* ok )
     {
     *idlist = readstringarr( conn );
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
     return 1;
     }
 
@@ -195,7 +277,7 @@ int dapi_readReplyAddressBookGetName( DapiConnection* conn, char** givenname, ch
     *givenname = readString( conn );
     *familyname = readString( conn );
     *fullname = readString( conn );
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
     return 1;
     }
 
@@ -203,7 +285,7 @@ int dapi_readReplyAddressBookGetEmails( DapiConnection* conn, stringarr* emailli
     int* ok )
     {
     *emaillist = readstringarr( conn );
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
     return 1;
     }
 
@@ -211,21 +293,121 @@ int dapi_readReplyAddressBookFindByName( DapiConnection* conn, stringarr* idlist
     int* ok )
     {
     *idlist = readstringarr( conn );
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
     return 1;
     }
 
 int dapi_readReplyAddressBookOwner( DapiConnection* conn, char** id, int* ok )
     {
     *id = readString( conn );
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
     return 1;
     }
 
 int dapi_readReplyAddressBookGetVCard30( DapiConnection* conn, char** vcard, int* ok )
     {
     *vcard = readString( conn );
-    readSocket( conn, ok, sizeof( *ok ));
+    readBool( conn, ok );
+    return 1;
+    }
+
+int dapi_readReplyStats( DapiConnection* conn, intarr* stats, int* ok )
+    {
+    *stats = readintarr( conn );
+    readBool( conn, ok );
+    return 1;
+    }
+
+int dapi_readReplySharedMemory( DapiConnection* conn, int* ok )
+    {
+    readBool( conn, ok );
+    return 1;
+    }
+
+int dapi_readReplyLocalFileFd( DapiConnection* conn, char** result, int* file, int* ok )
+    {
+    *result = readString( conn );
+    *file = readFd( conn );
+    readBool( conn, ok );
+    return 1;
+    }
+
+int dapi_readReplyProgressNotifications( DapiConnection* conn, int* ok )
+    {
+    readBool( conn, ok );
+    return 1;
+    }
+
+int dapi_readReplyTransferProgress( DapiConnection* conn, char** file, long long* processed,
+    long long* total, long long* readable, int* ok )
+    {
+    *file = readString( conn );
+    readInt64( conn, processed );
+    readInt64( conn, total );
+    readInt64( conn, readable );
+    readBool( conn, ok );
+    return 1;
+    }
+
+int dapi_readReplySubscribe( DapiConnection* conn, int* ok )
+    {
+    readBool( conn, ok );
+    return 1;
+    }
+
+int dapi_readReplyAddressBookChanges( DapiConnection* conn, int* generation, stringarr* changed,
+    int* ok )
+    {
+    readInt( conn, generation );
+    *changed = readstringarr( conn );
+    readBool( conn, ok );
+    return 1;
+    }
+
+int dapi_readReplyScreensaverSuspended( DapiConnection* conn, int* suspended )
+    {
+    readBool( conn, suspended );
+    return 1;
+    }
+
+int dapi_readReplyHandshake( DapiConnection* conn, int* version, int* features, intarr* capabilities,
+    int* ok )
+    {
+    readInt( conn, version );
+    readInt( conn, features );
+    *capabilities = readintarr( conn );
+    readBool( conn, ok );
+    return 1;
+    }
+
+int dapi_readReplyGetSettings( DapiConnection* conn, stringarr* values, int* ok )
+    {
+    *values = readstringarr( conn );
+    readBool( conn, ok );
+    return 1;
+    }
+
+int dapi_readReplyAddressBookExportVCard30( DapiConnection* conn, int* count, int* ok )
+    {
+    readInt( conn, count );
+    readBool( conn, ok );
+    return 1;
+    }
+
+int dapi_readReplyAddressBookVCard30Chunk( DapiConnection* conn, char** vcards, int* count,
+    int* ok )
+    {
+    *vcards = readString( conn );
+    readInt( conn, count );
+    readBool( conn, ok );
+    return 1;
+    }
+
+int dapi_readReplyAddressBookFindByEmail( DapiConnection* conn, stringarr* contact_ids,
+    int* ok )
+    {
+    *contact_ids = readstringarr( conn );
+    readBool( conn, ok );
     return 1;
     }
 
@@ -233,6 +415,8 @@ int dapi_writeCommandInit( DapiConnection* conn )
     {
     int seq = getNextSeq( conn );
     writeCommand( conn, DAPI_COMMAND_INIT, seq );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -240,6 +424,8 @@ int dapi_writeCommandCapabilities( DapiConnection* conn )
     {
     int seq = getNextSeq( conn );
     writeCommand( conn, DAPI_COMMAND_CAPABILITIES, seq );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -249,6 +435,8 @@ int dapi_writeCommandOpenUrl( DapiConnection* conn, const char* url, DapiWindowI
     writeCommand( conn, DAPI_COMMAND_OPENURL, seq );
     writeString( conn, url );
     writeWindowInfo( conn, winfo );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -258,6 +446,8 @@ int dapi_writeCommandExecuteUrl( DapiConnection* conn, const char* url, DapiWind
     writeCommand( conn, DAPI_COMMAND_EXECUTEURL, seq );
     writeString( conn, url );
     writeWindowInfo( conn, winfo );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -265,6 +455,8 @@ int dapi_writeCommandButtonOrder( DapiConnection* conn )
     {
     int seq = getNextSeq( conn );
     writeCommand( conn, DAPI_COMMAND_BUTTONORDER, seq );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -276,6 +468,8 @@ int dapi_writeCommandRunAsUser( DapiConnection* conn, const char* user, const ch
     writeString( conn, user );
     writeString( conn, command );
     writeWindowInfo( conn, winfo );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -283,7 +477,9 @@ int dapi_writeCommandSuspendScreensaving( DapiConnection* conn, int suspend )
     {
     int seq = getNextSeq( conn );
     writeCommand( conn, DAPI_COMMAND_SUSPENDSCREENSAVING, seq );
-    writeSocket( conn, &suspend, sizeof( suspend ));
+    writeBool( conn, suspend );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -299,6 +495,8 @@ int dapi_writeCommandMailTo( DapiConnection* conn, const char* subject, const ch
     writeString( conn, bcc );
     writestringarr( conn, attachments );
     writeWindowInfo( conn, winfo );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -309,8 +507,10 @@ int dapi_writeCommandLocalFile( DapiConnection* conn, const char* remote, const
     writeCommand( conn, DAPI_COMMAND_LOCALFILE, seq );
     writeString( conn, remote );
     writeString( conn, local );
-    writeSocket( conn, &allow_download, sizeof( allow_download ));
+    writeBool( conn, allow_download );
     writeWindowInfo( conn, winfo );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -321,8 +521,10 @@ int dapi_writeCommandUploadFile( DapiConnection* conn, const char* local, const
     writeCommand( conn, DAPI_COMMAND_UPLOADFILE, seq );
     writeString( conn, local );
     writeString( conn, file );
-    writeSocket( conn, &remove_local, sizeof( remove_local ));
+    writeBool( conn, remove_local );
     writeWindowInfo( conn, winfo );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -331,6 +533,8 @@ int dapi_writeCommandRemoveTemporaryLocalFile( DapiConnection* conn, const char*
     int seq = getNextSeq( conn );
     writeCommand( conn, DAPI_COMMAND_REMOVETEMPORARYLOCALFILE, seq );
     writeString( conn, local );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -338,6 +542,8 @@ int dapi_writeCommandAddressBookList( DapiConnection* conn )
     {
     int seq = getNextSeq( conn );
     writeCommand( conn, DAPI_COMMAND_ADDRESSBOOKLIST, seq );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -346,6 +552,8 @@ int dapi_writeCommandAddressBookGetName( DapiConnection* conn, const char* id )
     int seq = getNextSeq( conn );
     writeCommand( conn, DAPI_COMMAND_ADDRESSBOOKGETNAME, seq );
     writeString( conn, id );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -354,6 +562,8 @@ int dapi_writeCommandAddressBookGetEmails( DapiConnection* conn, const char* id
     int seq = getNextSeq( conn );
     writeCommand( conn, DAPI_COMMAND_ADDRESSBOOKGETEMAILS, seq );
     writeString( conn, id );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -362,6 +572,8 @@ int dapi_writeCommandAddressBookFindByName( DapiConnection* conn, const char* na
     int seq = getNextSeq( conn );
     writeCommand( conn, DAPI_COMMAND_ADDRESSBOOKFINDBYNAME, seq );
     writeString( conn, name );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -369,6 +581,8 @@ int dapi_writeCommandAddressBookOwner( DapiConnection* conn )
     {
     int seq = getNextSeq( conn );
     writeCommand( conn, DAPI_COMMAND_ADDRESSBOOKOWNER, seq );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
@@ -377,13 +591,150 @@ int dapi_writeCommandAddressBookGetVCard30( DapiConnection* conn, const char* id
     int seq = getNextSeq( conn );
     writeCommand( conn, DAPI_COMMAND_ADDRESSBOOKGETVCARD30, seq );
     writeString( conn, id );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
+    return seq;
+    }
+
+int dapi_writeCommandStats( DapiConnection* conn )
+    {
+    int seq = getNextSeq( conn );
+    writeCommand( conn, DAPI_COMMAND_STATS, seq );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
+    return seq;
+    }
+
+int dapi_writeCommandSharedMemory( DapiConnection* conn, int threshold )
+    {
+    int seq = getNextSeq( conn );
+    writeCommand( conn, DAPI_COMMAND_SHAREDMEMORY, seq );
+    writeInt( conn, threshold );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
+    return seq;
+    }
+
+int dapi_writeCommandLocalFileFd( DapiConnection* conn, const char* remote, const char* local,
+    int allow_download, DapiWindowInfo winfo )
+    {
+    int seq = getNextSeq( conn );
+    writeCommand( conn, DAPI_COMMAND_LOCALFILEFD, seq );
+    writeString( conn, remote );
+    writeString( conn, local );
+    writeBool( conn, allow_download );
+    writeWindowInfo( conn, winfo );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
+    return seq;
+    }
+
+int dapi_writeCommandProgressNotifications( DapiConnection* conn, int interval )
+    {
+    int seq = getNextSeq( conn );
+    writeCommand( conn, DAPI_COMMAND_PROGRESSNOTIFICATIONS, seq );
+    writeInt( conn, interval );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
+    return seq;
+    }
+
+int dapi_writeCommandTransferProgress( DapiConnection* conn, int transfer )
+    {
+    int seq = getNextSeq( conn );
+    writeCommand( conn, DAPI_COMMAND_TRANSFERPROGRESS, seq );
+    writeInt( conn, transfer );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
+    return seq;
+    }
+
+int dapi_writeCommandSubscribe( DapiConnection* conn, intarr events )
+    {
+    int seq = getNextSeq( conn );
+    writeCommand( conn, DAPI_COMMAND_SUBSCRIBE, seq );
+    writeintarr( conn, events );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
+    return seq;
+    }
+
+int dapi_writeCommandAddressBookChanges( DapiConnection* conn, int since )
+    {
+    int seq = getNextSeq( conn );
+    writeCommand( conn, DAPI_COMMAND_ADDRESSBOOKCHANGES, seq );
+    writeInt( conn, since );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
+    return seq;
+    }
+
+int dapi_writeCommandScreensaverSuspended( DapiConnection* conn )
+    {
+    int seq = getNextSeq( conn );
+    writeCommand( conn, DAPI_COMMAND_SCREENSAVERSUSPENDED, seq );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
+    return seq;
+    }
+
+int dapi_writeCommandHandshake( DapiConnection* conn, int client_version, int client_features )
+    {
+    int seq = getNextSeq( conn );
+    writeCommand( conn, DAPI_COMMAND_HANDSHAKE, seq );
+    writeInt( conn, client_version );
+    writeInt( conn, client_features );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
+    return seq;
+    }
+
+int dapi_writeCommandGetSettings( DapiConnection* conn, stringarr keys )
+    {
+    int seq = getNextSeq( conn );
+    writeCommand( conn, DAPI_COMMAND_GETSETTINGS, seq );
+    writestringarr( conn, keys );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
+    return seq;
+    }
+
+int dapi_writeCommandAddressBookExportVCard30( DapiConnection* conn, stringarr contact_ids,
+    int chunk_size )
+    {
+    int seq = getNextSeq( conn );
+    writeCommand( conn, DAPI_COMMAND_ADDRESSBOOKEXPORTVCARD30, seq );
+    writestringarr( conn, contact_ids );
+    writeInt( conn, chunk_size );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
+    return seq;
+    }
+
+int dapi_writeCommandAddressBookVCard30Chunk( DapiConnection* conn )
+    {
+    int seq = getNextSeq( conn );
+    writeCommand( conn, DAPI_COMMAND_ADDRESSBOOKVCARD30CHUNK, seq );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
+    return seq;
+    }
+
+int dapi_writeCommandAddressBookFindByEmail( DapiConnection* conn, const char* email )
+    {
+    int seq = getNextSeq( conn );
+    writeCommand( conn, DAPI_COMMAND_ADDRESSBOOKFINDBYEMAIL, seq );
+    writeString( conn, email );
+    if( flushSocket( conn ) <= 0 )
+        return 0;
     return seq;
     }
 
 void dapi_writeReplyInit( DapiConnection* conn, int seq, int ok )
     {
     writeCommand( conn, DAPI_REPLY_INIT, seq );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyCapabilities( DapiConnection* conn, int seq, intarr capabitilies,
@@ -391,61 +742,71 @@ void dapi_writeReplyCapabilities( DapiConnection* conn, int seq, intarr capabiti
     {
     writeCommand( conn, DAPI_REPLY_CAPABILITIES, seq );
     writeintarr( conn, capabitilies );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyOpenUrl( DapiConnection* conn, int seq, int ok )
     {
     writeCommand( conn, DAPI_REPLY_OPENURL, seq );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyExecuteUrl( DapiConnection* conn, int seq, int ok )
     {
     writeCommand( conn, DAPI_REPLY_EXECUTEURL, seq );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyButtonOrder( DapiConnection* conn, int seq, int order )
     {
     writeCommand( conn, DAPI_REPLY_BUTTONORDER, seq );
-    writeSocket( conn, &order, sizeof( order ));
+    writeInt( conn, order );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyRunAsUser( DapiConnection* conn, int seq, int ok )
     {
     writeCommand( conn, DAPI_REPLY_RUNASUSER, seq );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 void dapi_writeReplySuspendScreensaving( DapiConnection* conn, int seq, int ok )
     {
     writeCommand( conn, DAPI_REPLY_SUSPENDSCREENSAVING, seq );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyMailTo( DapiConnection* conn, int seq, int ok )
     {
     writeCommand( conn, DAPI_REPLY_MAILTO, seq );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyLocalFile( DapiConnection* conn, int seq, const char* result )
     {
     writeCommand( conn, DAPI_REPLY_LOCALFILE, seq );
     writeString( conn, result );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyUploadFile( DapiConnection* conn, int seq, int ok )
     {
     writeCommand( conn, DAPI_REPLY_UPLOADFILE, seq );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyRemoveTemporaryLocalFile( DapiConnection* conn, int seq, int ok )
     {
     writeCommand( conn, DAPI_REPLY_REMOVETEMPORARYLOCALFILE, seq );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyAddressBookList( DapiConnection* conn, int seq, stringarr idlist,
@@ -453,7 +814,8 @@ void dapi_writeReplyAddressBookList( DapiConnection* conn, int seq, stringarr id
     {
     writeCommand( conn, DAPI_REPLY_ADDRESSBOOKLIST, seq );
     writestringarr( conn, idlist );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyAddressBookGetName( DapiConnection* conn, int seq, const char* givenname,
@@ -463,7 +825,8 @@ void dapi_writeReplyAddressBookGetName( DapiConnection* conn, int seq, const cha
     writeString( conn, givenname );
     writeString( conn, familyname );
     writeString( conn, fullname );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyAddressBookGetEmails( DapiConnection* conn, int seq, stringarr emaillist,
@@ -471,7 +834,8 @@ void dapi_writeReplyAddressBookGetEmails( DapiConnection* conn, int seq, stringa
     {
     writeCommand( conn, DAPI_REPLY_ADDRESSBOOKGETEMAILS, seq );
     writestringarr( conn, emaillist );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyAddressBookFindByName( DapiConnection* conn, int seq, stringarr idlist,
@@ -479,7 +843,8 @@ void dapi_writeReplyAddressBookFindByName( DapiConnection* conn, int seq, string
     {
     writeCommand( conn, DAPI_REPLY_ADDRESSBOOKFINDBYNAME, seq );
     writestringarr( conn, idlist );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyAddressBookOwner( DapiConnection* conn, int seq, const char* id,
@@ -487,7 +852,8 @@ void dapi_writeReplyAddressBookOwner( DapiConnection* conn, int seq, const char*
     {
     writeCommand( conn, DAPI_REPLY_ADDRESSBOOKOWNER, seq );
     writeString( conn, id );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 void dapi_writeReplyAddressBookGetVCard30( DapiConnection* conn, int seq, const char* vcard,
@@ -495,7 +861,124 @@ void dapi_writeReplyAddressBookGetVCard30( DapiConnection* conn, int seq, const
     {
     writeCommand( conn, DAPI_REPLY_ADDRESSBOOKGETVCARD30, seq );
     writeString( conn, vcard );
-    writeSocket( conn, &ok, sizeof( ok ));
+    writeBool( conn, ok );
+    flushSocket( conn );
+    }
+
+void dapi_writeReplyStats( DapiConnection* conn, int seq, intarr stats, int ok )
+    {
+    writeCommand( conn, DAPI_REPLY_STATS, seq );
+    writeintarr( conn, stats );
+    writeBool( conn, ok );
+    flushSocket( conn );
+    }
+
+void dapi_writeReplySharedMemory( DapiConnection* conn, int seq, int ok )
+    {
+    writeCommand( conn, DAPI_REPLY_SHAREDMEMORY, seq );
+    writeBool( conn, ok );
+    flushSocket( conn );
+    }
+
+void dapi_writeReplyLocalFileFd( DapiConnection* conn, int seq, const char* result,
+    int file, int ok )
+    {
+    writeCommand( conn, DAPI_REPLY_LOCALFILEFD, seq );
+    writeString( conn, result );
+    writeFd( conn, file );
+    writeBool( conn, ok );
+    flushSocket( conn );
+    }
+
+void dapi_writeReplyProgressNotifications( DapiConnection* conn, int seq, int ok )
+    {
+    writeCommand( conn, DAPI_REPLY_PROGRESSNOTIFICATIONS, seq );
+    writeBool( conn, ok );
+    flushSocket( conn );
+    }
+
+void dapi_writeReplyTransferProgress( DapiConnection* conn, int seq, const char* file,
+    long long processed, long long total, long long readable, int ok )
+    {
+    writeCommand( conn, DAPI_REPLY_TRANSFERPROGRESS, seq );
+    writeString( conn, file );
+    writeInt64( conn, processed );
+    writeInt64( conn, total );
+    writeInt64( conn, readable );
+    writeBool( conn, ok );
+    flushSocket( conn );
+    }
+
+void dapi_writeReplySubscribe( DapiConnection* conn, int seq, int ok )
+    {
+    writeCommand( conn, DAPI_REPLY_SUBSCRIBE, seq );
+    writeBool( conn, ok );
+    flushSocket( conn );
+    }
+
+void dapi_writeReplyAddressBookChanges( DapiConnection* conn, int seq, int generation,
+    stringarr changed, int ok )
+    {
+    writeCommand( conn, DAPI_REPLY_ADDRESSBOOKCHANGES, seq );
+    writeInt( conn, generation );
+    writestringarr( conn, changed );
+    writeBool( conn, ok );
+    flushSocket( conn );
+    }
+
+void dapi_writeReplyScreensaverSuspended( DapiConnection* conn, int seq, int suspended )
+    {
+    writeCommand( conn, DAPI_REPLY_SCREENSAVERSUSPENDED, seq );
+    writeBool( conn, suspended );
+    flushSocket( conn );
+    }
+
+void dapi_writeReplyHandshake( DapiConnection* conn, int seq, int version, int features,
+    intarr capabilities, int ok )
+    {
+    writeCommand( conn, DAPI_REPLY_HANDSHAKE, seq );
+    writeInt( conn, version );
+    writeInt( conn, features );
+    writeintarr( conn, capabilities );
+    writeBool( conn, ok );
+    flushSocket( conn );
+    }
+
+void dapi_writeReplyGetSettings( DapiConnection* conn, int seq, stringarr values,
+    int ok )
+    {
+    writeCommand( conn, DAPI_REPLY_GETSETTINGS, seq );
+    writestringarr( conn, values );
+    writeBool( conn, ok );
+    flushSocket( conn );
+    }
+
+void dapi_writeReplyAddressBookExportVCard30( DapiConnection* conn, int seq, int count,
+    int ok )
+    {
+    writeCommand( conn, DAPI_REPLY_ADDRESSBOOKEXPORTVCARD30, seq );
+    writeInt( conn, count );
+    writeBool( conn, ok );
+    flushSocket( conn );
+    }
+
+void dapi_writeReplyAddressBookVCard30Chunk( DapiConnection* conn, int seq, const char* vcards,
+    int count, int ok )
+    {
+    writeCommand( conn, DAPI_REPLY_ADDRESSBOOKVCARD30CHUNK, seq );
+    writeString( conn, vcards );
+    writeInt( conn, count );
+    writeBool( conn, ok );
+    flushSocket( conn );
+    }
+
+void dapi_writeReplyAddressBookFindByEmail( DapiConnection* conn, int seq, stringarr contact_ids,
+    int ok )
+    {
+    writeCommand( conn, DAPI_REPLY_ADDRESSBOOKFINDBYEMAIL, seq );
+    writestringarr( conn, contact_ids );
+    writeBool( conn, ok );
+    flushSocket( conn );
     }
 
 int dapi_writeCommandOpenUrl_Window( DapiConnection* conn, const char* url, long winfo )
@@ -556,3 +1039,188 @@ int dapi_writeCommandUploadFile_Window( DapiConnection* conn, const char* local,
     return seq;
     }
 
+int dapi_writeCommandLocalFileFd_Window( DapiConnection* conn, const char* remote,
+    const char* local, int allow_download, long winfo )
+    {
+    DapiWindowInfo winfo_;
+    dapi_windowInfoInitWindow( &winfo_, winfo );
+    int seq = dapi_writeCommandLocalFileFd( conn, remote, local, allow_download, winfo_ );
+    dapi_freeWindowInfo( winfo_ );
+    return seq;
+    }
+
+static int skipMessage( DapiConnection* conn, int command, int* pos )
+    {
+    switch( command )
+        {
+        case DAPI_COMMAND_INIT:
+            return 1;
+        case DAPI_REPLY_INIT:
+            return skipBool( conn, pos );
+        case DAPI_COMMAND_CAPABILITIES:
+            return 1;
+        case DAPI_REPLY_CAPABILITIES:
+            return skipintarr( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_OPENURL:
+            return skipString( conn, pos )
+                && skipWindowInfo( conn, pos );
+        case DAPI_REPLY_OPENURL:
+            return skipBool( conn, pos );
+        case DAPI_COMMAND_EXECUTEURL:
+            return skipString( conn, pos )
+                && skipWindowInfo( conn, pos );
+        case DAPI_REPLY_EXECUTEURL:
+            return skipBool( conn, pos );
+        case DAPI_COMMAND_BUTTONORDER:
+            return 1;
+        case DAPI_REPLY_BUTTONORDER:
+            return skipInt( conn, pos );
+        case DAPI_COMMAND_RUNASUSER:
+            return skipString( conn, pos )
+                && skipString( conn, pos )
+                && skipWindowInfo( conn, pos );
+        case DAPI_REPLY_RUNASUSER:
+            return skipBool( conn, pos );
+        case DAPI_COMMAND_SUSPENDSCREENSAVING:
+            return skipBool( conn, pos );
+        case DAPI_REPLY_SUSPENDSCREENSAVING:
+            return skipBool( conn, pos );
+        case DAPI_COMMAND_MAILTO:
+            return skipString( conn, pos )
+                && skipString( conn, pos )
+                && skipString( conn, pos )
+                && skipString( conn, pos )
+                && skipString( conn, pos )
+                && skipstringarr( conn, pos )
+                && skipWindowInfo( conn, pos );
+        case DAPI_REPLY_MAILTO:
+            return skipBool( conn, pos );
+        case DAPI_COMMAND_LOCALFILE:
+            return skipString( conn, pos )
+                && skipString( conn, pos )
+                && skipBool( conn, pos )
+                && skipWindowInfo( conn, pos );
+        case DAPI_REPLY_LOCALFILE:
+            return skipString( conn, pos );
+        case DAPI_COMMAND_UPLOADFILE:
+            return skipString( conn, pos )
+                && skipString( conn, pos )
+                && skipBool( conn, pos )
+                && skipWindowInfo( conn, pos );
+        case DAPI_REPLY_UPLOADFILE:
+            return skipBool( conn, pos );
+        case DAPI_COMMAND_REMOVETEMPORARYLOCALFILE:
+            return skipString( conn, pos );
+        case DAPI_REPLY_REMOVETEMPORARYLOCALFILE:
+            return skipBool( conn, pos );
+        case DAPI_COMMAND_ADDRESSBOOKLIST:
+            return 1;
+        case DAPI_REPLY_ADDRESSBOOKLIST:
+            return skipstringarr( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_ADDRESSBOOKGETNAME:
+            return skipString( conn, pos );
+        case DAPI_REPLY_ADDRESSBOOKGETNAME:
+            return skipString( conn, pos )
+                && skipString( conn, pos )
+                && skipString( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_ADDRESSBOOKGETEMAILS:
+            return skipString( conn, pos );
+        case DAPI_REPLY_ADDRESSBOOKGETEMAILS:
+            return skipstringarr( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_ADDRESSBOOKFINDBYNAME:
+            return skipString( conn, pos );
+        case DAPI_REPLY_ADDRESSBOOKFINDBYNAME:
+            return skipstringarr( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_ADDRESSBOOKOWNER:
+            return 1;
+        case DAPI_REPLY_ADDRESSBOOKOWNER:
+            return skipString( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_ADDRESSBOOKGETVCARD30:
+            return skipString( conn, pos );
+        case DAPI_REPLY_ADDRESSBOOKGETVCARD30:
+            return skipString( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_STATS:
+            return 1;
+        case DAPI_REPLY_STATS:
+            return skipintarr( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_SHAREDMEMORY:
+            return skipInt( conn, pos );
+        case DAPI_REPLY_SHAREDMEMORY:
+            return skipBool( conn, pos );
+        case DAPI_COMMAND_LOCALFILEFD:
+            return skipString( conn, pos )
+                && skipString( conn, pos )
+                && skipBool( conn, pos )
+                && skipWindowInfo( conn, pos );
+        case DAPI_REPLY_LOCALFILEFD:
+            return skipString( conn, pos )
+                && skipFd( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_PROGRESSNOTIFICATIONS:
+            return skipInt( conn, pos );
+        case DAPI_REPLY_PROGRESSNOTIFICATIONS:
+            return skipBool( conn, pos );
+        case DAPI_COMMAND_TRANSFERPROGRESS:
+            return skipInt( conn, pos );
+        case DAPI_REPLY_TRANSFERPROGRESS:
+            return skipString( conn, pos )
+                && skipInt64( conn, pos )
+                && skipInt64( conn, pos )
+                && skipInt64( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_SUBSCRIBE:
+            return skipintarr( conn, pos );
+        case DAPI_REPLY_SUBSCRIBE:
+            return skipBool( conn, pos );
+        case DAPI_COMMAND_ADDRESSBOOKCHANGES:
+            return skipInt( conn, pos );
+        case DAPI_REPLY_ADDRESSBOOKCHANGES:
+            return skipInt( conn, pos )
+                && skipstringarr( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_SCREENSAVERSUSPENDED:
+            return 1;
+        case DAPI_REPLY_SCREENSAVERSUSPENDED:
+            return skipBool( conn, pos );
+        case DAPI_COMMAND_HANDSHAKE:
+            return skipInt( conn, pos )
+                && skipInt( conn, pos );
+        case DAPI_REPLY_HANDSHAKE:
+            return skipInt( conn, pos )
+                && skipInt( conn, pos )
+                && skipintarr( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_GETSETTINGS:
+            return skipstringarr( conn, pos );
+        case DAPI_REPLY_GETSETTINGS:
+            return skipstringarr( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_ADDRESSBOOKEXPORTVCARD30:
+            return skipstringarr( conn, pos )
+                && skipInt( conn, pos );
+        case DAPI_REPLY_ADDRESSBOOKEXPORTVCARD30:
+            return skipInt( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_ADDRESSBOOKVCARD30CHUNK:
+            return 1;
+        case DAPI_REPLY_ADDRESSBOOKVCARD30CHUNK:
+            return skipString( conn, pos )
+                && skipInt( conn, pos )
+                && skipBool( conn, pos );
+        case DAPI_COMMAND_ADDRESSBOOKFINDBYEMAIL:
+            return skipString( conn, pos );
+        case DAPI_REPLY_ADDRESSBOOKFINDBYEMAIL:
+            return skipstringarr( conn, pos )
+                && skipBool( conn, pos );
+        }
+    return 1; /* unknown, only the header */
+    }
+
@@ -95,6 +95,77 @@ int dapi_writeCommandAddressBookGetVCard30( DapiConnection* conn, const char* id
 int dapi_readReplyAddressBookGetVCard30( DapiConnection* conn, char** vcard, int* ok );
 void dapi_writeReplyAddressBookGetVCard30( DapiConnection* conn, int seq, const char* vcard,
     int ok );
+int dapi_readCommandStats( DapiConnection* conn );
+int dapi_writeCommandStats( DapiConnection* conn );
+int dapi_readReplyStats( DapiConnection* conn, intarr* stats, int* ok );
+void dapi_writeReplyStats( DapiConnection* conn, int seq, intarr stats, int ok );
+int dapi_readCommandSharedMemory( DapiConnection* conn, int* threshold );
+int dapi_writeCommandSharedMemory( DapiConnection* conn, int threshold );
+int dapi_readReplySharedMemory( DapiConnection* conn, int* ok );
+void dapi_writeReplySharedMemory( DapiConnection* conn, int seq, int ok );
+int dapi_readCommandLocalFileFd( DapiConnection* conn, char** remote, char** local,
+    int* allow_download, DapiWindowInfo* winfo );
+int dapi_writeCommandLocalFileFd( DapiConnection* conn, const char* remote, const char* local,
+    int allow_download, DapiWindowInfo winfo );
+int dapi_writeCommandLocalFileFd_Window( DapiConnection* conn, const char* remote,
+    const char* local, int allow_download, long winfo );
+int dapi_readReplyLocalFileFd( DapiConnection* conn, char** result, int* file, int* ok );
+void dapi_writeReplyLocalFileFd( DapiConnection* conn, int seq, const char* result,
+    int file, int ok );
+int dapi_readCommandProgressNotifications( DapiConnection* conn, int* interval );
+int dapi_writeCommandProgressNotifications( DapiConnection* conn, int interval );
+int dapi_readReplyProgressNotifications( DapiConnection* conn, int* ok );
+void dapi_writeReplyProgressNotifications( DapiConnection* conn, int seq, int ok );
+int dapi_readCommandTransferProgress( DapiConnection* conn, int* transfer );
+int dapi_writeCommandTransferProgress( DapiConnection* conn, int transfer );
+int dapi_readReplyTransferProgress( DapiConnection* conn, char** file, long long* processed,
+    long long* total, long long* readable, int* ok );
+void dapi_writeReplyTransferProgress( DapiConnection* conn, int seq, const char* file,
+    long long processed, long long total, long long readable, int ok );
+int dapi_readCommandSubscribe( DapiConnection* conn, intarr* events );
+int dapi_writeCommandSubscribe( DapiConnection* conn, intarr events );
+int dapi_readReplySubscribe( DapiConnection* conn, int* ok );
+void dapi_writeReplySubscribe( DapiConnection* conn, int seq, int ok );
+int dapi_readCommandAddressBookChanges( DapiConnection* conn, int* since );
+int dapi_writeCommandAddressBookChanges( DapiConnection* conn, int since );
+int dapi_readReplyAddressBookChanges( DapiConnection* conn, int* generation, stringarr* changed,
+    int* ok );
+void dapi_writeReplyAddressBookChanges( DapiConnection* conn, int seq, int generation,
+    stringarr changed, int ok );
+int dapi_readCommandScreensaverSuspended( DapiConnection* conn );
+int dapi_writeCommandScreensaverSuspended( DapiConnection* conn );
+int dapi_readReplyScreensaverSuspended( DapiConnection* conn, int* suspended );
+void dapi_writeReplyScreensaverSuspended( DapiConnection* conn, int seq, int suspended );
+int dapi_readCommandHandshake( DapiConnection* conn, int* client_version, int* client_features );
+int dapi_writeCommandHandshake( DapiConnection* conn, int client_version, int client_features );
+int dapi_readReplyHandshake( DapiConnection* conn, int* version, int* features, intarr* capabilities,
+    int* ok );
+void dapi_writeReplyHandshake( DapiConnection* conn, int seq, int version, int features,
+    intarr capabilities, int ok );
+int dapi_readCommandGetSettings( DapiConnection* conn, stringarr* keys );
+int dapi_writeCommandGetSettings( DapiConnection* conn, stringarr keys );
+int dapi_readReplyGetSettings( DapiConnection* conn, stringarr* values, int* ok );
+void dapi_writeReplyGetSettings( DapiConnection* conn, int seq, stringarr values,
+    int ok );
+int dapi_readCommandAddressBookExportVCard30( DapiConnection* conn, stringarr* contact_ids,
+    int* chunk_size );
+int dapi_writeCommandAddressBookExportVCard30( DapiConnection* conn, stringarr contact_ids,
+    int chunk_size );
+int dapi_readReplyAddressBookExportVCard30( DapiConnection* conn, int* count, int* ok );
+void dapi_writeReplyAddressBookExportVCard30( DapiConnection* conn, int seq, int count,
+    int ok );
+int dapi_readCommandAddressBookVCard30Chunk( DapiConnection* conn );
+int dapi_writeCommandAddressBookVCard30Chunk( DapiConnection* conn );
+int dapi_readReplyAddressBookVCard30Chunk( DapiConnection* conn, char** vcards, int* count,
+    int* ok );
+void dapi_writeReplyAddressBookVCard30Chunk( DapiConnection* conn, int seq, const char* vcards,
+    int count, int ok );
+int dapi_readCommandAddressBookFindByEmail( DapiConnection* conn, char** email );
+int dapi_writeCommandAddressBookFindByEmail( DapiConnection* conn, const char* email );
+int dapi_readReplyAddressBookFindByEmail( DapiConnection* conn, stringarr* contact_ids,
+    int* ok );
+void dapi_writeReplyAddressBookFindByEmail( DapiConnection* conn, int seq, stringarr contact_ids,
+    int ok );
 enum
     {
     DAPI_COMMAND_INIT,
@@ -130,5 +201,32 @@ enum
     DAPI_COMMAND_ADDRESSBOOKOWNER,
     DAPI_REPLY_ADDRESSBOOKOWNER,
     DAPI_COMMAND_ADDRESSBOOKGETVCARD30,
-    DAPI_REPLY_ADDRESSBOOKGETVCARD30
+    DAPI_REPLY_ADDRESSBOOKGETVCARD30,
+    DAPI_COMMAND_STATS,
+    DAPI_REPLY_STATS,
+    DAPI_COMMAND_SHAREDMEMORY,
+    DAPI_REPLY_SHAREDMEMORY,
+    DAPI_COMMAND_LOCALFILEFD,
+    DAPI_REPLY_LOCALFILEFD,
+    DAPI_COMMAND_PROGRESSNOTIFICATIONS,
+    DAPI_REPLY_PROGRESSNOTIFICATIONS,
+    DAPI_COMMAND_TRANSFERPROGRESS,
+    DAPI_REPLY_TRANSFERPROGRESS,
+    DAPI_COMMAND_SUBSCRIBE,
+    DAPI_REPLY_SUBSCRIBE,
+    DAPI_COMMAND_ADDRESSBOOKCHANGES,
+    DAPI_REPLY_ADDRESSBOOKCHANGES,
+    DAPI_COMMAND_SCREENSAVERSUSPENDED,
+    DAPI_REPLY_SCREENSAVERSUSPENDED,
+    DAPI_COMMAND_HANDSHAKE,
+    DAPI_REPLY_HANDSHAKE,
+    DAPI_COMMAND_GETSETTINGS,
+    DAPI_REPLY_GETSETTINGS,
+    DAPI_COMMAND_ADDRESSBOOKEXPORTVCARD30,
+    DAPI_REPLY_ADDRESSBOOKEXPORTVCARD30,
+    DAPI_COMMAND_ADDRESSBOOKVCARD30CHUNK,
+    DAPI_REPLY_ADDRESSBOOKVCARD30CHUNK,
+    DAPI_COMMAND_ADDRESSBOOKFINDBYEMAIL,
+    DAPI_REPLY_ADDRESSBOOKFINDBYEMAIL,
+    DAPI_MESSAGE_COUNT
     };
@@ -7,7 +7,7 @@
 
 FUNCTION <name>
  ARG <name>
-  TYPE <type> - string, string[], int, ...
+  TYPE <type> - string, string[], int, int64, fd, ...
   OUT         - is used in reply
   RETURN      - this OUT argument is return value of high-level call
  ENDARG
@@ -22,6 +22,9 @@ struct Arg
     static QString cType( const QString& type, bool out );
     void readCommand( QTextStream& stream ) const;
     void writeCommand( QTextStream& stream ) const;
+    QString skipCommand() const;
+    QString encodingName() const;
+    void freeData( QTextStream& stream, int indent ) const;
     QString name;
     QString type;
     bool out;
@@ -53,6 +56,8 @@ struct Function
 
 QValueList< Function > functions;
 
+QString makeIndent( int indent );
+
 QFile* input_file = NULL;
 QTextStream* input_stream = NULL;
 static QString last_line;
@@ -83,12 +88,14 @@ QString Arg::cType( const QString& type, bool out )
     {
     if( type.contains( "[]" ))
         return QString( type ).replace( "[]", "arr" );
-    if( type == "bool" )
+    if( type == "bool" || type == "fd" )
         return "int";
     else if( type == "string" )
         return out ? "char*" : "const char*";
     else if( type == "windowinfo" )
         return "DapiWindowInfo";
+    else if( type == "int64" )
+        return "long long";
     else
         return type;
     }
@@ -166,8 +173,10 @@ void Arg::readCommand( QTextStream& stream ) const
         stream << "    *" << name << " = readString( conn );\n";
     else if( type == "windowinfo" )
         stream << "    *" << name << " = readWindowInfo( conn );\n";
+    else if( type == "fd" )
+        stream << "    *" << name << " = readFd( conn );\n";
     else
-        stream << "    readSocket( conn, " << name << ", sizeof( *" << name << " ));\n";
+        stream << "    read" << encodingName() << "( conn, " << name << " );\n";
     }
 
 void Arg::writeCommand( QTextStream& stream ) const
@@ -178,8 +187,50 @@ void Arg::writeCommand( QTextStream& stream ) const
         stream << "    writeString( conn, " << name << " );\n";
     else if( type == "windowinfo" )
         stream << "    writeWindowInfo( conn, " << name << " );\n";
+    else if( type == "fd" )
+        stream << "    writeFd( conn, " << name << " );\n";
+    else
+        stream << "    write" << encodingName() << "( conn, " << name << " );\n";
+    }
+
+QString Arg::skipCommand() const
+    {
+    if( type.endsWith( "[]" ))
+        return "skip" + cType( false ) + "( conn, pos )";
+    else if( type == "string" )
+        return "skipString( conn, pos )";
+    else if( type == "windowinfo" )
+        return "skipWindowInfo( conn, pos )";
+    else if( type == "fd" )
+        return "skipFd( conn, pos )";
     else
-        stream << "    writeSocket( conn, &" << name << ", sizeof( " << name << " ));\n";
+        return "skip" + encodingName() + "( conn, pos )";
+    }
+
+// simple types are encoded differently depending on the protocol version
+QString Arg::encodingName() const
+    {
+    if( type == "bool" )
+        return "Bool";
+    else if( type == "int64" )
+        return "Int64";
+    else if( type == "int" )
+        return "Int";
+    error();
+    return QString::null;
+    }
+
+void Arg::freeData( QTextStream& stream, int indent ) const
+    {
+    if( type.endsWith( "[]" ))
+        stream << makeIndent( indent ) << "dapi_free" << cType( false ) << "( " << name << " );\n";
+    else if( type == "string" )
+        stream << makeIndent( indent ) << "free( " << name << " );\n";
+    else if( type == "windowinfo" )
+        stream << makeIndent( indent ) << "dapi_freeWindowInfo( " << name << " );\n";
+    else if( type == "fd" )
+        stream << makeIndent( indent ) << "if( " << name << " >= 0 )\n"
+               << makeIndent( indent + 4 ) << "close( " << name << " );\n";
     }
 
 QString makeIndent( int indent )
@@ -259,6 +310,17 @@ void Function::generateC( QTextStream& stream, int indent, FunctionType type ) c
             line += ", ";
         line += "dapi_" + QString( name ).remove( "_Window" ) + "_callback callback";
         }
+    if( type == HighLevelCallback || type == Callback )
+        {
+        if( line.length() > 80 )
+            {
+            stream << line << ",\n";
+            line = makeIndent( indent + 4 );
+            }
+        else
+            line += ", ";
+        line += "void* user_data";
+        }
     line += " )";
     stream << line;
     }
@@ -459,7 +521,7 @@ void generateSharedCommH()
         stream << "\n    DAPI_COMMAND_" << function.name.upper()
                << ",\n    DAPI_REPLY_" << function.name.upper();
         }
-    stream << "\n    };\n";
+    stream << ",\n    DAPI_MESSAGE_COUNT\n    };\n";
     }
 
 void generateSharedCommCReadFunctions( QTextStream& stream, FunctionType type )
@@ -542,7 +604,11 @@ void generateSharedCommCWriteFunctions( QTextStream& stream, FunctionType type )
             }
         // TODO kontrola, ze nebyla chyba pri zapisu?
         if( type == WriteCommand )
-            stream << "    return seq;\n";
+            stream << "    if( flushSocket( conn ) <= 0 )\n"
+                   << "        return 0;\n"
+                   << "    return seq;\n";
+        else
+            stream << "    flushSocket( conn );\n";
         stream << "    }\n\n";
         }
     }
@@ -583,6 +649,45 @@ static void generateSharedCommCWindow( QTextStream& stream )
         }
     }
 
+static void generateSharedCommCSkip( QTextStream& stream )
+    {
+    stream << "static int skipMessage( DapiConnection* conn, int command, int* pos )\n"
+           << "    {\n"
+           << "    switch( command )\n"
+           << "        {\n";
+    for( QValueList< Function >::ConstIterator it = functions.begin();
+         it != functions.end();
+         ++it )
+        {
+        const Function& function = *it;
+        for( int reply = 0;
+             reply < 2;
+             ++reply )
+            {
+            stream << "        case " << ( reply ? "DAPI_REPLY_" : "DAPI_COMMAND_" )
+                   << function.name.upper() << ":\n"
+                   << "            return ";
+            ArgList args = reply ? Arg::stripNonOutArguments( function.args )
+                : Arg::stripOutArguments( function.args );
+            if( args.isEmpty())
+                stream << "1";
+            for( ArgList::ConstIterator it = args.begin();
+                 it != args.end();
+                 ++it )
+                {
+                const Arg& arg = (*it);
+                if( it != args.begin())
+                    stream << "\n                && ";
+                stream << arg.skipCommand();
+                }
+            stream << ";\n";
+            }
+        }
+    stream << "        }\n"
+           << "    return 1; /* unknown, only the header */\n"
+           << "    }\n\n";
+    }
+
 void generateSharedCommC()
     {
     QFile file( "comm_generated.c" );
@@ -594,6 +699,7 @@ void generateSharedCommC()
     generateSharedCommCWriteFunctions( stream, WriteCommand );
     generateSharedCommCWriteFunctions( stream, WriteReply );
     generateSharedCommCWindow( stream );
+    generateSharedCommCSkip( stream );
     }
 
 void generateSharedCallsH()
@@ -671,7 +777,9 @@ void generateSharedCallsC()
         stream << "\n    {\n"
                << "    int seq;\n";
         stream << "    " << Arg::cType( rettype, true ) << " ret;\n";
-        stream << "    seq = dapi_writeCommand" << function.name << "( conn";
+        stream << "    int ok_;\n"
+               << "    long long deadline_ = startCall( conn );\n"
+               << "    seq = dapi_writeCommand" << function.name << "( conn";
         ArgList args = Arg::stripReturnArgument( function.args );
         ArgList args1 = Arg::stripOutArguments( args );
         for( ArgList::ConstIterator it = args1.begin();
@@ -682,18 +790,8 @@ void generateSharedCallsC()
             stream << ", " << arg.name;
             }
         stream << " );\n"
-               << "    if( seq == 0 )\n"
-               << "        return 0;\n";
-        stream << "    for(;;)\n"
-               << "        {\n"
-               << "        int comm, seq2;\n"
-               << "        if( !dapi_readCommand( conn, &comm, &seq2 ))\n"
-               << "            return 0;\n"
-               << "        if( seq2 == seq && comm == DAPI_REPLY_" << function.name.upper() << " )\n"
-               << "            break; /* --> */\n"
-               << "        conn->generic_callback( conn, comm, seq2 );\n"
-               << "        }\n"
-               << "    if( !dapi_readReply" << function.name << "( conn";
+               << "    ok_ = seq != 0 && waitReply( conn, seq, DAPI_REPLY_" << function.name.upper() << " )\n"
+               << "        && dapi_readReply" << function.name << "( conn";
         ArgList args2 = Arg::stripNonOutArguments( function.args );
         for( ArgList::ConstIterator it = args2.begin();
              it != args2.end();
@@ -705,12 +803,14 @@ void generateSharedCallsC()
             else
                 stream << ", " << arg.name;
             }
-        stream << " ))\n"
+        stream << " );\n"
+               << "    endCall( conn, deadline_ );\n"
+               << "    if( !ok_ )\n"
                << "        return 0;\n";
         if( rettype == "string" )
             {
             // make sure empty return string is really seen as failure
-            stream << "    if( ret[ 0 ] == \'\\0\' )\n"
+            stream << "    if( ret != NULL && ret[ 0 ] == \'\\0\' )\n"
                    << "        {\n"
                    << "        free( ret );\n"
                    << "        ret = NULL;\n"
@@ -776,7 +876,7 @@ static void generateSharedCallbacksCWindow( QTextStream& stream )
                 }
             stream << ", " << argument.name;
             }
-        stream << ", callback );\n"
+        stream << ", callback, user_data );\n"
                << "    dapi_freeWindowInfo( winfo_ );\n"
                << "    return seq;\n"
                << "    }\n\n";
@@ -798,7 +898,10 @@ void generateSharedCallbacksC()
         stream << "\n"
                << "    {\n"
                << "    int seq;\n"
-               << "    DapiCallbackData* call;\n"
+               << "    DapiCallbackData* call = malloc( sizeof( *call ));\n"
+               << "    if( call == NULL )\n"
+               << "        return 0;\n"
+               << "    dapi_lockConnection( conn );\n"
                << "    seq = dapi_writeCommand" << function.name << "( conn";
         ArgList args2 = Arg::stripOutArguments( function.args );
         for( ArgList::ConstIterator it = args2.begin();
@@ -809,16 +912,18 @@ void generateSharedCallbacksC()
             stream << ", " << arg.name;
             }
         stream << " );\n";
-        stream << "    if( seq == 0 )\n"
-               << "        return 0;\n"
-               << "    call = malloc( sizeof( *call ));\n"
-               << "    if( call == NULL )\n"
-               << "        return 0;\n"
-               << "    call->seq = seq;\n"
-               << "    call->callback = callback;\n"
-               << "    call->command = DAPI_COMMAND_" << function.name.upper() << ";\n"
-               << "    call->next = conn->callbacks;\n"
-               << "    conn->callbacks = call;\n"
+        stream << "    if( seq != 0 )\n"
+               << "        {\n"
+               << "        call->seq = seq;\n"
+               << "        call->callback = callback;\n"
+               << "        call->user_data = user_data;\n"
+               << "        call->command = DAPI_COMMAND_" << function.name.upper() << ";\n"
+               << "        call->next = conn->callbacks;\n"
+               << "        conn->callbacks = call;\n"
+               << "        }\n"
+               << "    else\n"
+               << "        free( call );\n"
+               << "    dapi_unlockConnection( conn );\n"
                << "    return seq;\n"
                << "    }\n\n";
         }
@@ -841,8 +946,8 @@ void generateSharedCallbacksC()
             const Arg& arg = *it;
             stream << makeIndent( 12 ) << arg.cType( true ) << " " << arg.name << ";\n";
             }
-        // TODO check that command "matches" data->command? i.e. that the reply matches the expected reply
-        // for the sent command
+        // the reply is always read, even without a callback, so that the data
+        // doesn't remain in the socket and break reading of the following replies
         stream << makeIndent( 12 ) << "dapi_readReply" << function.name << "( conn";
         for( ArgList::ConstIterator it = args.begin();
              it != args.end();
@@ -852,7 +957,8 @@ void generateSharedCallbacksC()
             stream << ", &" << arg.name;
             }
         stream << " );\n"
-               << makeIndent( 12 ) << "(( dapi_" << function.name << "_callback ) data->callback )( conn, data->seq";
+               << makeIndent( 12 ) << "if( data->callback != NULL && data->command == DAPI_COMMAND_" << function.name.upper() << " )\n"
+               << makeIndent( 16 ) << "(( dapi_" << function.name << "_callback ) data->callback )( conn, data->seq";
         for( ArgList::ConstIterator it = args.begin();
              it != args.end();
              ++it )
@@ -860,9 +966,15 @@ void generateSharedCallbacksC()
             const Arg& arg = *it;
             stream << ", " << arg.name;
             }
-        // TODO tady cleanup, stejne jako u calls.c - udelat nejak genericky
-        stream << " );\n"
-               << makeIndent( 12 ) << "break;\n"
+        stream << ", data->user_data );\n";
+        for( ArgList::ConstIterator it = args.begin();
+             it != args.end();
+             ++it )
+            {
+            const Arg& arg = *it;
+            arg.freeData( stream, 12 );
+            }
+        stream << makeIndent( 12 ) << "break;\n"
                << makeIndent( 12 ) << "}\n";
         }
     stream << "        }\n"
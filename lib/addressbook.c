@@ -0,0 +1,490 @@
+#include "addressbook.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "comm_internal.h"
+
+/* Client-side cache of address book contacts. Contacts are kept in a hash
+   table keyed by the contact id, each with the results of the calls made
+   for it so far. Changes are tracked using the address book generation,
+   AddressBookChanges events remove the changed contacts, so only they are
+   fetched again. */
+
+enum { CACHED_NAME = 1, CACHED_EMAILS = 2, CACHED_VCARD = 4 };
+
+typedef struct DapiCachedContact
+    {
+    struct DapiCachedContact* next;
+    char* id;
+    int flags;
+    char* givenname;
+    char* familyname;
+    char* fullname;
+    stringarr emails;
+    char* vcard;
+    } DapiCachedContact;
+
+struct DapiAddressBookCache
+    {
+    DapiCachedContact** buckets;
+    int bucket_count;
+    int count;
+    int generation;
+    int list_valid;
+    stringarr list;
+    };
+
+static unsigned int hashId( const char* id )
+    {
+    unsigned int hash = 2166136261u;
+    for( ;
+         *id != '\0';
+         ++id )
+        hash = ( hash ^ ( unsigned char ) *id ) * 16777619u;
+    return hash;
+    }
+
+static char* copyString( const char* str )
+    {
+    return strdup( str != NULL ? str : "" );
+    }
+
+static stringarr copyStringArr( stringarr arr )
+    {
+    stringarr ret;
+    int i;
+    ret.count = 0;
+    ret.data = malloc(( arr.count + 1 ) * sizeof( char* ));
+    if( ret.data == NULL )
+        return ret;
+    for( i = 0;
+         i < arr.count;
+         ++i )
+        ret.data[ ret.count++ ] = copyString( arr.data[ i ] );
+    ret.data[ ret.count ] = NULL;
+    return ret;
+    }
+
+static void freeContact( DapiCachedContact* contact )
+    {
+    free( contact->id );
+    free( contact->givenname );
+    free( contact->familyname );
+    free( contact->fullname );
+    if( contact->flags & CACHED_EMAILS )
+        dapi_freestringarr( contact->emails );
+    free( contact->vcard );
+    free( contact );
+    }
+
+static void clearCache( DapiAddressBookCache* cache )
+    {
+    int i;
+    for( i = 0;
+         i < cache->bucket_count;
+         ++i )
+        {
+        while( cache->buckets[ i ] != NULL )
+            {
+            DapiCachedContact* next = cache->buckets[ i ]->next;
+            freeContact( cache->buckets[ i ] );
+            cache->buckets[ i ] = next;
+            }
+        }
+    cache->count = 0;
+    if( cache->list_valid )
+        dapi_freestringarr( cache->list );
+    cache->list_valid = 0;
+    }
+
+static DapiCachedContact* findContact( DapiAddressBookCache* cache, const char* id )
+    {
+    DapiCachedContact* pos;
+    for( pos = cache->buckets[ hashId( id ) & ( cache->bucket_count - 1 ) ];
+         pos != NULL;
+         pos = pos->next )
+        if( strcmp( pos->id, id ) == 0 )
+            return pos;
+    return NULL;
+    }
+
+static void removeContact( DapiAddressBookCache* cache, const char* id )
+    {
+    DapiCachedContact** pos;
+    for( pos = &cache->buckets[ hashId( id ) & ( cache->bucket_count - 1 ) ];
+         *pos != NULL;
+         pos = &( *pos )->next )
+        {
+        if( strcmp( ( *pos )->id, id ) == 0 )
+            {
+            DapiCachedContact* contact = *pos;
+            *pos = contact->next;
+            freeContact( contact );
+            --cache->count;
+            return;
+            }
+        }
+    }
+
+static void growCache( DapiAddressBookCache* cache )
+    {
+    int count = cache->bucket_count * 2;
+    DapiCachedContact** buckets = calloc( count, sizeof( DapiCachedContact* ));
+    int i;
+    if( buckets == NULL )
+        return; /* just longer chains */
+    for( i = 0;
+         i < cache->bucket_count;
+         ++i )
+        {
+        while( cache->buckets[ i ] != NULL )
+            {
+            DapiCachedContact* contact = cache->buckets[ i ];
+            int bucket = hashId( contact->id ) & ( count - 1 );
+            cache->buckets[ i ] = contact->next;
+            contact->next = buckets[ bucket ];
+            buckets[ bucket ] = contact;
+            }
+        }
+    free( cache->buckets );
+    cache->buckets = buckets;
+    cache->bucket_count = count;
+    }
+
+static DapiCachedContact* addContact( DapiAddressBookCache* cache, const char* id )
+    {
+    DapiCachedContact* contact = findContact( cache, id );
+    int bucket;
+    if( contact != NULL )
+        return contact;
+    contact = calloc( 1, sizeof( DapiCachedContact ));
+    if( contact == NULL )
+        return NULL;
+    contact->id = strdup( id );
+    if( contact->id == NULL )
+        {
+        free( contact );
+        return NULL;
+        }
+    if( cache->count >= cache->bucket_count )
+        growCache( cache );
+    bucket = hashId( id ) & ( cache->bucket_count - 1 );
+    contact->next = cache->buckets[ bucket ];
+    cache->buckets[ bucket ] = contact;
+    ++cache->count;
+    return contact;
+    }
+
+/* Applies changes reported by AddressBookChanges (an event or a reply). Changes
+   are always reported in order, so older generations have already been applied. */
+static void applyChanges( DapiAddressBookCache* cache, int generation, stringarr changed, int ok )
+    {
+    int i;
+    if( !ok )
+        { /* the daemon doesn't know the generation, start from scratch */
+        clearCache( cache );
+        cache->generation = generation;
+        return;
+        }
+    if( generation <= cache->generation )
+        return;
+    for( i = 0;
+         i < changed.count;
+         ++i )
+        removeContact( cache, changed.data[ i ] );
+    if( cache->list_valid && changed.count > 0 )
+        {
+        dapi_freestringarr( cache->list );
+        cache->list_valid = 0;
+        }
+    cache->generation = generation;
+    }
+
+/* Adds the AddressBookChanges event to the client's subscriptions. */
+static int subscribeChanges( DapiConnection* conn )
+    {
+    intarr events;
+    int ok;
+    if( dapi_isSubscribed( conn, DAPI_COMMAND_ADDRESSBOOKCHANGES ))
+        return 1;
+    events.count = conn->subscriptions.count + 1;
+    events.data = malloc( events.count * sizeof( int ));
+    if( events.data == NULL )
+        return 0;
+    if( conn->subscriptions.count > 0 )
+        memcpy( events.data, conn->subscriptions.data, conn->subscriptions.count * sizeof( int ));
+    events.data[ events.count - 1 ] = DAPI_COMMAND_ADDRESSBOOKCHANGES;
+    ok = dapi_Subscribe( conn, events );
+    if( ok )
+        dapi_setSubscriptions( conn, events );
+    dapi_freeintarr( events );
+    return ok;
+    }
+
+static int syncCache( DapiConnection* conn );
+static void closeCache( DapiConnection* conn );
+
+/* Threads using the shared connection share its cache, so the functions below
+   hold the connection lock, which is held also when events are dispatched. */
+static int enableCache( DapiConnection* conn )
+    {
+    DapiAddressBookCache* cache;
+    if( conn->addressbook_cache != NULL )
+        return 1;
+    if( !dapi_hasCapability( conn, DAPI_COMMAND_ADDRESSBOOKCHANGES ))
+        return 0;
+    cache = calloc( 1, sizeof( DapiAddressBookCache ));
+    if( cache == NULL )
+        return 0;
+    cache->bucket_count = 64;
+    cache->buckets = calloc( cache->bucket_count, sizeof( DapiCachedContact* ));
+    if( cache->buckets == NULL )
+        {
+        free( cache );
+        return 0;
+        }
+    /* without events the client has to call dapi_syncAddressBookCache() */
+    if( dapi_hasCapability( conn, DAPI_COMMAND_SUBSCRIBE ))
+        subscribeChanges( conn );
+    conn->addressbook_cache = cache;
+    /* subscribed first, so no change between getting the generation and the first event is lost */
+    if( !syncCache( conn ))
+        {
+        closeCache( conn );
+        return 0;
+        }
+    return 1;
+    }
+
+int dapi_enableAddressBookCache( DapiConnection* conn )
+    {
+    int ok;
+    dapi_lockConnection( conn );
+    ok = enableCache( conn );
+    dapi_unlockConnection( conn );
+    return ok;
+    }
+
+static int syncCache( DapiConnection* conn )
+    {
+    DapiAddressBookCache* cache = conn->addressbook_cache;
+    int generation;
+    stringarr changed;
+    int ok;
+    if( cache == NULL )
+        return 0;
+    changed.count = 0;
+    changed.data = NULL;
+    ok = dapi_AddressBookChanges( conn, cache->generation, &generation, &changed );
+    if( ok )
+        applyChanges( cache, generation, changed, ok );
+    else
+        {
+        clearCache( cache );
+        cache->generation = 0;
+        }
+    dapi_freestringarr( changed );
+    return ok;
+    }
+
+int dapi_syncAddressBookCache( DapiConnection* conn )
+    {
+    int ok;
+    dapi_lockConnection( conn );
+    ok = syncCache( conn );
+    dapi_unlockConnection( conn );
+    return ok;
+    }
+
+void dapi_addressBookCacheChanged( DapiConnection* conn, int seq, int generation, stringarr changed,
+    int ok, void* user_data )
+    {
+    DapiCallbackData* event = user_data;
+    if( conn->addressbook_cache != NULL )
+        applyChanges( conn->addressbook_cache, generation, changed, ok );
+    if( event != NULL && event->callback != NULL )
+        (( dapi_AddressBookChanges_callback ) event->callback )( conn, seq, generation, changed, ok,
+            event->user_data );
+    }
+
+static void closeCache( DapiConnection* conn )
+    {
+    DapiAddressBookCache* cache = conn->addressbook_cache;
+    if( cache == NULL )
+        return;
+    clearCache( cache );
+    free( cache->buckets );
+    free( cache );
+    conn->addressbook_cache = NULL;
+    }
+
+void dapi_addressBookCacheClose( DapiConnection* conn )
+    {
+    dapi_lockConnection( conn );
+    closeCache( conn );
+    dapi_unlockConnection( conn );
+    }
+
+static int listCached( DapiConnection* conn, stringarr* idlist )
+    {
+    DapiAddressBookCache* cache = conn->addressbook_cache;
+    stringarr list;
+    if( cache == NULL )
+        return dapi_AddressBookList( conn, idlist );
+    if( !cache->list_valid )
+        {
+        list.count = 0;
+        list.data = NULL;
+        if( !dapi_AddressBookList( conn, &list ))
+            {
+            dapi_freestringarr( list );
+            return 0;
+            }
+        if( cache->list_valid )
+            dapi_freestringarr( cache->list );
+        cache->list = list;
+        cache->list_valid = 1;
+        }
+    *idlist = copyStringArr( cache->list );
+    return idlist->data != NULL;
+    }
+
+int dapi_AddressBookListCached( DapiConnection* conn, stringarr* idlist )
+    {
+    int ok;
+    dapi_lockConnection( conn );
+    ok = listCached( conn, idlist );
+    dapi_unlockConnection( conn );
+    return ok;
+    }
+
+static int getNameCached( DapiConnection* conn, const char* id, char** givenname,
+    char** familyname, char** fullname )
+    {
+    DapiCachedContact* contact;
+    if( conn->addressbook_cache == NULL )
+        return dapi_AddressBookGetName( conn, id, givenname, familyname, fullname );
+    contact = findContact( conn->addressbook_cache, id );
+    if( contact == NULL || ( contact->flags & CACHED_NAME ) == 0 )
+        {
+        char* given = NULL;
+        char* family = NULL;
+        char* full = NULL;
+        /* failures are not cached, the contact may be added later */
+        if( !dapi_AddressBookGetName( conn, id, &given, &family, &full ))
+            {
+            free( given );
+            free( family );
+            free( full );
+            return 0;
+            }
+        /* events processed while waiting for the reply may have removed the contact */
+        contact = addContact( conn->addressbook_cache, id );
+        if( contact == NULL )
+            {
+            *givenname = given;
+            *familyname = family;
+            *fullname = full;
+            return 1;
+            }
+        free( contact->givenname );
+        free( contact->familyname );
+        free( contact->fullname );
+        contact->givenname = given;
+        contact->familyname = family;
+        contact->fullname = full;
+        contact->flags |= CACHED_NAME;
+        }
+    *givenname = copyString( contact->givenname );
+    *familyname = copyString( contact->familyname );
+    *fullname = copyString( contact->fullname );
+    return 1;
+    }
+
+int dapi_AddressBookGetNameCached( DapiConnection* conn, const char* id, char** givenname,
+    char** familyname, char** fullname )
+    {
+    int ok;
+    dapi_lockConnection( conn );
+    ok = getNameCached( conn, id, givenname, familyname, fullname );
+    dapi_unlockConnection( conn );
+    return ok;
+    }
+
+static int getEmailsCached( DapiConnection* conn, const char* id, stringarr* emaillist )
+    {
+    DapiCachedContact* contact;
+    if( conn->addressbook_cache == NULL )
+        return dapi_AddressBookGetEmails( conn, id, emaillist );
+    contact = findContact( conn->addressbook_cache, id );
+    if( contact == NULL || ( contact->flags & CACHED_EMAILS ) == 0 )
+        {
+        stringarr emails;
+        emails.count = 0;
+        emails.data = NULL;
+        if( !dapi_AddressBookGetEmails( conn, id, &emails ))
+            {
+            dapi_freestringarr( emails );
+            return 0;
+            }
+        contact = addContact( conn->addressbook_cache, id );
+        if( contact == NULL )
+            {
+            *emaillist = emails;
+            return 1;
+            }
+        if( contact->flags & CACHED_EMAILS )
+            dapi_freestringarr( contact->emails );
+        contact->emails = emails;
+        contact->flags |= CACHED_EMAILS;
+        }
+    *emaillist = copyStringArr( contact->emails );
+    return emaillist->data != NULL;
+    }
+
+int dapi_AddressBookGetEmailsCached( DapiConnection* conn, const char* id, stringarr* emaillist )
+    {
+    int ok;
+    dapi_lockConnection( conn );
+    ok = getEmailsCached( conn, id, emaillist );
+    dapi_unlockConnection( conn );
+    return ok;
+    }
+
+static int getVCard30Cached( DapiConnection* conn, const char* id, char** vcard )
+    {
+    DapiCachedContact* contact;
+    if( conn->addressbook_cache == NULL )
+        return dapi_AddressBookGetVCard30( conn, id, vcard );
+    contact = findContact( conn->addressbook_cache, id );
+    if( contact == NULL || ( contact->flags & CACHED_VCARD ) == 0 )
+        {
+        char* card = NULL;
+        if( !dapi_AddressBookGetVCard30( conn, id, &card ))
+            {
+            free( card );
+            return 0;
+            }
+        contact = addContact( conn->addressbook_cache, id );
+        if( contact == NULL )
+            {
+            *vcard = card;
+            return 1;
+            }
+        free( contact->vcard );
+        contact->vcard = card;
+        contact->flags |= CACHED_VCARD;
+        }
+    *vcard = copyString( contact->vcard );
+    return 1;
+    }
+
+int dapi_AddressBookGetVCard30Cached( DapiConnection* conn, const char* id, char** vcard )
+    {
+    int ok;
+    dapi_lockConnection( conn );
+    ok = getVCard30Cached( conn, id, vcard );
+    dapi_unlockConnection( conn );
+    return ok;
+    }
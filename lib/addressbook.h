@@ -0,0 +1,23 @@
+#ifndef DAPI_ADDRESSBOOK_H
+#define DAPI_ADDRESSBOOK_H
+
+#include <dapi/comm.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int dapi_enableAddressBookCache( DapiConnection* conn );
+int dapi_syncAddressBookCache( DapiConnection* conn );
+
+int dapi_AddressBookListCached( DapiConnection* conn, stringarr* idlist );
+int dapi_AddressBookGetNameCached( DapiConnection* conn, const char* id, char** givenname,
+    char** familyname, char** fullname );
+int dapi_AddressBookGetEmailsCached( DapiConnection* conn, const char* id, stringarr* emaillist );
+int dapi_AddressBookGetVCard30Cached( DapiConnection* conn, const char* id, char** vcard );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,7 +1,9 @@
 #include "callbacks.h"
 
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "comm_internal.h"
 
@@ -16,35 +18,223 @@ DapiGenericCallback dapi_setGenericCallback( DapiConnection* conn, DapiGenericCa
 
 void dapi_processData( DapiConnection* conn )
     {
-    while( dapi_hasData( conn ))
+    dapi_lockConnection( conn );
+    /* only complete messages are processed, so this never blocks */
+    dapi_receiveData( conn );
+    while( dapi_hasCommand( conn ))
         {
         int command;
         int seq;
         if( !dapi_readCommand( conn, &command, &seq ))
-            return; /* TODO error-handling? */
+            break; /* TODO error-handling? */
         conn->generic_callback( conn, command, seq );
         }
+    dapi_unlockConnection( conn );
+    }
+
+int dapi_watchEvents( DapiConnection* conn )
+    {
+    return POLLIN | ( dapi_hasUnsentData( conn ) ? POLLOUT : 0 );
+    }
+
+int dapi_dispatch( DapiConnection* conn, int events )
+    {
+    int ok = 1;
+    dapi_lockConnection( conn );
+    if(( events & POLLOUT ) && dapi_hasUnsentData( conn ) && !dapi_sendData( conn ))
+        ok = 0;
+    if( ok && ( events & ( POLLIN | POLLHUP | POLLERR )))
+        {
+        ok = dapi_receiveData( conn );
+        /* complete replies received before a failure are still passed on */
+        while( dapi_hasCommand( conn ))
+            {
+            int command;
+            int seq;
+            if( !dapi_readCommand( conn, &command, &seq ))
+                {
+                ok = 0;
+                break;
+                }
+            conn->generic_callback( conn, command, seq );
+            }
+        }
+    dapi_unlockConnection( conn );
+    return ok;
+    }
+
+/* Messages that come with the seq of a call before its reply. */
+static int isNotification( int command )
+    {
+    return command == DAPI_REPLY_TRANSFERPROGRESS || command == DAPI_REPLY_ADDRESSBOOKVCARD30CHUNK;
     }
 
 void dapi_genericCallback( DapiConnection* conn, int command, int seq )
     {
     DapiCallbackData* pos;
     DapiCallbackData* prev = NULL;
+    DapiCallbackData unhandled;
+    if( seq == 0 )
+        { /* an event the client has subscribed to */
+        for( pos = conn->events;
+             pos != NULL;
+             pos = pos->next )
+            if( pos->command + 1 == command )
+                break;
+        if( command == DAPI_REPLY_ADDRESSBOOKCHANGES && conn->addressbook_cache != NULL )
+            { /* update the cache first, it passes the event on */
+            DapiCallbackData changes;
+            changes.next = NULL;
+            changes.seq = seq;
+            changes.command = DAPI_COMMAND_ADDRESSBOOKCHANGES;
+            changes.callback = dapi_addressBookCacheChanged;
+            changes.user_data = pos;
+            genericCallbackDispatch( conn, &changes, command, seq );
+            return;
+            }
+        if( pos != NULL )
+            {
+            genericCallbackDispatch( conn, pos, command, seq );
+            return;
+            }
+        }
     for( pos = conn->callbacks;
          pos != NULL;
          prev = pos, pos = pos->next )
         {
-        if( pos->seq == seq )
+        /* progress notifications come with the seq of the transfer, before its reply,
+           and so do vCard chunks of an export */
+        if( pos->seq == seq && pos->command == CANCELLED_CALL && isNotification( command ))
+            { /* still waiting for the reply itself */
+            genericCallbackDispatch( conn, pos, command, seq );
+            return;
+            }
+        if( pos->seq == seq && ( !isNotification( command ) || pos->command + 1 == command ))
             {
-            if( pos->callback != NULL )
-                genericCallbackDispatch( conn, pos, command, seq );
             if( prev != NULL )
-                prev = pos->next;
+                prev->next = pos->next;
             else
                 conn->callbacks = pos->next;
+            genericCallbackDispatch( conn, pos, command, seq );
             free( pos );
             return;
             }
         }
-/* TODO handle unhandled */
+    if( command == DAPI_REPLY_TRANSFERPROGRESS )
+        {
+        DapiCallbackData progress;
+        progress.next = NULL;
+        progress.seq = seq;
+        progress.command = DAPI_COMMAND_TRANSFERPROGRESS;
+        progress.callback = conn->progress_callback;
+        progress.user_data = conn->progress_user_data;
+        genericCallbackDispatch( conn, &progress, command, seq );
+        return;
+        }
+    if( command == DAPI_REPLY_ADDRESSBOOKVCARD30CHUNK )
+        {
+        DapiCallbackData chunk;
+        chunk.next = NULL;
+        chunk.seq = seq;
+        chunk.command = DAPI_COMMAND_ADDRESSBOOKVCARD30CHUNK;
+        chunk.callback = conn->vcard_chunk_callback;
+        chunk.user_data = conn->vcard_chunk_user_data;
+        genericCallbackDispatch( conn, &chunk, command, seq );
+        return;
+        }
+    /* nobody waits for this reply, read it anyway to keep the connection in sync */
+    unhandled.next = NULL;
+    unhandled.seq = seq;
+    unhandled.command = -1;
+    unhandled.callback = NULL;
+    unhandled.user_data = NULL;
+    genericCallbackDispatch( conn, &unhandled, command, seq );
+    }
+
+void dapi_setProgressCallback( DapiConnection* conn, dapi_TransferProgress_callback callback,
+    void* user_data )
+    {
+    conn->progress_callback = callback;
+    conn->progress_user_data = user_data;
+    }
+
+void dapi_setVCard30ChunkCallback( DapiConnection* conn, dapi_AddressBookVCard30Chunk_callback callback,
+    void* user_data )
+    {
+    conn->vcard_chunk_callback = callback;
+    conn->vcard_chunk_user_data = user_data;
+    }
+
+int dapi_setEventCallback( DapiConnection* conn, int event, void* callback, void* user_data )
+    {
+    DapiCallbackData* pos;
+    DapiCallbackData* prev = NULL;
+    for( pos = conn->events;
+         pos != NULL;
+         prev = pos, pos = pos->next )
+        if( pos->command == event )
+            break;
+    if( callback == NULL )
+        {
+        if( pos != NULL )
+            {
+            if( prev != NULL )
+                prev->next = pos->next;
+            else
+                conn->events = pos->next;
+            free( pos );
+            }
+        return 1;
+        }
+    if( pos == NULL )
+        {
+        pos = malloc( sizeof( DapiCallbackData ));
+        if( pos == NULL )
+            return 0;
+        pos->seq = 0;
+        pos->command = event;
+        pos->next = conn->events;
+        conn->events = pos;
+        }
+    pos->callback = callback;
+    pos->user_data = user_data;
+    return 1;
+    }
+
+/* The entry of a cancelled call stays until its reply arrives, so that the reply
+   and the notifications before it are dropped by their seq. */
+int dapi_cancel( DapiConnection* conn, int seq )
+    {
+    DapiCallbackData* pos;
+    int ret = 0;
+    dapi_lockConnection( conn );
+    for( pos = conn->callbacks;
+         pos != NULL;
+         pos = pos->next )
+        {
+        if( pos->seq == seq && pos->command != CANCELLED_CALL )
+            {
+            pos->command = CANCELLED_CALL;
+            pos->callback = NULL;
+            pos->user_data = NULL;
+            ret = 1;
+            break;
+            }
+        }
+    dapi_unlockConnection( conn );
+    return ret;
+    }
+
+int dapi_dropReply( DapiConnection* conn, int seq )
+    {
+    DapiCallbackData* call = malloc( sizeof( *call ));
+    if( call == NULL )
+        return 0;
+    call->seq = seq;
+    call->command = CANCELLED_CALL;
+    call->callback = NULL;
+    call->user_data = NULL;
+    call->next = conn->callbacks;
+    conn->callbacks = call;
+    return 1;
     }
@@ -15,8 +15,22 @@ DapiGenericCallback dapi_setGenericCallback( DapiConnection* conn, DapiGenericCa
 
 void dapi_processData( DapiConnection* conn );
 
+int dapi_watchEvents( DapiConnection* conn );
+
+int dapi_dispatch( DapiConnection* conn, int events );
+
 void dapi_genericCallback( DapiConnection* conn, int command, int seq );
 
+void dapi_setProgressCallback( DapiConnection* conn, dapi_TransferProgress_callback callback,
+    void* user_data );
+
+void dapi_setVCard30ChunkCallback( DapiConnection* conn, dapi_AddressBookVCard30Chunk_callback callback,
+    void* user_data );
+
+int dapi_setEventCallback( DapiConnection* conn, int event, void* callback, void* user_data );
+
+int dapi_cancel( DapiConnection* conn, int seq );
+
 #ifdef __cplusplus
 }
 #endif
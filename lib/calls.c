@@ -6,4 +6,114 @@
 #include "comm.h"
 #include "comm_internal.h"
 
+/* Returns the previous deadline, to be passed to endCall(). */
+static long long startCall( DapiConnection* conn )
+    {
+    dapi_lockConnection( conn );
+    return dapi_startDeadline( conn );
+    }
+
+static void endCall( DapiConnection* conn, long long deadline )
+    {
+    dapi_restoreDeadline( conn, deadline );
+    dapi_unlockConnection( conn );
+    }
+
+/* Reads incoming data until the header of the given reply arrives, replies
+   to other calls are passed to the generic callback. If this fails because
+   of a timeout, the call is handled as cancelled and its late reply will be
+   discarded by dapi_genericCallback(). */
+static int waitReply( DapiConnection* conn, int seq, int reply )
+    {
+    for(;;)
+        {
+        int comm, seq2;
+        if( !dapi_readCommand( conn, &comm, &seq2 ))
+            { /* only a call given up on may still get its reply */
+            if( conn->timed_out )
+                dapi_dropReply( conn, seq );
+            return 0;
+            }
+        if( seq2 == seq && comm == reply )
+            return 1;
+        conn->generic_callback( conn, comm, seq2 );
+        }
+    }
+
 #include <dapi/calls_generated.c>
+
+/* Sends Handshake and Init together in one batch, so that both take only one
+   round trip. Daemons older than Handshake skip only the header of the unknown
+   command, then fail to read its arguments as the next message and close
+   the connection without any reply. The client then connects again and sends
+   only Init, so the connection stays at protocol version 1. */
+int dapi_handshakeAndInit( DapiConnection* conn )
+    {
+    int handshake_seq;
+    int init_seq;
+    int replied = 0;
+    int ok = 0;
+    long long deadline = startCall( conn );
+    dapi_beginBatch( conn );
+    handshake_seq = dapi_writeCommandHandshake( conn, DAPI_PROTOCOL_VERSION, DAPI_CLIENT_FEATURES );
+    init_seq = dapi_writeCommandInit( conn );
+    if( dapi_endBatch( conn ) && handshake_seq != 0 && init_seq != 0 )
+        {
+        for(;;)
+            {
+            int comm, seq;
+            if( !dapi_readCommand( conn, &comm, &seq ))
+                break;
+            if( seq == handshake_seq && comm == DAPI_REPLY_HANDSHAKE )
+                {
+                int version, features, handshake_ok;
+                intarr capabilities;
+                if( dapi_readReplyHandshake( conn, &version, &features, &capabilities, &handshake_ok )
+                    && handshake_ok )
+                    {
+                    /* a daemon must not pick a version the client does not know */
+                    conn->protocol_version = version >= 1 && version <= DAPI_PROTOCOL_VERSION ? version : 1;
+                    conn->features = features & DAPI_CLIENT_FEATURES;
+                    dapi_freeintarr( conn->capabilities );
+                    conn->capabilities = capabilities;
+                    conn->capabilities_known = 1;
+                    }
+                else
+                    dapi_freeintarr( capabilities );
+                replied = 1;
+                continue;
+                }
+            if( seq == init_seq && comm == DAPI_REPLY_INIT )
+                {
+                dapi_readReplyInit( conn, &ok );
+                replied = 1;
+                break;
+                }
+            conn->generic_callback( conn, comm, seq );
+            }
+        }
+    endCall( conn, deadline );
+    if( !replied && !conn->memory && dapi_reopenSocket( conn ))
+        ok = dapi_Init( conn );
+    return ok;
+    }
+
+int dapi_hasCapability( DapiConnection* conn, int command )
+    {
+    int i;
+    if( !conn->capabilities_known )
+        { /* no Handshake with older daemons */
+        intarr capabilities;
+        if( !dapi_Capabilities( conn, &capabilities ))
+            return 0;
+        dapi_freeintarr( conn->capabilities );
+        conn->capabilities = capabilities;
+        conn->capabilities_known = 1;
+        }
+    for( i = 0;
+         i < conn->capabilities.count;
+         ++i )
+        if( conn->capabilities.data[ i ] == command )
+            return 1;
+    return 0;
+    }
@@ -1,18 +1,28 @@
+#define _GNU_SOURCE /* memfd_create(), F_ADD_SEALS */
+#include <config.h>
+
 #include "comm.h"
 
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "comm_internal.h"
 #include "callbacks.h"
+#include "addressbook.h"
 
 static void getDisplay( char* ret, int max )
     {
@@ -33,132 +43,1296 @@ static void getDisplay( char* ret, int max )
         *pos = '\0';
     }
 
-static void socketName( char* sock_file, int max )
+static char runtime_sock_file[ 256 ];
+static char legacy_sock_file[ 256 ];
+static int sock_files_ready = 0;
+
+/* The socket is in $XDG_RUNTIME_DIR (a local, per-user directory) if available,
+   the legacy location in $HOME may be on NFS. Both are computed only once. */
+static void socketNames( void )
+    {
+    const char* home;
+    const char* runtime_dir;
+    char display[ 256 ];
+    struct stat st;
+    if( sock_files_ready )
+        return;
+    home = getenv( "HOME" );
+    getDisplay( display, 255 );
+    snprintf( legacy_sock_file, 255, "%s/.dapi-%s", home, display );
+    runtime_dir = getenv( "XDG_RUNTIME_DIR" );
+    runtime_sock_file[ 0 ] = '\0';
+    if( runtime_dir != NULL && *runtime_dir == '/' && stat( runtime_dir, &st ) == 0
+        && S_ISDIR( st.st_mode ) && st.st_uid == getuid())
+        snprintf( runtime_sock_file, 255, "%s/dapi-%s", runtime_dir, display );
+    sock_files_ready = 1;
+    }
+
+/* The socket the daemon listens on. */
+static const char* socketName( void )
+    {
+    socketNames();
+    return runtime_sock_file[ 0 ] != '\0' ? runtime_sock_file : legacy_sock_file;
+    }
+
+static DapiConnection* newConnection( int sock, int in_server )
+    {
+    DapiConnection* ret = malloc( sizeof( DapiConnection ));
+    if( ret == NULL )
+        return NULL;
+    ret->sock = sock;
+    ret->memory = 0;
+    ret->generic_callback = dapi_genericCallback;
+    ret->in_server = in_server;
+    ret->last_seq = 0;
+    ret->callbacks = NULL;
+    ret->timeout = -1;
+    ret->deadline = -1;
+    ret->timed_out = 0;
+    memset( &ret->in, 0, sizeof( ret->in ));
+    memset( &ret->out, 0, sizeof( ret->out ));
+    ret->pending = NULL;
+    ret->out_command = 0;
+    ret->out_seq = 0;
+    ret->out_size = 0;
+    ret->shm_threshold = 0;
+    ret->out_fd_count = 0;
+    ret->in_fds = NULL;
+    ret->in_fd_count = 0;
+    ret->shm_data = NULL;
+    ret->shm_size = 0;
+    ret->shm_pos = 0;
+    ret->progress_callback = NULL;
+    ret->progress_user_data = NULL;
+    ret->vcard_chunk_callback = NULL;
+    ret->vcard_chunk_user_data = NULL;
+    ret->events = NULL;
+    ret->subscriptions.count = 0;
+    ret->subscriptions.data = NULL;
+    ret->addressbook_cache = NULL;
+    ret->shared_refs = 0;
+    ret->call_lock = NULL;
+    ret->reconnect = 0;
+    ret->protocol_version = 0;
+    ret->features = 0;
+    ret->out_fd_start = 0;
+    ret->batch = 0;
+    ret->out_version = 1;
+    ret->out_bool_offset = 0;
+    ret->out_bool_bits = 0;
+    ret->in_version = 1;
+    ret->in_bools = 0;
+    ret->in_bool_bits = 0;
+    ret->skip_bools = 0;
+    ret->skip_bool_bits = 0;
+    ret->capabilities.count = 0;
+    ret->capabilities.data = NULL;
+    ret->capabilities_known = 0;
+    ret->in_checked = 0;
+    return ret;
+    }
+
+/* Returns the connected socket, or -1 with errno set. */
+static int connectSocket( const char* sock_file )
+    {
+    struct sockaddr_un addr;
+    int sock = socket( PF_UNIX, SOCK_STREAM, 0 );
+    int err;
+    if( sock < 0 )
+        return -1;
+    if( strlen( sock_file ) >= sizeof( addr.sun_path ))
+        {
+        close( sock );
+        errno = ENAMETOOLONG;
+        return -1;
+        }
+    /* not inherited by processes the application starts, e.g. the daemon */
+    fcntl( sock, F_SETFD, FD_CLOEXEC );
+    addr.sun_family = AF_UNIX;
+    strcpy( addr.sun_path, sock_file );
+    if( connect( sock, ( struct sockaddr* ) &addr, sizeof( addr )) < 0 )
+        {
+        err = errno;
+        close( sock );
+        errno = err;
+        return -1;
+        }
+    return sock;
+    }
+
+static int daemonNotRunning( int err )
+    {
+    return err == ENOENT || err == ECONNREFUSED;
+    }
+
+/* Connects to the daemon, falling back to the legacy socket used by older daemons. */
+static int connectDaemon( void )
+    {
+    int sock = connectSocket( socketName());
+    if( sock < 0 && daemonNotRunning( errno ) && socketName() != legacy_sock_file )
+        {
+        int err = errno;
+        sock = connectSocket( legacy_sock_file );
+        if( sock < 0 )
+            errno = err;
+        }
+    return sock;
+    }
+
+/* Starts the daemon in the background, detached from the application. The daemon
+   is $DAPI_DAEMON (empty disables starting it), by default dapi_kde in KDE and
+   dapi_generic elsewhere. Unless $DAPI_IDLE_TIMEOUT is set, the daemon exits
+   again after some time without clients (see dapi_idleTimeout()). */
+/* Looks up the program in $PATH the way execvp() does, the result is to be freed. */
+static char* findProgram( const char* name )
+    {
+    const char* path = getenv( "PATH" );
+    size_t name_len = strlen( name );
+    if( strchr( name, '/' ) != NULL )
+        return strdup( name );
+    if( path == NULL )
+        path = "/bin:/usr/bin";
+    for(;;)
+        {
+        const char* end = strchr( path, ':' );
+        size_t len = end != NULL ? ( size_t )( end - path ) : strlen( path );
+        char* file = malloc( len + name_len + 2 );
+        if( file == NULL )
+            return NULL;
+        if( len == 0 ) /* an empty entry is the current directory */
+            strcpy( file, name );
+        else
+            {
+            memcpy( file, path, len );
+            file[ len ] = '/';
+            strcpy( file + len + 1, name );
+            }
+        if( access( file, X_OK ) == 0 )
+            return file;
+        free( file );
+        if( end == NULL )
+            return NULL;
+        path = end + 1;
+        }
+    }
+
+static int spawnDaemon( void )
+    {
+    extern char** environ;
+    const char* daemon = getenv( "DAPI_DAEMON" );
+    char* file;
+    char* argv[ 2 ];
+    char** envp;
+    int env_count;
+    int max_fd;
+    int pid;
+    if( daemon == NULL )
+        daemon = getenv( "KDE_FULL_SESSION" ) != NULL ? "dapi_kde" : "dapi_generic";
+    if( *daemon == '\0' )
+        return 0;
+    /* prepare everything now, only async-signal-safe calls are allowed after fork() */
+    for( env_count = 0;
+         environ[ env_count ] != NULL;
+         ++env_count )
+        ;
+    file = findProgram( daemon );
+    if( file == NULL )
+        return 0;
+    envp = malloc(( env_count + 2 ) * sizeof( char* ));
+    if( envp == NULL )
+        {
+        free( file );
+        return 0;
+        }
+    memcpy( envp, environ, env_count * sizeof( char* ));
+    if( getenv( "DAPI_IDLE_TIMEOUT" ) == NULL )
+        envp[ env_count++ ] = "DAPI_IDLE_TIMEOUT=60";
+    envp[ env_count ] = NULL;
+    argv[ 0 ] = ( char* ) daemon;
+    argv[ 1 ] = NULL;
+    max_fd = sysconf( _SC_OPEN_MAX );
+    if( max_fd < 0 || max_fd > 4096 )
+        max_fd = 4096;
+    pid = fork();
+    if( pid == 0 )
+        { /* double fork, so that the daemon is not the application's child */
+        int fd;
+        if( fork() != 0 )
+            _exit( 0 );
+        setsid();
+        fd = open( "/dev/null", O_RDWR );
+        if( fd >= 0 )
+            {
+            dup2( fd, 0 );
+            dup2( fd, 1 );
+            }
+        for( fd = 3;
+             fd < max_fd;
+             ++fd )
+            close( fd );
+        execve( file, argv, envp );
+        _exit( 127 );
+        }
+    free( envp );
+    free( file );
+    if( pid < 0 )
+        return 0;
+    while( waitpid( pid, NULL, 0 ) < 0 && errno == EINTR )
+        ;
+    return 1;
+    }
+
+/* Returns the connected socket, starting the daemon if needed, or -1. */
+static int connectOrSpawn( void )
+    {
+    int sock = connectDaemon();
+    if( sock < 0 && daemonNotRunning( errno ) && spawnDaemon())
+        {
+        int delay = 5;
+        int waited = 0;
+        /* wait for the daemon to bind the socket */
+        while( sock < 0 && daemonNotRunning( errno ) && waited < 3000 )
+            {
+            poll( NULL, 0, delay );
+            waited += delay;
+            if( delay < 100 )
+                delay *= 2;
+            sock = connectDaemon();
+            }
+        }
+    if( sock < 0 )
+        perror( "connect" );
+    return sock;
+    }
+
+DapiConnection* dapi_connect()
+    {
+    DapiConnection* ret;
+    int sock = connectOrSpawn();
+    if( sock < 0 )
+        return NULL;
+    ret = newConnection( sock, 0 );
+    if( ret == NULL )
+        close( sock );
+    return ret;
+    }
+
+DapiConnection* dapi_socketConnection( int sock )
+    {
+    return newConnection( sock, 0 );
+    }
+
+DapiConnection* dapi_memoryConnection()
+    {
+    DapiConnection* ret = newConnection( -1, 0 );
+    if( ret != NULL )
+        ret->memory = 1;
+    return ret;
+    }
+
+static int socket_activated = 0;
+
+enum { LISTEN_FDS_START = 3 };
+
+/* Returns the listening socket passed by a service manager using the LISTEN_FDS
+   protocol (systemd socket activation), or -1. */
+static int inheritedSocket( void )
+    {
+    const char* pid = getenv( "LISTEN_PID" );
+    const char* fds = getenv( "LISTEN_FDS" );
+    struct stat st;
+    if( pid == NULL || fds == NULL || atoi( pid ) != getpid() || atoi( fds ) < 1 )
+        return -1;
+    /* not meant for processes started by the daemon */
+    unsetenv( "LISTEN_PID" );
+    unsetenv( "LISTEN_FDS" );
+    unsetenv( "LISTEN_FDNAMES" );
+    if( fstat( LISTEN_FDS_START, &st ) < 0 || !S_ISSOCK( st.st_mode ))
+        {
+        fprintf( stderr, "LISTEN_FDS set, but fd %d is not a socket!\n", LISTEN_FDS_START );
+        return -1;
+        }
+    fcntl( LISTEN_FDS_START, F_SETFD, FD_CLOEXEC );
+    return LISTEN_FDS_START;
+    }
+
+int dapi_bindSocket()
+    {
+    const char* sock_file;
+    struct sockaddr_un addr;
+    char lock_file[ sizeof( addr.sun_path ) + sizeof( ".lock" ) ];
+    int sock;
+    int lock;
+    int running;
+    sock = inheritedSocket();
+    if( sock >= 0 )
+        socket_activated = 1;
+    else
+        {
+        sock_file = socketName();
+        sock = socket( PF_UNIX, SOCK_STREAM, 0 );
+        if( sock < 0 )
+            {
+            perror( "socket" );
+            return -1;
+            }
+        fcntl( sock, F_SETFD, FD_CLOEXEC );
+        if( strlen( sock_file ) >= sizeof( addr.sun_path )
+            || snprintf( lock_file, sizeof( lock_file ), "%s.lock", sock_file ) >= ( int ) sizeof( lock_file ))
+            {
+            fprintf( stderr, "Socket path too long: %s\n", sock_file );
+            close( sock );
+            return -1;
+            }
+        /* daemons started at the same time must not replace each other's socket */
+        lock = open( lock_file, O_RDWR | O_CREAT, 0600 );
+        if( lock < 0 || flock( lock, LOCK_EX ) < 0 )
+            {
+            perror( "lock" );
+            if( lock >= 0 )
+                close( lock );
+            close( sock );
+            return -1;
+            }
+        /* only a stale socket may be removed, connecting clients would be lost */
+        running = connectSocket( sock_file );
+        if( running >= 0 )
+            {
+            fprintf( stderr, "Another daemon is already running!\n" );
+            close( running );
+            close( lock );
+            close( sock );
+            return -1;
+            }
+        unlink( sock_file );
+        addr.sun_family = AF_UNIX;
+        strcpy( addr.sun_path, sock_file );
+        if( bind( sock, ( struct sockaddr* ) &addr, sizeof( addr )) < 0 )
+            {
+            perror( "bind" );
+            close( lock );
+            close( sock );
+            return -1;
+            }
+        if( chmod( sock_file, 0600 ) != 0 )
+            {
+            perror( "chmod" );
+            close( lock );
+            close( sock );
+            return -1;
+            }
+        if( listen( sock, SOMAXCONN ) < 0 )
+            {
+            perror( "listen" );
+            close( lock );
+            close( sock );
+            return -1;
+            }
+        close( lock );
+        }
+    int opt = fcntl( sock, F_GETFL );
+    if( opt < 0 )
+        {
+        perror( "fcntl" );
+        close( sock );
+        return -1;
+        }
+    if( fcntl( sock, F_SETFL, opt | O_NONBLOCK ) < 0 )
+        {
+        perror( "nonblock" );
+        close( sock );
+        return -1;
+        }
+    return sock;
+    }
+
+int dapi_idleTimeout()
+    {
+    const char* timeout = getenv( "DAPI_IDLE_TIMEOUT" );
+    if( timeout != NULL )
+        return atoi( timeout ) * 1000;
+    /* a service manager starts the daemon again when needed */
+    return socket_activated ? 60000 : 0;
+    }
+
+int dapi_socket( DapiConnection* conn )
+    {
+    return conn->sock;
+    }
+
+static long long currentTime( void )
+    {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( long long ) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+
+int dapi_setTimeout( DapiConnection* conn, int msecs )
+    {
+    int ret = conn->timeout;
+    conn->timeout = msecs;
+    return ret;
+    }
+
+/* Calls may be nested, e.g. made from a callback run while waiting for a reply.
+   The deadline of the outer call stays if it's earlier, the returned previous
+   deadline is restored by dapi_restoreDeadline() when the call finishes. */
+long long dapi_startDeadline( DapiConnection* conn )
+    {
+    long long previous = conn->deadline;
+    long long deadline = conn->timeout >= 0 ? currentTime() + conn->timeout : -1;
+    if( deadline < 0 || ( previous >= 0 && previous < deadline ))
+        deadline = previous;
+    conn->deadline = deadline;
+    return previous;
+    }
+
+void dapi_restoreDeadline( DapiConnection* conn, long long deadline )
+    {
+    conn->deadline = deadline;
+    }
+
+/* Waits until the socket is ready for the given poll() events.
+   Returns 1 if ready, 0 if the deadline has passed (also noted
+   in conn->timed_out), -1 on error. */
+static int waitSocket( DapiConnection* conn, int events )
+    {
+    for(;;)
+        {
+        struct pollfd pfd;
+        int timeout = -1;
+        int ret;
+        if( conn->deadline >= 0 )
+            {
+            long long now = currentTime();
+            if( now >= conn->deadline )
+                {
+                conn->timed_out = 1;
+                return 0;
+                }
+            timeout = conn->deadline - now;
+            }
+        pfd.fd = conn->sock;
+        pfd.events = events;
+        pfd.revents = 0;
+        ret = poll( &pfd, 1, timeout );
+        if( ret < 0 && errno != EINTR )
+            return -1;
+        if( ret > 0 )
+            return 1;
+        }
+    }
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+enum { BUFFER_MIN_SIZE = 4096, BUFFER_KEEP_SIZE = 65536 };
+
+/* Makes sure there is space for at least size more bytes at the end of the buffer. */
+static int reserveBuffer( DapiBuffer* buf, int size )
+    {
+    int new_size;
+    char* data;
+    if( buf->end + size <= buf->size )
+        return 1;
+    if( buf->start > 0 )
+        { /* move the unprocessed data to the beginning first */
+        memmove( buf->data, buf->data + buf->start, buf->end - buf->start );
+        buf->end -= buf->start;
+        buf->mark = buf->mark > buf->start ? buf->mark - buf->start : 0;
+        buf->start = 0;
+        if( buf->end + size <= buf->size )
+            return 1;
+        }
+    new_size = buf->size > 0 ? buf->size : BUFFER_MIN_SIZE;
+    while( new_size < buf->end + size )
+        new_size *= 2;
+    data = realloc( buf->data, new_size );
+    if( data == NULL )
+        return 0;
+    buf->data = data;
+    buf->size = new_size;
+    return 1;
+    }
+
+/* Called when all data in the buffer has been processed. */
+static void resetBuffer( DapiBuffer* buf )
+    {
+    buf->start = buf->end = buf->mark = 0;
+    if( buf->size > BUFFER_KEEP_SIZE )
+        { /* don't keep a large buffer around after a large message */
+        free( buf->data );
+        buf->data = NULL;
+        buf->size = 0;
+        }
+    }
+
+static void freeBuffer( DapiBuffer* buf )
+    {
+    free( buf->data );
+    buf->data = NULL;
+    buf->size = buf->start = buf->end = buf->mark = 0;
+    }
+
+/* Data is only appended to the output buffer, the whole message is sent
+   by flushSocket() once it is complete. */
+static int writeSocket( DapiConnection* conn, const void* data, int size )
+    {
+    if( !reserveBuffer( &conn->out, size ))
+        return -1;
+    memcpy( conn->out.data + conn->out.end, data, size );
+    conn->out.end += size;
+    conn->out_size += size;
+    return 1;
+    }
+
+#ifndef MSG_CMSG_CLOEXEC
+#define MSG_CMSG_CLOEXEC 0
+#endif
+
+static void appendInFd( DapiConnection* conn, int fd )
+    {
+    int* new_fds = NULL;
+    /* only the daemon passes file descriptors */
+    if( !conn->in_server )
+        new_fds = realloc( conn->in_fds, ( conn->in_fd_count + 1 ) * sizeof( int ));
+    if( new_fds == NULL )
+        {
+        close( fd );
+        return;
+        }
+    conn->in_fds = new_fds;
+    conn->in_fds[ conn->in_fd_count++ ] = fd;
+    }
+
+/* Like recv(), but also keeps file descriptors passed by the daemon. */
+static int receiveSocket( DapiConnection* conn, void* data, int size, int flags )
+    {
+    struct msghdr msg;
+    struct iovec iov;
+    union
+        {
+        struct cmsghdr header;
+        char data[ CMSG_SPACE( MAX_PASSED_FDS * sizeof( int )) ];
+        } control;
+    struct cmsghdr* cmsg;
+    int len;
+    iov.iov_base = data;
+    iov.iov_len = size;
+    memset( &msg, 0, sizeof( msg ));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data;
+    msg.msg_controllen = sizeof( control.data );
+    len = recvmsg( conn->sock, &msg, flags | MSG_CMSG_CLOEXEC );
+    if( len <= 0 )
+        return len;
+    for( cmsg = CMSG_FIRSTHDR( &msg );
+         cmsg != NULL;
+         cmsg = CMSG_NXTHDR( &msg, cmsg ))
+        {
+        const int* fds;
+        int count;
+        int i;
+        if( cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS )
+            continue;
+        fds = ( const int* ) CMSG_DATA( cmsg );
+        count = ( cmsg->cmsg_len - CMSG_LEN( 0 )) / sizeof( int );
+        for( i = 0;
+             i < count;
+             ++i )
+            appendInFd( conn, fds[ i ] );
+        }
+    return len;
+    }
+
+static int takeFd( DapiConnection* conn )
+    {
+    int fd;
+    if( conn->in_fd_count == 0 )
+        return -1;
+    fd = conn->in_fds[ 0 ];
+    memmove( conn->in_fds, conn->in_fds + 1, ( --conn->in_fd_count ) * sizeof( int ));
+    return fd;
+    }
+
+/* File descriptors are queued and passed together with the next data sent,
+   i.e. never later than the message they belong to. The receiver takes them
+   in the same order as the messages needing them. */
+static int queueOutFd( DapiConnection* conn, int fd )
+    {
+    if( conn->out_fd_count == MAX_PASSED_FDS )
+        return 0;
+    conn->out_fds[ conn->out_fd_count++ ] = fd;
+    return 1;
+    }
+
+/* Large replies may be passed in a shared memory segment, the socket then
+   carries only a header with SHARED_MEMORY_MESSAGE and the size of the reply
+   and the segment's file descriptor. Only the last message in the output buffer
+   is moved, the ones before it may not have been sent yet. */
+static void moveToSharedMemory( DapiConnection* conn )
+    {
+#ifdef HAVE_MEMFD_CREATE
+    int size = conn->out_size;
+    int header[ 4 ];
+    void* data;
+    int fd;
+    if( conn->out_fd_count == MAX_PASSED_FDS )
+        return;
+    fd = memfd_create( "dapi", MFD_CLOEXEC | MFD_ALLOW_SEALING );
+    if( fd < 0 )
+        return;
+    if( ftruncate( fd, size ) < 0 )
+        {
+        close( fd );
+        return;
+        }
+    data = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if( data == MAP_FAILED )
+        {
+        close( fd );
+        return;
+        }
+    memcpy( data, conn->out.data + conn->out.end - size, size );
+    munmap( data, size );
+    /* the client can rely on the contents not changing while it has it mapped */
+    if( fcntl( fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL ) < 0 )
+        {
+        close( fd );
+        return;
+        }
+    conn->out.end -= size;
+    if( conn->out.start == conn->out.end )
+        resetBuffer( &conn->out );
+    header[ 0 ] = MAGIC;
+    header[ 1 ] = SHARED_MEMORY_MESSAGE;
+    header[ 2 ] = conn->out_seq;
+    header[ 3 ] = size;
+    writeSocket( conn, header, sizeof( header ));
+    /* descriptors passed inside the message are taken only after the mapping,
+       the ones for the previous messages before it */
+    memmove( conn->out_fds + conn->out_fd_start + 1, conn->out_fds + conn->out_fd_start,
+        ( conn->out_fd_count - conn->out_fd_start ) * sizeof( int ));
+    conn->out_fds[ conn->out_fd_start ] = fd;
+    ++conn->out_fd_count;
+#else
+    ( void ) conn;
+#endif
+    }
+
+static int mapSharedMemory( DapiConnection* conn, int size )
+    {
+    struct stat st;
+    void* data;
+    int fd = takeFd( conn );
+    if( fd < 0 )
+        return 0;
+    if( size <= 0 || fstat( fd, &st ) < 0 || st.st_size < size )
+        {
+        close( fd );
+        return 0;
+        }
+#ifdef F_GET_SEALS
+    /* accessing the mapping after the file would shrink would crash */
+    if(( fcntl( fd, F_GET_SEALS ) & F_SEAL_SHRINK ) == 0 )
+        {
+        close( fd );
+        return 0;
+        }
+#endif
+    data = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( data == MAP_FAILED )
+        return 0;
+    conn->shm_data = data;
+    conn->shm_size = size;
+    conn->shm_pos = 0;
+    return 1;
+    }
+
+static void unmapSharedMemory( DapiConnection* conn )
+    {
+    if( conn->shm_data == NULL )
+        return;
+    munmap(( void* ) conn->shm_data, conn->shm_size );
+    conn->shm_data = NULL;
+    }
+
+int dapi_setSharedMemoryThreshold( DapiConnection* conn, int threshold )
+    {
+#ifdef HAVE_MEMFD_CREATE
+    conn->shm_threshold = threshold;
+    return 1;
+#else
+    ( void ) conn;
+    ( void ) threshold;
+    return 0;
+#endif
+    }
+
+/* Sends data together with the queued file descriptors. */
+static int sendFds( DapiConnection* conn )
+    {
+    struct msghdr msg;
+    struct iovec iov;
+    union
+        {
+        struct cmsghdr header;
+        char data[ CMSG_SPACE( MAX_PASSED_FDS * sizeof( int )) ];
+        } control;
+    struct cmsghdr* cmsg;
+    iov.iov_base = conn->out.data + conn->out.start;
+    iov.iov_len = conn->out.end - conn->out.start;
+    memset( &msg, 0, sizeof( msg ));
+    memset( &control, 0, sizeof( control ));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data;
+    msg.msg_controllen = CMSG_SPACE( conn->out_fd_count * sizeof( int ));
+    cmsg = CMSG_FIRSTHDR( &msg );
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN( conn->out_fd_count * sizeof( int ));
+    memcpy( CMSG_DATA( cmsg ), conn->out_fds, conn->out_fd_count * sizeof( int ));
+    return sendmsg( conn->sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL );
+    }
+
+static void closeOutFds( DapiConnection* conn )
+    {
+    while( conn->out_fd_count > 0 )
+        close( conn->out_fds[ --conn->out_fd_count ] );
+    }
+
+/* Sends as much of the output buffer as possible without blocking.
+   Returns 1 if everything has been sent, 0 if some data remains, -1 on error. */
+static int sendBuffer( DapiConnection* conn )
+    {
+    while( conn->out.start < conn->out.end )
+        {
+        int len;
+        if( conn->out_fd_count > 0 )
+            len = sendFds( conn );
+        else
+            len = send( conn->sock, conn->out.data + conn->out.start,
+                conn->out.end - conn->out.start, MSG_DONTWAIT | MSG_NOSIGNAL );
+        if( len < 0 )
+            {
+            if( errno == EAGAIN || errno == EWOULDBLOCK )
+                return 0;
+            if( errno != EINTR )
+                {
+                resetBuffer( &conn->out );
+                closeOutFds( conn );
+                return -1;
+                }
+            }
+        if( len > 0 )
+            {
+            conn->out.start += len;
+            closeOutFds( conn ); /* have been sent with the first byte */
+            }
+        }
+    resetBuffer( &conn->out );
+    return 1;
+    }
+
+/* The client waits until all the output is sent. In the server the data
+   that cannot be sent immediately is left for dapi_sendData(), so that
+   a client not reading its replies cannot block the daemon. */
+static int sendOutput( DapiConnection* conn )
+    {
+    for(;;)
+        {
+        int ret = sendBuffer( conn );
+        if( ret != 0 )
+            return ret;
+        if( conn->in_server )
+            return 1;
+        if( waitSocket( conn, POLLOUT ) <= 0 )
+            return -1;
+        }
+    }
+
+/* Called after each message, in a batch the message stays in the output buffer
+   (unless too many descriptors are waiting) and is sent by dapi_endBatch()
+   together with the others. */
+static int flushSocket( DapiConnection* conn )
+    {
+    if( conn->memory )
+        { /* loop back */
+        int size = conn->out.end - conn->out.start;
+        if( !reserveBuffer( &conn->in, size ))
+            return -1;
+        memcpy( conn->in.data + conn->in.end, conn->out.data + conn->out.start, size );
+        conn->in.end += size;
+        resetBuffer( &conn->out );
+        while( conn->out_fd_count > 0 )
+            {
+            appendInFd( conn, conn->out_fds[ 0 ] );
+            memmove( conn->out_fds, conn->out_fds + 1, ( --conn->out_fd_count ) * sizeof( int ));
+            }
+        return 1;
+        }
+    if( conn->in_server )
+        {
+        dapi_statsWriteReply( conn, conn->out_command, conn->out_seq, conn->out_size );
+        if( conn->shm_threshold > 0 && conn->out_size >= conn->shm_threshold )
+            moveToSharedMemory( conn );
+        }
+    if( conn->batch > 0 && conn->out_fd_count < MAX_PASSED_FDS / 2 )
+        return 1;
+    return sendOutput( conn );
+    }
+
+void dapi_beginBatch( DapiConnection* conn )
+    {
+    ++conn->batch;
+    }
+
+int dapi_endBatch( DapiConnection* conn )
+    {
+    if( conn->batch == 0 || --conn->batch > 0 || conn->memory )
+        return 1;
+    return sendOutput( conn ) >= 0;
+    }
+
+int dapi_sendData( DapiConnection* conn )
+    {
+    return sendBuffer( conn ) >= 0;
+    }
+
+int dapi_hasUnsentData( DapiConnection* conn )
+    {
+    return conn->out.start < conn->out.end;
+    }
+
+int dapi_receiveData( DapiConnection* conn )
+    {
+    if( conn->memory )
+        return 1;
+    for(;;)
+        {
+        int space;
+        int len;
+        if( !reserveBuffer( &conn->in, BUFFER_MIN_SIZE / 2 ))
+            return 0;
+        space = conn->in.size - conn->in.end;
+        len = receiveSocket( conn, conn->in.data + conn->in.end, space, MSG_DONTWAIT );
+        if( len < 0 )
+            {
+            if( errno == EAGAIN || errno == EWOULDBLOCK )
+                return 1;
+            if( errno != EINTR )
+                return 0;
+            }
+        if( len == 0 )
+            return 0;
+        if( len > 0 )
+            {
+            conn->in.end += len;
+            if( len < space ) /* most probably nothing more to read now */
+                return 1;
+            }
+        }
+    }
+
+/* The client waits until more data arrives, with room for at least size bytes.
+   Returns 1 if something has been received, 0 at the end of the connection
+   and -1 on error or when the deadline has passed. */
+static int receiveMore( DapiConnection* conn, int size )
+    {
+    for(;;)
+        {
+        int len;
+        /* the reply may be waited for inside a batch */
+        if( conn->out.start < conn->out.end && sendOutput( conn ) < 0 )
+            return -1;
+        if( !reserveBuffer( &conn->in, size ))
+            return -1;
+        /* don't block in recv() if there's a deadline */
+        if( conn->deadline >= 0 && waitSocket( conn, POLLIN ) <= 0 )
+            return -1;
+        len = receiveSocket( conn, conn->in.data + conn->in.end, conn->in.size - conn->in.end, 0 );
+        if( len < 0 )
+            {
+            if( errno == EAGAIN || errno == EWOULDBLOCK )
+                {
+                if( waitSocket( conn, POLLIN ) <= 0 )
+                    return -1;
+                }
+            else if( errno != EINTR )
+                return -1;
+            }
+        if( len == 0 )
+            return 0;
+        if( len > 0 )
+            {
+            conn->in.end += len;
+            return 1;
+            }
+        }
+    }
+
+/* Reads from the input buffer, the client waits for more data if needed. */
+static int readSocket( DapiConnection* conn, void* data, int size )
+    {
+    if( conn->shm_data != NULL )
+        { /* reading a message passed in shared memory */
+        if( conn->shm_size - conn->shm_pos < size )
+            {
+            unmapSharedMemory( conn );
+            return -1;
+            }
+        memcpy( data, conn->shm_data + conn->shm_pos, size );
+        conn->shm_pos += size;
+        if( conn->shm_pos == conn->shm_size )
+            unmapSharedMemory( conn );
+        return 1;
+        }
+    while( conn->in.end - conn->in.start < size )
+        {
+        int ret;
+        if( conn->in_server || conn->memory )
+            return -1; /* the server reads only complete messages, see dapi_hasCommand() */
+        ret = receiveMore( conn, size - ( conn->in.end - conn->in.start ));
+        if( ret <= 0 )
+            return ret;
+        }
+    memcpy( data, conn->in.data + conn->in.start, size );
+    conn->in.start += size;
+    if( conn->in.start == conn->in.end )
+        resetBuffer( &conn->in );
+    return 1;
+    }
+
+/* Protocol version 1 sends ints, bools and lengths as host-endian int and window
+   ids as long, which only works between processes of the same architecture.
+   Version 2, used once Handshake has agreed on it, sends ints and lengths as varints
+   (signed ones zigzag-encoded), window ids as 64-bit little-endian and packs
+   the bools of a message into bytes. The magic in each message header says
+   which encoding the message uses, so messages sent before the Handshake reply
+   arrived can still be read. */
+static int writeVarint( DapiConnection* conn, unsigned long long value )
+    {
+    unsigned char data[ 10 ];
+    int len = 0;
+    while( value >= 0x80 )
+        {
+        data[ len++ ] = ( value & 0x7f ) | 0x80;
+        value >>= 7;
+        }
+    data[ len++ ] = value;
+    return writeSocket( conn, data, len );
+    }
+
+static int readVarint( DapiConnection* conn, unsigned long long* value )
+    {
+    int shift;
+    *value = 0;
+    for( shift = 0;
+         shift < 64;
+         shift += 7 )
+        {
+        unsigned char byte;
+        if( readSocket( conn, &byte, 1 ) <= 0 )
+            return 0;
+        *value |= ( unsigned long long )( byte & 0x7f ) << shift;
+        if(( byte & 0x80 ) == 0 )
+            return 1;
+        }
+    return 0;
+    }
+
+static unsigned long long zigzagEncode( long long value )
+    {
+    return (( unsigned long long ) value << 1 ) ^ ( unsigned long long )( value >> 63 );
+    }
+
+static long long zigzagDecode( unsigned long long value )
+    {
+    return ( long long )( value >> 1 ) ^ -( long long )( value & 1 );
+    }
+
+static void writeInt( DapiConnection* conn, int value )
+    {
+    if( conn->out_version >= 2 )
+        writeVarint( conn, zigzagEncode( value ));
+    else
+        writeSocket( conn, &value, sizeof( value ));
+    }
+
+static int readInt( DapiConnection* conn, int* value )
+    {
+    unsigned long long data;
+    if( conn->in_version < 2 )
+        return readSocket( conn, value, sizeof( *value )) > 0;
+    if( !readVarint( conn, &data ))
+        return 0;
+    *value = zigzagDecode( data );
+    return 1;
+    }
+
+static void writeInt64( DapiConnection* conn, long long value )
+    {
+    if( conn->out_version >= 2 )
+        writeVarint( conn, zigzagEncode( value ));
+    else
+        writeSocket( conn, &value, sizeof( value ));
+    }
+
+static int readInt64( DapiConnection* conn, long long* value )
+    {
+    unsigned long long data;
+    if( conn->in_version < 2 )
+        return readSocket( conn, value, sizeof( *value )) > 0;
+    if( !readVarint( conn, &data ))
+        return 0;
+    *value = zigzagDecode( data );
+    return 1;
+    }
+
+/* Lengths of strings and arrays. */
+static void writeLength( DapiConnection* conn, int len )
     {
-    const char* home;
-    char display[ 256 ];
-    home = getenv( "HOME" );
-    getDisplay( display, 255 );
-    snprintf( sock_file, max - 1, "%s/.dapi-%s", home, display );
+    if( conn->out_version >= 2 )
+        writeVarint( conn, len > 0 ? len : 0 );
+    else
+        writeSocket( conn, &len, sizeof( len ));
     }
 
-DapiConnection* dapi_connect()
+static int readLength( DapiConnection* conn, int* len )
     {
-    char sock_file[ 256 ];
-    int sock;
-    struct sockaddr_un addr;
-    DapiConnection* ret;
-    socketName( sock_file, 255 );
-    sock = socket( PF_UNIX, SOCK_STREAM, 0 );
-    if( sock < 0 )
-        {
-        perror( "socket" );
-        return NULL;
-        }
-    addr.sun_family = AF_UNIX;
-    strcpy( addr.sun_path, sock_file );
-    if( connect( sock, ( struct sockaddr* ) &addr, sizeof( addr )) < 0 )
-        {
-        perror( "connect" );
-        close( sock );
-        return NULL;
-        }
-    ret = malloc( sizeof( DapiConnection ));
-    if( ret != NULL )
-        {
-        ret->sock = sock;
-        ret->generic_callback = dapi_genericCallback;
-        ret->in_server = 0;
-        ret->last_seq = 0;
-        ret->callbacks = NULL;
-        }
-    return ret;
+    unsigned long long data;
+    if( conn->in_version < 2 )
+        return readSocket( conn, len, sizeof( *len )) > 0;
+    if( !readVarint( conn, &data ) || data > 0x7fffffff )
+        return 0;
+    *len = data;
+    return 1;
     }
 
-int dapi_bindSocket()
+/* A new byte is started after every 8 bools of a message. */
+static void writeBool( DapiConnection* conn, int value )
     {
-    char sock_file[ 256 ];
-    int sock;
-    struct sockaddr_un addr;
-    socketName( sock_file, 255 );
-    sock = socket( PF_UNIX, SOCK_STREAM, 0 );
-    if( sock < 0 )
-        {
-        perror( "socket" );
-        return -1;
-        }
-    int opt = fcntl( sock, F_GETFL );
-    if( opt < 0 )
-        {
-        perror( "fcntl" );
-        close( sock );
-        return -1;
-        }
-    if( fcntl( sock, F_SETFL, opt | O_NONBLOCK ) < 0 )
+    unsigned char byte = 0;
+    if( conn->out_version < 2 )
         {
-        perror( "nonblock" );
-        close( sock );
-        return -1;
+        writeSocket( conn, &value, sizeof( value ));
+        return;
         }
-    unlink( sock_file );
-    addr.sun_family = AF_UNIX;
-    strcpy( addr.sun_path, sock_file );
-    if( bind( sock, ( struct sockaddr* ) &addr, sizeof( addr )) < 0 )
+    if( conn->out_bool_bits == 0 || conn->out_bool_bits == 8 )
         {
-        perror( "bind" );
-        close( sock );
-        return -1;
+        if( writeSocket( conn, &byte, 1 ) <= 0 )
+            return;
+        conn->out_bool_offset = conn->out.end - 1 - conn->out.start;
+        conn->out_bool_bits = 0;
         }
-    if( chmod( sock_file, 0600 ) != 0 )
+    if( value )
+        conn->out.data[ conn->out.start + conn->out_bool_offset ] |= 1 << conn->out_bool_bits;
+    ++conn->out_bool_bits;
+    }
+
+static int readBool( DapiConnection* conn, int* value )
+    {
+    if( conn->in_version < 2 )
+        return readSocket( conn, value, sizeof( *value )) > 0;
+    if( conn->in_bool_bits == 0 )
         {
-        perror( "chmod" );
-        close( sock );
-        return -1;
+        unsigned char byte;
+        if( readSocket( conn, &byte, 1 ) <= 0 )
+            return 0;
+        conn->in_bools = byte;
+        conn->in_bool_bits = 8;
         }
-    if( listen( sock, SOMAXCONN ) < 0 )
+    *value = conn->in_bools & 1;
+    conn->in_bools >>= 1;
+    --conn->in_bool_bits;
+    return 1;
+    }
+
+/* Helpers for finding out whether a complete message is in the input buffer. */
+static int skipData( DapiConnection* conn, int* pos, int size )
+    {
+    if( size < 0 || conn->in.end - *pos < size )
+        return 0;
+    *pos += size;
+    return 1;
+    }
+
+/* Message headers start with the magic always as int. */
+static int peekRawInt( DapiConnection* conn, int* pos, int* value )
+    {
+    if( conn->in.end - *pos < ( int ) sizeof( int ))
+        return 0;
+    memcpy( value, conn->in.data + *pos, sizeof( int ));
+    *pos += sizeof( int );
+    return 1;
+    }
+
+static int peekVarint( DapiConnection* conn, int* pos, unsigned long long* value )
+    {
+    int shift;
+    *value = 0;
+    for( shift = 0;
+         shift < 64 && *pos < conn->in.end;
+         shift += 7 )
         {
-        perror( "listen" );
-        close( sock );
-        return -1;
+        unsigned char byte = conn->in.data[ ( *pos )++ ];
+        *value |= ( unsigned long long )( byte & 0x7f ) << shift;
+        if(( byte & 0x80 ) == 0 )
+            return 1;
         }
-    return sock;
+    return 0;
     }
 
-int dapi_socket( DapiConnection* conn )
+static int peekInt( DapiConnection* conn, int* pos, int* value )
     {
-    return conn->sock;
+    unsigned long long data;
+    if( conn->in_version < 2 )
+        return peekRawInt( conn, pos, value );
+    if( !peekVarint( conn, pos, &data ))
+        return 0;
+    *value = zigzagDecode( data );
+    return 1;
     }
 
-static int writeSocket( DapiConnection* conn, const void* data, int size )
+static int peekLength( DapiConnection* conn, int* pos, int* len )
     {
-    int written = 0;
-    for(;;)
+    unsigned long long data;
+    if( conn->in_version < 2 )
+        return peekRawInt( conn, pos, len );
+    if( !peekVarint( conn, pos, &data ) || data > 0x7fffffff )
+        return 0;
+    *len = data;
+    return 1;
+    }
+
+static int skipInt( DapiConnection* conn, int* pos )
+    {
+    int value;
+    return peekInt( conn, pos, &value );
+    }
+
+static int skipInt64( DapiConnection* conn, int* pos )
+    {
+    unsigned long long value;
+    if( conn->in_version < 2 )
+        return skipData( conn, pos, sizeof( long long ));
+    return peekVarint( conn, pos, &value );
+    }
+
+static int peekBool( DapiConnection* conn, int* pos, int* value )
+    {
+    if( conn->in_version < 2 )
+        return peekRawInt( conn, pos, value );
+    if( conn->skip_bool_bits == 0 )
         {
-        int len = write( conn->sock, ( const char* ) data + written, size - written );
-        if( len < 0 && errno != EINTR && errno != EAGAIN )
-            return -1;
-        if( len > 0 )
-            written += len;
-        if( written == size )
-            return 1;
+        if( *pos >= conn->in.end )
+            return 0;
+        conn->skip_bools = ( unsigned char ) conn->in.data[ ( *pos )++ ];
+        conn->skip_bool_bits = 8;
         }
+    *value = conn->skip_bools & 1;
+    conn->skip_bools >>= 1;
+    --conn->skip_bool_bits;
+    return 1;
     }
 
-static int readSocket( DapiConnection* conn, void* data, int size )
+static int skipBool( DapiConnection* conn, int* pos )
     {
-    int rd = 0;
-    for(;;)
+    int value;
+    return peekBool( conn, pos, &value );
+    }
+
+static int skipString( DapiConnection* conn, int* pos )
+    {
+    int len;
+    return peekLength( conn, pos, &len ) && skipData( conn, pos, len > 0 ? len : 0 );
+    }
+
+static int skipintarr( DapiConnection* conn, int* pos )
+    {
+    int count;
+    int i;
+    if( !peekLength( conn, pos, &count ))
+        return 0;
+    if( conn->in_version < 2 )
+        return count <= 0 || skipData( conn, pos, count * sizeof( int ));
+    for( i = 0;
+         i < count;
+         ++i )
+        if( !skipInt( conn, pos ))
+            return 0;
+    return 1;
+    }
+
+static int skipstringarr( DapiConnection* conn, int* pos )
+    {
+    int count;
+    int i;
+    if( !peekLength( conn, pos, &count ))
+        return 0;
+    for( i = 0;
+         i < count;
+         ++i )
+        if( !skipString( conn, pos ))
+            return 0;
+    return 1;
+    }
+
+static int skipWindowInfo( DapiConnection* conn, int* pos )
+    {
+    DapiWindowInfo winfo;
+    if( conn->in_version >= 2 )
+        return skipInt( conn, pos ) && skipData( conn, pos, 8 );
+    return skipData( conn, pos, sizeof( winfo.flags ))
+        && skipData( conn, pos, sizeof( winfo.window ));
+    }
+
+/* The descriptor itself comes with the data, possibly earlier. */
+static int skipFd( DapiConnection* conn, int* pos )
+    {
+    int present;
+    if( !peekBool( conn, pos, &present ))
+        return 0;
+    return !present || conn->in_fd_count > 0;
+    }
+
+static int skipMessage( DapiConnection* conn, int command, int* pos );
+
+int dapi_hasCommand( DapiConnection* conn )
+    {
+    int pos;
+    int magic, command, seq;
+    if( conn->in_checked )
+        return 1; /* not read yet by dapi_readCommand() */
+    unmapSharedMemory( conn ); /* the rest of the previous message */
+    if( conn->in.mark > conn->in.start )
+        { /* skip what the previous command's handler has not read */
+        conn->in.start = conn->in.mark;
+        if( conn->in.start == conn->in.end )
+            resetBuffer( &conn->in );
+        }
+    pos = conn->in.start;
+    if( !peekRawInt( conn, &pos, &magic ))
+        return 0;
+    conn->in_version = magic == MAGIC_V2 ? 2 : 1;
+    conn->skip_bool_bits = 0;
+    if( !peekInt( conn, &pos, &command ) || !peekInt( conn, &pos, &seq ))
+        return 0;
+    if( magic == MAGIC && command == SHARED_MEMORY_MESSAGE )
         {
-        int len = read( conn->sock, ( char* ) data + rd, size - rd );
-        if( len < 0 && errno != EINTR && errno != EAGAIN )
-            return -1;
-        if( len == 0 )
+        /* the file descriptor comes together with the header */
+        if( !skipData( conn, &pos, sizeof( int )) || conn->in_fd_count == 0 )
             return 0;
-        if( len > 0 )
-            rd += len;
-        if( rd == size )
-            return 1;
         }
+    else if(( magic == MAGIC || magic == MAGIC_V2 ) && !skipMessage( conn, command, &pos ))
+        return 0;
+    conn->in.mark = pos; /* the end of the message */
+    conn->in_checked = 1;
+    return 1;
     }
 
 DapiConnection* dapi_acceptSocket( int sock )
@@ -167,41 +1341,239 @@ DapiConnection* dapi_acceptSocket( int sock )
     DapiConnection* ret = NULL;
     socklen_t addr_len = sizeof( addr );
     int sock2 = accept( sock, ( struct sockaddr* ) &addr, &addr_len );
-    if( sock2 > 0 )
+    if( sock2 >= 0 )
         {
-        ret = malloc( sizeof( DapiConnection ));
-        if( ret != NULL )
+        int opt = fcntl( sock2, F_GETFL );
+        /* the daemon must never block on a client */
+        if( opt < 0 || fcntl( sock2, F_SETFL, opt | O_NONBLOCK ) < 0 )
             {
-            ret->sock = sock2;
-            ret->generic_callback = dapi_genericCallback;
-            ret->in_server = 1;
-            ret->last_seq = 0;
-            ret->callbacks = NULL;
+            perror( "nonblock" );
+            close( sock2 );
+            return NULL;
             }
-        else
+        ret = newConnection( sock2, 1 );
+        if( ret == NULL )
             close( sock2 );
         }
     return ret;
     }
 
+static DapiConnection* shared_connection = NULL;
+static pthread_mutex_t shared_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t shared_call_mutex;
+static pthread_once_t shared_once = PTHREAD_ONCE_INIT;
+
+/* Threads using the shared connection take turns, every call (including writing
+   a command and registering its callback) holds the lock. It is recursive,
+   callbacks run while waiting for a reply may make calls too. */
+static void initCallMutex( void )
+    {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init( &attr );
+    pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+    pthread_mutex_init( &shared_call_mutex, &attr );
+    pthread_mutexattr_destroy( &attr );
+    }
+
+void dapi_lockConnection( DapiConnection* conn )
+    {
+    if( conn->call_lock != NULL )
+        pthread_mutex_lock( conn->call_lock );
+    }
+
+void dapi_unlockConnection( DapiConnection* conn )
+    {
+    if( conn->call_lock != NULL )
+        pthread_mutex_unlock( conn->call_lock );
+    }
+
+static void sharedPrepareFork( void )
+    {
+    pthread_mutex_lock( &shared_mutex );
+    }
+
+static void sharedParentFork( void )
+    {
+    pthread_mutex_unlock( &shared_mutex );
+    }
+
+/* The child must not use the parent's socket, replies would go to either process.
+   Only the socket is closed here, the connection reconnects when used next.
+   A call another thread was making doesn't continue in the child, so the call
+   lock starts unlocked again. */
+static void sharedChildFork( void )
+    {
+    initCallMutex();
+    if( shared_connection != NULL && !shared_connection->memory && shared_connection->sock >= 0 )
+        {
+        close( shared_connection->sock );
+        shared_connection->sock = -1;
+        shared_connection->reconnect = 1;
+        }
+    pthread_mutex_unlock( &shared_mutex );
+    }
+
+static void sharedInit( void )
+    {
+    initCallMutex();
+    pthread_atfork( sharedPrepareFork, sharedParentFork, sharedChildFork );
+    }
+
+/* Connects to the daemon again, data not sent or not read yet is dropped. */
+int dapi_reopenSocket( DapiConnection* conn )
+    {
+    int sock;
+    if( !conn->memory && conn->sock >= 0 )
+        close( conn->sock );
+    conn->sock = -1;
+    freeBuffer( &conn->in );
+    freeBuffer( &conn->out );
+    closeOutFds( conn );
+    while( conn->in_fd_count > 0 )
+        close( takeFd( conn ));
+    unmapSharedMemory( conn );
+    conn->in_checked = 0;
+    sock = connectOrSpawn();
+    if( sock < 0 )
+        return 0;
+    conn->sock = sock;
+    return 1;
+    }
+
+/* Replaces the socket of a connection inherited from the parent process
+   and restores the client's state in the daemon. If that fails, it's tried
+   again by the next call. */
+static int reconnectConnection( DapiConnection* conn )
+    {
+    /* the calls made while reconnecting must not reconnect again */
+    conn->reconnect = 0;
+    dapi_statsClose( conn );
+    while( conn->callbacks != NULL )
+        { /* replies to the parent's calls */
+        DapiCallbackData* next = conn->callbacks->next;
+        free( conn->callbacks );
+        conn->callbacks = next;
+        }
+    /* the daemon may be a different version now */
+    conn->protocol_version = 0;
+    conn->features = 0;
+    conn->capabilities_known = 0;
+    if( !dapi_reopenSocket( conn ) || !dapi_handshakeAndInit( conn ))
+        {
+        if( conn->sock >= 0 )
+            close( conn->sock );
+        conn->sock = -1;
+        conn->reconnect = 1;
+        return 0;
+        }
+    if( conn->subscriptions.count > 0 )
+        dapi_Subscribe( conn, conn->subscriptions );
+    if( conn->addressbook_cache != NULL )
+        dapi_syncAddressBookCache( conn );
+    return 1;
+    }
+
+DapiConnection* dapi_sharedConnection()
+    {
+    DapiConnection* ret;
+    pthread_once( &shared_once, sharedInit );
+    pthread_mutex_lock( &shared_mutex );
+    if( shared_connection == NULL )
+        {
+        shared_connection = dapi_connectAndInit();
+        if( shared_connection != NULL )
+            {
+            shared_connection->shared_refs = 1;
+            shared_connection->call_lock = &shared_call_mutex;
+            }
+        }
+    else
+        ++shared_connection->shared_refs;
+    ret = shared_connection;
+    pthread_mutex_unlock( &shared_mutex );
+    /* not under shared_mutex, a call holding the call lock may close the connection */
+    if( ret != NULL && ret->reconnect )
+        {
+        dapi_lockConnection( ret );
+        if( ret->reconnect )
+            reconnectConnection( ret );
+        dapi_unlockConnection( ret );
+        }
+    return ret;
+    }
+
 void dapi_close( DapiConnection* conn )
     {
-    close( conn->sock );
+    if( conn->shared_refs > 0 )
+        {
+        int refs;
+        pthread_mutex_lock( &shared_mutex );
+        refs = --conn->shared_refs;
+        if( refs == 0 && shared_connection == conn )
+            shared_connection = NULL;
+        pthread_mutex_unlock( &shared_mutex );
+        if( refs > 0 )
+            return;
+        }
+    if( !conn->memory && conn->sock >= 0 )
+        close( conn->sock );
+    conn->sock = -1;
+    freeBuffer( &conn->in );
+    freeBuffer( &conn->out );
+    closeOutFds( conn );
+    while( conn->in_fd_count > 0 )
+        close( takeFd( conn ));
+    free( conn->in_fds );
+    conn->in_fds = NULL;
+    unmapSharedMemory( conn );
+    dapi_statsClose( conn );
+    dapi_addressBookCacheClose( conn );
+    while( conn->callbacks != NULL )
+        {
+        DapiCallbackData* next = conn->callbacks->next;
+        free( conn->callbacks );
+        conn->callbacks = next;
+        }
+    while( conn->events != NULL )
+        {
+        DapiCallbackData* next = conn->events->next;
+        free( conn->events );
+        conn->events = next;
+        }
+    dapi_freeintarr( conn->subscriptions );
+    conn->subscriptions.count = 0;
+    conn->subscriptions.data = NULL;
+    dapi_freeintarr( conn->capabilities );
+    conn->capabilities.count = 0;
+    conn->capabilities.data = NULL;
+    conn->capabilities_known = 0;
+    }
+
+void dapi_setSubscriptions( DapiConnection* conn, intarr events )
+    {
+    int* data = events.count > 0 ? malloc( events.count * sizeof( int )) : NULL;
+    dapi_freeintarr( conn->subscriptions );
+    conn->subscriptions.count = data != NULL ? events.count : 0;
+    conn->subscriptions.data = data;
+    if( data != NULL )
+        memcpy( data, events.data, events.count * sizeof( int ));
     }
 
-int dapi_hasData( DapiConnection* conn )
+int dapi_isSubscribed( DapiConnection* conn, int event )
     {
-    fd_set fd;
-    struct timeval tm = { 0, 0 };
-    FD_ZERO( &fd );
-    FD_SET( conn->sock, &fd );
-    if( select( conn->sock + 1, &fd, NULL, NULL, &tm ) > 0 )
-        return FD_ISSET( conn->sock, &fd );
+    int i;
+    for( i = 0;
+         i < conn->subscriptions.count;
+         ++i )
+        if( conn->subscriptions.data[ i ] == event )
+            return 1;
     return 0;
     }
 
 static int getNextSeq( DapiConnection* conn )
     {
+    if( conn->reconnect )
+        reconnectConnection( conn );
     if( ++conn->last_seq == 0 ) // 0 means invalid
         ++conn->last_seq;
     return conn->last_seq;
@@ -210,7 +1582,7 @@ static int getNextSeq( DapiConnection* conn )
 static char* readString( DapiConnection* conn )
     {
     int len;
-    if( readSocket( conn, &len, sizeof( len )) <= 0 )
+    if( !readLength( conn, &len ))
         return NULL;
     char* ret = malloc( len + 1 );
     if( ret == NULL )
@@ -230,29 +1602,68 @@ static char* readString( DapiConnection* conn )
 static void writeString( DapiConnection* conn, const char* str )
     {
     int len = ( str == NULL ? 0 : strlen( str ));
-    writeSocket( conn, &len, sizeof( len ));
+    writeLength( conn, len );
     if( len > 0 )
         writeSocket( conn, str, len );
     }
 
+/* Reads the magic, command and seq, setting the encoding of the rest of the message. */
+static int readHeader( DapiConnection* conn, int* magic, int* comm, int* seq )
+    {
+    if( readSocket( conn, magic, sizeof( *magic )) <= 0 )
+        return 0;
+    if( *magic != MAGIC && *magic != MAGIC_V2 )
+        return 0;
+    conn->in_version = *magic == MAGIC_V2 ? 2 : 1;
+    conn->in_bool_bits = 0;
+    return readInt( conn, comm ) && readInt( conn, seq );
+    }
+
 int dapi_readCommand( DapiConnection* conn, int* comm, int* seq )
     {
     int magic;
-    /* TODO kontrola failure */
-    readSocket( conn, &magic, sizeof( magic ));
-    readSocket( conn, comm, sizeof( *comm ));
-    readSocket( conn, seq, sizeof( *seq ));
-    if( magic != MAGIC )
+    int size;
+    /* Nothing is consumed before the whole message is here, so that a call
+       giving up on its deadline doesn't leave the connection in the middle
+       of a message. */
+    conn->timed_out = 0;
+    while( !dapi_hasCommand( conn ))
+        {
+        if( conn->in_server || conn->memory || receiveMore( conn, BUFFER_MIN_SIZE / 2 ) <= 0 )
+            return 0;
+        }
+    conn->in_checked = 0;
+    size = conn->in.mark - conn->in.start;
+    if( !readHeader( conn, &magic, comm, seq ))
         return 0;
+    if( magic == MAGIC && *comm == SHARED_MEMORY_MESSAGE )
+        { /* the real message is in the shared memory, including its header */
+        int shm_size;
+        if( conn->in_server
+            || readSocket( conn, &shm_size, sizeof( shm_size )) <= 0
+            || !mapSharedMemory( conn, shm_size ))
+            return 0;
+        if( !readHeader( conn, &magic, comm, seq ))
+            return 0;
+        }
+    if( conn->in_server )
+        dapi_statsReadCommand( conn, *comm, *seq, size > 0 ? size : 0 );
     return 1;
     }
 
 static void writeCommand( DapiConnection* conn, int comm, int seq )
     {
-    int magic = MAGIC;
+    int magic;
+    conn->out_command = comm;
+    conn->out_seq = seq;
+    conn->out_size = 0;
+    conn->out_fd_start = conn->out_fd_count;
+    conn->out_version = conn->protocol_version >= 2 ? 2 : 1;
+    conn->out_bool_bits = 0;
+    magic = conn->out_version >= 2 ? MAGIC_V2 : MAGIC;
     writeSocket( conn, &magic, sizeof( magic ));
-    writeSocket( conn, &comm, sizeof( comm ));
-    writeSocket( conn, &seq, sizeof( seq ));
+    writeInt( conn, comm );
+    writeInt( conn, seq );
     }
 
 /* TODO generovat? */
@@ -260,16 +1671,27 @@ static intarr readintarr( DapiConnection* conn )
     {
     intarr ret;
     int i;
-    readSocket( conn, &ret.count, sizeof( ret.count ));
-    if( ret.count == 0 )
+    ret.data = NULL;
+    if( !readLength( conn, &ret.count ) || ret.count <= 0 )
+        {
+        ret.count = 0;
         return ret;
+        }
     ret.data = malloc( ret.count * sizeof( int ));
     if( ret.data == NULL )
-        return ret; /* TODO ? */
+        { /* read the items anyway, so that the following data is in sync */
+        int value;
+        for( i = 0;
+             i < ret.count;
+             ++i )
+            readInt( conn, &value );
+        ret.count = 0;
+        return ret;
+        }
     for( i = 0;
          i < ret.count;
          ++i )
-        readSocket( conn, &ret.data[ i ], sizeof( ret.data[ i ] ));
+        readInt( conn, &ret.data[ i ] );
     return ret;        
     }
 
@@ -277,12 +1699,22 @@ static stringarr readstringarr( DapiConnection* conn )
     {
     stringarr ret;
     int i;
-    readSocket( conn, &ret.count, sizeof( ret.count ));
-    if( ret.count == 0 )
+    ret.data = NULL;
+    if( !readLength( conn, &ret.count ) || ret.count <= 0 )
+        {
+        ret.count = 0;
         return ret;
+        }
     ret.data = malloc( ret.count * sizeof( char* ));
     if( ret.data == NULL )
-        return ret; /* TODO ? */
+        { /* read the items anyway, so that the following data is in sync */
+        for( i = 0;
+             i < ret.count;
+             ++i )
+            free( readString( conn ));
+        ret.count = 0;
+        return ret;
+        }
     for( i = 0;
          i < ret.count;
          ++i )
@@ -290,12 +1722,27 @@ static stringarr readstringarr( DapiConnection* conn )
     return ret;        
     }
 
+/* In version 2 the window is always 64-bit little-endian, whatever the size of long. */
 static DapiWindowInfo readWindowInfo( DapiConnection* conn )
     {
     DapiWindowInfo ret;
-    readSocket( conn, &ret.flags, sizeof( ret.flags ));
-    if( ret.flags == 0 )
+    ret.flags = 0;
+    ret.window = 0;
+    if( conn->in_version >= 2 )
+        {
+        unsigned char data[ 8 ];
+        unsigned long long window = 0;
+        int i;
+        if( !readInt( conn, &ret.flags ) || readSocket( conn, data, sizeof( data )) <= 0 )
+            return ret;
+        for( i = 7;
+             i >= 0;
+             --i )
+            window = ( window << 8 ) | data[ i ];
+        ret.window = ( long ) window;
         return ret;
+        }
+    readSocket( conn, &ret.flags, sizeof( ret.flags ));
     readSocket( conn, &ret.window, sizeof( ret.window ));
     return ret;
     }
@@ -303,17 +1750,17 @@ static DapiWindowInfo readWindowInfo( DapiConnection* conn )
 static void writeintarr( DapiConnection* conn, intarr arr )
     {
     int i;
-    writeSocket( conn, &arr.count, sizeof( arr.count ));
+    writeLength( conn, arr.count );
     for( i = 0;
          i < arr.count;
          ++i )
-        writeSocket( conn, &arr.data[ i ], sizeof( arr.data[ i ] ));
+        writeInt( conn, arr.data[ i ] );
     }
 
 static void writestringarr( DapiConnection* conn, stringarr arr )
     {
     int i;
-    writeSocket( conn, &arr.count, sizeof( arr.count ));
+    writeLength( conn, arr.count );
     for( i = 0;
          i < arr.count;
          ++i )
@@ -322,10 +1769,50 @@ static void writestringarr( DapiConnection* conn, stringarr arr )
 
 static void writeWindowInfo( DapiConnection* conn, DapiWindowInfo winfo )
     {
+    if( conn->out_version >= 2 )
+        {
+        unsigned char data[ 8 ];
+        unsigned long long window = ( unsigned long ) winfo.window;
+        int i;
+        for( i = 0;
+             i < 8;
+             ++i )
+            {
+            data[ i ] = window & 0xff;
+            window >>= 8;
+            }
+        writeInt( conn, winfo.flags );
+        writeSocket( conn, data, sizeof( data ));
+        return;
+        }
     writeSocket( conn, &winfo.flags, sizeof( winfo.flags ));
     writeSocket( conn, &winfo.window, sizeof( winfo.window ));
     }
 
+/* Only a flag is written, the descriptor is passed using SCM_RIGHTS.
+   The caller keeps the ownership of fd. */
+static void writeFd( DapiConnection* conn, int fd )
+    {
+    int present = 0;
+    if( fd >= 0 )
+        {
+        int copy = fcntl( fd, F_DUPFD_CLOEXEC, 0 );
+        if( copy >= 0 && queueOutFd( conn, copy ))
+            present = 1;
+        else if( copy >= 0 )
+            close( copy );
+        }
+    writeBool( conn, present );
+    }
+
+static int readFd( DapiConnection* conn )
+    {
+    int present;
+    if( !readBool( conn, &present ) || !present )
+        return -1;
+    return takeFd( conn );
+    }
+
 void dapi_freeintarr( intarr arr )
     {
     free( arr.data );
@@ -357,7 +1844,7 @@ DapiConnection* dapi_connectAndInit()
     DapiConnection* conn = dapi_connect();
     if( conn == NULL )
         return NULL;
-    if( !dapi_Init( conn ))
+    if( !dapi_handshakeAndInit( conn ))
         {
         dapi_close( conn );
         return NULL;
@@ -365,4 +1852,22 @@ DapiConnection* dapi_connectAndInit()
     return conn;
     }
 
+int dapi_protocolVersion( DapiConnection* conn )
+    {
+    return conn->protocol_version > 0 ? conn->protocol_version : 1;
+    }
+
+void dapi_setProtocolVersion( DapiConnection* conn, int version )
+    {
+    conn->protocol_version = version;
+    }
+
+int dapi_enableSharedMemory( DapiConnection* conn, int threshold )
+    {
+    /* older daemons don't know the command and would not reply */
+    if( !dapi_hasCapability( conn, DAPI_COMMAND_SHAREDMEMORY ))
+        return 0;
+    return dapi_SharedMemory( conn, threshold );
+    }
+
 #include <dapi/comm_generated.c>
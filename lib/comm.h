@@ -7,14 +7,33 @@ extern "C" {
 
 typedef struct DapiConnection DapiConnection;
 
+enum { DAPI_PROTOCOL_VERSION = 2 };
+
 DapiConnection* dapi_connect( void );
 void dapi_close( DapiConnection* conn );
 int dapi_socket( DapiConnection* conn );
 
 DapiConnection* dapi_connectAndInit( void );
+DapiConnection* dapi_sharedConnection( void );
+int dapi_hasCapability( DapiConnection* conn, int command );
+int dapi_protocolVersion( DapiConnection* conn );
+void dapi_setProtocolVersion( DapiConnection* conn, int version );
+DapiConnection* dapi_socketConnection( int sock );
+DapiConnection* dapi_memoryConnection( void );
+int dapi_enableSharedMemory( DapiConnection* conn, int threshold );
+
+int dapi_setTimeout( DapiConnection* conn, int msecs );
 
 int dapi_bindSocket( void );
+int dapi_idleTimeout( void );
 DapiConnection* dapi_acceptSocket( int sock );
+int dapi_receiveData( DapiConnection* conn );
+int dapi_hasCommand( DapiConnection* conn );
+int dapi_sendData( DapiConnection* conn );
+int dapi_hasUnsentData( DapiConnection* conn );
+void dapi_beginBatch( DapiConnection* conn );
+int dapi_endBatch( DapiConnection* conn );
+int dapi_setSharedMemoryThreshold( DapiConnection* conn, int threshold );
 
 typedef struct DapiWindowInfo
     {
@@ -35,6 +54,12 @@ typedef struct
     char** data;
     } stringarr;
 
+void dapi_setSubscriptions( DapiConnection* conn, intarr events );
+int dapi_isSubscribed( DapiConnection* conn, int event );
+
+intarr dapi_getStats( void );
+int dapi_statsBucketValue( int bucket );
+
 void dapi_windowInfoInitWindow( DapiWindowInfo* winfo, long window );
 
 void dapi_freeWindowInfo( DapiWindowInfo winfo );
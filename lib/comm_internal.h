@@ -1,25 +1,102 @@
-enum { MAGIC = 0x152355 };
+/* MAGIC starts messages in the version 1 encoding, MAGIC_V2 in the version 2 one. */
+enum { MAGIC = 0x152355, MAGIC_V2 = 0x152356, SHARED_MEMORY_MESSAGE = -1, MAX_PASSED_FDS = 16 };
+
+/* Protocol features the library supports, none so far. */
+enum { DAPI_CLIENT_FEATURES = 0 };
+
+#include <pthread.h>
 
 #include <dapi/comm_internal_generated.h>
 
 #include "calls.h"
 #include "callbacks.h"
 
+/* the command of a call that has been cancelled or has timed out */
+enum { CANCELLED_CALL = -2 };
+
 typedef struct DapiCallbackData
     {
     struct DapiCallbackData* next;
     int seq;
     int command;
     void* callback;
+    void* user_data;
     } DapiCallbackData;
 
+typedef struct DapiBuffer
+    {
+    char* data;
+    int size;
+    int start;
+    int end;
+    int mark;
+    } DapiBuffer;
+
+typedef struct DapiPendingCall DapiPendingCall;
+typedef struct DapiAddressBookCache DapiAddressBookCache;
+
 struct DapiConnection
     {
     int sock;
+    int memory;
     DapiGenericCallback generic_callback;
     int in_server;
     int last_seq;
     DapiCallbackData* callbacks;
+    int timeout;
+    long long deadline;
+    int timed_out; /* the last dapi_readCommand() failed because of the deadline */
+    DapiBuffer in;
+    DapiBuffer out;
+    DapiPendingCall* pending;
+    int out_command;
+    int out_seq;
+    int out_size;
+    int out_fd_start; /* the first descriptor passed with the message being written */
+    int batch; /* nesting level of dapi_beginBatch() */
+    int shm_threshold;
+    int out_fds[ MAX_PASSED_FDS ];
+    int out_fd_count;
+    int* in_fds;
+    int in_fd_count;
+    const char* shm_data;
+    int shm_size;
+    int shm_pos;
+    dapi_TransferProgress_callback progress_callback;
+    void* progress_user_data;
+    dapi_AddressBookVCard30Chunk_callback vcard_chunk_callback;
+    void* vcard_chunk_user_data;
+    DapiCallbackData* events;
+    intarr subscriptions;
+    DapiAddressBookCache* addressbook_cache;
+    int shared_refs; /* references to the process-wide connection, 0 for others */
+    pthread_mutex_t* call_lock; /* held during calls on the shared connection, NULL for others */
+    int reconnect; /* inherited across fork(), must not use the parent's socket */
+    int protocol_version; /* agreed in Handshake, 0 if the daemon is older */
+    int features;
+    int out_version; /* encoding of the message being written */
+    int out_bool_offset; /* the byte the bools are packed in, relative to out.start */
+    int out_bool_bits;
+    int in_version; /* encoding of the message being read */
+    int in_bools;
+    int in_bool_bits;
+    int skip_bools; /* the same for dapi_hasCommand() */
+    int skip_bool_bits;
+    intarr capabilities;
+    int capabilities_known;
+    int in_checked; /* dapi_hasCommand() has found a complete message at in.start */
     };
 
-int dapi_hasData( DapiConnection* conn );
+long long dapi_startDeadline( DapiConnection* conn );
+void dapi_restoreDeadline( DapiConnection* conn, long long deadline );
+void dapi_statsReadCommand( DapiConnection* conn, int command, int seq, int bytes );
+void dapi_statsWriteReply( DapiConnection* conn, int command, int seq, int bytes );
+void dapi_statsClose( DapiConnection* conn );
+void dapi_addressBookCacheChanged( DapiConnection* conn, int seq, int generation, stringarr changed,
+    int ok, void* user_data );
+void dapi_addressBookCacheClose( DapiConnection* conn );
+int dapi_handshakeAndInit( DapiConnection* conn );
+int dapi_reopenSocket( DapiConnection* conn );
+int dapi_dropReply( DapiConnection* conn, int seq );
+void dapi_lockConnection( DapiConnection* conn );
+void dapi_unlockConnection( DapiConnection* conn );
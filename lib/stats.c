@@ -0,0 +1,194 @@
+#include "comm.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "comm_internal.h"
+
+/* Latency histograms are log-linear (like HdrHistogram): values below 4us
+   have their own bucket, every following power of 2 is split into 4 buckets,
+   so the relative error is at most 25%. */
+enum { STATS_SUB_BUCKETS = 4, STATS_BUCKETS = 120, STATS_MAX_COMMAND = 1024 };
+
+typedef struct DapiCommandStats
+    {
+    int count;
+    int in_flight;
+    long long bytes_in;
+    long long bytes_out;
+    int buckets[ STATS_BUCKETS ];
+    } DapiCommandStats;
+
+struct DapiPendingCall
+    {
+    struct DapiPendingCall* next;
+    int seq;
+    int command;
+    long long start;
+    };
+
+static DapiCommandStats* stats = NULL;
+static int stats_count = 0;
+
+static long long currentTimeUs( void )
+    {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( long long ) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+
+static DapiCommandStats* commandStats( int command )
+    {
+    if( command < 0 || command >= STATS_MAX_COMMAND )
+        return NULL;
+    if( command >= stats_count )
+        {
+        DapiCommandStats* new_stats = realloc( stats, ( command + 1 ) * sizeof( DapiCommandStats ));
+        if( new_stats == NULL )
+            return NULL;
+        memset( new_stats + stats_count, 0, ( command + 1 - stats_count ) * sizeof( DapiCommandStats ));
+        stats = new_stats;
+        stats_count = command + 1;
+        }
+    return &stats[ command ];
+    }
+
+static int bucketIndex( long long value )
+    {
+    int exponent = 0;
+    int index;
+    if( value < STATS_SUB_BUCKETS )
+        return value < 0 ? 0 : value;
+    while(( value >> exponent ) >= 2 * STATS_SUB_BUCKETS )
+        ++exponent;
+    /* value >> exponent is now in <4,8) */
+    index = ( exponent + 1 ) * STATS_SUB_BUCKETS + ( value >> exponent ) - STATS_SUB_BUCKETS;
+    return index < STATS_BUCKETS ? index : STATS_BUCKETS - 1;
+    }
+
+int dapi_statsBucketValue( int bucket )
+    {
+    if( bucket < STATS_SUB_BUCKETS )
+        return bucket;
+    return ( STATS_SUB_BUCKETS + bucket % STATS_SUB_BUCKETS ) << ( bucket / STATS_SUB_BUCKETS - 1 );
+    }
+
+/* Commands the daemon replies to, unknown commands and replies sent as commands
+   never get one and would stay pending forever. vCard chunks are only sent
+   by the daemon. */
+static int hasReply( int command )
+    {
+    return command >= 0 && command < DAPI_MESSAGE_COUNT && command % 2 == 0
+        && command != DAPI_COMMAND_ADDRESSBOOKVCARD30CHUNK;
+    }
+
+void dapi_statsReadCommand( DapiConnection* conn, int command, int seq, int bytes )
+    {
+    DapiCommandStats* cstats;
+    DapiPendingCall* call;
+    if( !hasReply( command ))
+        return;
+    cstats = commandStats( command );
+    if( cstats == NULL )
+        return;
+    ++cstats->count;
+    cstats->bytes_in += bytes;
+    call = malloc( sizeof( DapiPendingCall ));
+    if( call == NULL )
+        return;
+    call->seq = seq;
+    call->command = command;
+    call->start = currentTimeUs();
+    call->next = conn->pending;
+    conn->pending = call;
+    ++cstats->in_flight;
+    }
+
+void dapi_statsWriteReply( DapiConnection* conn, int command, int seq, int bytes )
+    {
+    DapiPendingCall* pos;
+    DapiPendingCall* prev = NULL;
+    for( pos = conn->pending;
+         pos != NULL;
+         prev = pos, pos = pos->next )
+        {
+        /* progress notifications carry the seq of the transfer, but are not its reply */
+        if( pos->seq == seq && pos->command + 1 == command )
+            {
+            DapiCommandStats* cstats = commandStats( pos->command );
+            if( prev != NULL )
+                prev->next = pos->next;
+            else
+                conn->pending = pos->next;
+            --cstats->in_flight;
+            cstats->bytes_out += bytes;
+            ++cstats->buckets[ bucketIndex( currentTimeUs() - pos->start ) ];
+            free( pos );
+            return;
+            }
+        }
+    }
+
+void dapi_statsClose( DapiConnection* conn )
+    {
+    while( conn->pending != NULL )
+        {
+        DapiPendingCall* next = conn->pending->next;
+        --commandStats( conn->pending->command )->in_flight;
+        free( conn->pending );
+        conn->pending = next;
+        }
+    }
+
+intarr dapi_getStats( void )
+    {
+    intarr ret;
+    int size = 0;
+    int command;
+    int i;
+    for( command = 0;
+         command < stats_count;
+         ++command )
+        {
+        size += 8;
+        for( i = 0;
+             i < STATS_BUCKETS;
+             ++i )
+            if( stats[ command ].buckets[ i ] != 0 )
+                size += 2;
+        }
+    ret.count = 0;
+    ret.data = size > 0 ? malloc( size * sizeof( int )) : NULL;
+    if( ret.data == NULL )
+        return ret;
+    for( command = 0;
+         command < stats_count;
+         ++command )
+        {
+        const DapiCommandStats* cstats = &stats[ command ];
+        int nbuckets_pos;
+        if( cstats->count == 0 )
+            continue;
+        ret.data[ ret.count++ ] = command;
+        ret.data[ ret.count++ ] = cstats->count;
+        ret.data[ ret.count++ ] = cstats->in_flight;
+        /* the byte counters are 64-bit, sent as the low and high 32 bits */
+        ret.data[ ret.count++ ] = ( int )( cstats->bytes_in & 0xffffffff );
+        ret.data[ ret.count++ ] = ( int )( cstats->bytes_in >> 32 );
+        ret.data[ ret.count++ ] = ( int )( cstats->bytes_out & 0xffffffff );
+        ret.data[ ret.count++ ] = ( int )( cstats->bytes_out >> 32 );
+        nbuckets_pos = ret.count++;
+        ret.data[ nbuckets_pos ] = 0;
+        for( i = 0;
+             i < STATS_BUCKETS;
+             ++i )
+            if( cstats->buckets[ i ] != 0 )
+                {
+                ret.data[ ret.count++ ] = i;
+                ret.data[ ret.count++ ] = cstats->buckets[ i ];
+                ++ret.data[ nbuckets_pos ];
+                }
+        }
+    return ret;
+    }
@@ -0,0 +1,345 @@
+/* Load generator for measuring a running daemon.
+
+   dapi_bench [-c clients] [-n requests] [-m mix] [-t timeout]
+
+   Starts the given number of client processes, each performing the given
+   number of requests, taking the request types from the comma-separated mix
+   in turn. Reports throughput, latency percentiles and the CPU time
+   the daemon spent per request. With -t the calls time out after the given
+   number of milliseconds and are counted as failed.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+#include <dapi/callbacks.h>
+
+enum Request
+    {
+    REQUEST_INIT, REQUEST_CAPABILITIES, REQUEST_BUTTONORDER, REQUEST_ASYNC,
+    REQUEST_ADDRESSBOOK
+    };
+
+static const struct
+    {
+    const char* name;
+    int command;
+    } requests[] =
+    {
+    { "init", DAPI_COMMAND_INIT },
+    { "caps", DAPI_COMMAND_CAPABILITIES },
+    { "order", DAPI_COMMAND_BUTTONORDER },
+    { "async", DAPI_COMMAND_BUTTONORDER },
+    { "ab", DAPI_COMMAND_ADDRESSBOOKLIST }
+    };
+
+enum { MAX_MIX = 64 };
+
+static int mix[ MAX_MIX ];
+static int mix_count = 0;
+
+static long long currentTimeUs( void )
+    {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( long long ) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+
+static int parseMix( const char* str )
+    {
+    char* copy = strdup( str );
+    char* token;
+    for( token = strtok( copy, "," );
+         token != NULL;
+         token = strtok( NULL, "," ))
+        {
+        unsigned int i;
+        for( i = 0;
+             i < sizeof( requests ) / sizeof( requests[ 0 ] );
+             ++i )
+            if( strcmp( token, requests[ i ].name ) == 0 )
+                break;
+        if( i == sizeof( requests ) / sizeof( requests[ 0 ] ) || mix_count == MAX_MIX )
+            {
+            fprintf( stderr, "Invalid request type: %s\n", token );
+            free( copy );
+            return 0;
+            }
+        mix[ mix_count++ ] = i;
+        }
+    free( copy );
+    return mix_count > 0;
+    }
+
+static void asyncCallback( DapiConnection* conn, int seq, int order, void* user_data )
+    {
+    ( void ) conn;
+    ( void ) seq;
+    *( int* ) user_data = order != 0 ? 1 : -1;
+    }
+
+static int performRequest( DapiConnection* conn, int request )
+    {
+    switch( request )
+        {
+        case REQUEST_INIT:
+            return dapi_Init( conn );
+        case REQUEST_CAPABILITIES:
+            {
+            intarr capabilities;
+            if( !dapi_Capabilities( conn, &capabilities ))
+                return 0;
+            dapi_freeintarr( capabilities );
+            return 1;
+            }
+        case REQUEST_BUTTONORDER:
+            return dapi_ButtonOrder( conn ) != 0;
+        case REQUEST_ASYNC:
+            {
+            int done = 0;
+            if( dapi_callbackButtonOrder( conn, asyncCallback, &done ) == 0 )
+                return 0;
+            while( done == 0 )
+                {
+                struct pollfd pfd;
+                pfd.fd = dapi_socket( conn );
+                pfd.events = POLLIN;
+                if( poll( &pfd, 1, -1 ) < 0 )
+                    return 0;
+                if( pfd.revents & ( POLLERR | POLLHUP ))
+                    return 0;
+                dapi_processData( conn );
+                }
+            return done > 0;
+            }
+        case REQUEST_ADDRESSBOOK:
+            {
+            stringarr ids;
+            if( !dapi_AddressBookList( conn, &ids ))
+                return 0;
+            dapi_freestringarr( ids );
+            return 1;
+            }
+        }
+    return 0;
+    }
+
+/* Checks that the daemon supports all requests in the mix, otherwise
+   blocking calls would wait for replies that never come. */
+static int checkCapabilities( DapiConnection* conn )
+    {
+    intarr capabilities;
+    int i;
+    int ok = 1;
+    if( !dapi_Capabilities( conn, &capabilities ))
+        return 0;
+    for( i = 0;
+         i < mix_count;
+         ++i )
+        {
+        int j;
+        for( j = 0;
+             j < capabilities.count;
+             ++j )
+            if( capabilities.data[ j ] == requests[ mix[ i ] ].command )
+                break;
+        if( j == capabilities.count )
+            {
+            fprintf( stderr, "The daemon doesn't support request type %s.\n", requests[ mix[ i ] ].name );
+            ok = 0;
+            }
+        }
+    dapi_freeintarr( capabilities );
+    return ok;
+    }
+
+/* Returns the daemon's CPU time in clock ticks or -1. */
+static long long daemonCpu( int pid )
+    {
+    char name[ 64 ];
+    char buf[ 1024 ];
+    FILE* f;
+    char* pos;
+    unsigned long utime, stime;
+    snprintf( name, sizeof( name ), "/proc/%d/stat", pid );
+    f = fopen( name, "r" );
+    if( f == NULL )
+        return -1;
+    if( fgets( buf, sizeof( buf ), f ) == NULL )
+        {
+        fclose( f );
+        return -1;
+        }
+    fclose( f );
+    /* skip the pid and the command name, which may contain spaces */
+    pos = strrchr( buf, ')' );
+    if( pos == NULL
+        || sscanf( pos + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime ) != 2 )
+        return -1;
+    return utime + stime;
+    }
+
+static int daemonPid( DapiConnection* conn )
+    {
+    struct ucred cred;
+    socklen_t len = sizeof( cred );
+    if( getsockopt( dapi_socket( conn ), SOL_SOCKET, SO_PEERCRED, &cred, &len ) < 0 )
+        return -1;
+    return cred.pid;
+    }
+
+/* Each client stores latencies of its requests to its part of the shared results. */
+static int runClient( int client, int count, int timeout, int* results )
+    {
+    int i;
+    DapiConnection* conn = dapi_connectAndInit();
+    if( conn == NULL )
+        return 1;
+    dapi_setTimeout( conn, timeout );
+    for( i = 0;
+         i < count;
+         ++i )
+        {
+        long long start = currentTimeUs();
+        if( !performRequest( conn, mix[ ( client + i ) % mix_count ] ))
+            results[ i ] = -1;
+        else
+            results[ i ] = currentTimeUs() - start;
+        }
+    dapi_close( conn );
+    return 0;
+    }
+
+static int compareInt( const void* a, const void* b )
+    {
+    int ia = *( const int* ) a;
+    int ib = *( const int* ) b;
+    return ia < ib ? -1 : ia > ib ? 1 : 0;
+    }
+
+static int percentile( const int* sorted, int count, double fraction )
+    {
+    int pos = count * fraction;
+    if( pos >= count )
+        pos = count - 1;
+    return sorted[ pos ];
+    }
+
+int main( int argc, char* argv[] )
+    {
+    int clients = 4;
+    int count = 10000;
+    int timeout = -1;
+    const char* mix_str = "order";
+    int opt;
+    int* results;
+    int total;
+    int failed = 0;
+    int valid;
+    int i;
+    int pid;
+    long long cpu_start, cpu_end;
+    long long start, elapsed;
+    DapiConnection* conn;
+    while(( opt = getopt( argc, argv, "c:n:m:t:" )) != -1 )
+        {
+        switch( opt )
+            {
+            case 'c':
+                clients = atoi( optarg );
+                break;
+            case 'n':
+                count = atoi( optarg );
+                break;
+            case 'm':
+                mix_str = optarg;
+                break;
+            case 't':
+                timeout = atoi( optarg );
+                break;
+            default:
+                fprintf( stderr, "Usage: %s [-c clients] [-n requests per client]"
+                    " [-m init,caps,order,async,ab] [-t timeout]\n", argv[ 0 ] );
+                return 1;
+            }
+        }
+    if( clients <= 0 || count <= 0 || !parseMix( mix_str ))
+        return 1;
+    conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    if( !checkCapabilities( conn ))
+        return 1;
+    pid = daemonPid( conn );
+    total = clients * count;
+    results = mmap( NULL, total * sizeof( int ), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+    if( results == MAP_FAILED )
+        {
+        perror( "mmap" );
+        return 1;
+        }
+    memset( results, 0xff, total * sizeof( int ));
+    cpu_start = daemonCpu( pid );
+    start = currentTimeUs();
+    for( i = 0;
+         i < clients;
+         ++i )
+        {
+        int child = fork();
+        if( child < 0 )
+            {
+            perror( "fork" );
+            return 1;
+            }
+        if( child == 0 )
+            {
+            dapi_close( conn );
+            _exit( runClient( i, count, timeout, results + i * count ));
+            }
+        }
+    for( i = 0;
+         i < clients;
+         ++i )
+        wait( NULL );
+    elapsed = currentTimeUs() - start;
+    cpu_end = daemonCpu( pid );
+    dapi_close( conn );
+    valid = 0;
+    for( i = 0;
+         i < total;
+         ++i )
+        {
+        if( results[ i ] < 0 )
+            ++failed;
+        else
+            results[ valid++ ] = results[ i ];
+        }
+    qsort( results, valid, sizeof( int ), compareInt );
+    printf( "Clients: %d, requests: %d, mix: %s\n", clients, total, mix_str );
+    printf( "Failed: %d\n", failed );
+    printf( "Time: %.3f s, throughput: %.0f requests/s\n", elapsed / 1e6, valid * 1e6 / elapsed );
+    if( valid > 0 )
+        printf( "Latency (us): p50 %d, p99 %d, p999 %d, max %d\n", percentile( results, valid, 0.5 ),
+            percentile( results, valid, 0.99 ), percentile( results, valid, 0.999 ), results[ valid - 1 ] );
+    if( cpu_start >= 0 && cpu_end >= 0 && valid > 0 )
+        printf( "Daemon CPU: %.2f us/request\n",
+            ( cpu_end - cpu_start ) * 1e6 / sysconf( _SC_CLK_TCK ) / valid );
+    else
+        printf( "Daemon CPU: unknown\n" );
+    munmap( results, total * sizeof( int ));
+    return failed != 0;
+    }
@@ -0,0 +1,943 @@
+/* Headless stand-in daemon for benchmarking the protocol and the library.
+
+   dapi_fake [-n contacts] [-o order] [-f] [-t msecs]
+
+   Needs neither X nor a desktop, serves all commands with deterministic
+   fake replies and a synthetic address book of the given number of contacts.
+   Nothing is actually opened, executed or transferred. LocalFile returns
+   local files and the given local name for remote ones, UploadFile succeeds.
+   LocalFileFd opens local files and passes the fake contents of remote ones
+   in an in-memory file. With progress notifications enabled, downloads
+   report a fake 4GiB transfer in 4 steps before replying.
+   -o sets the ButtonOrder reply (also returned by GetSettings together
+   with a few fixed settings), -f makes all actions report failure,
+   -t changes the full name of one contact after another every msecs.
+   Like the real daemons, it exits when idle if started by the library
+   or by socket activation (see dapi_idleTimeout()).
+   Commands added to gen.txt should be served here too.
+*/
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <dapi/comm.h>
+
+typedef struct Contact
+    {
+    char* id;
+    char* givenname;
+    char* familyname;
+    char* fullname;
+    char* emails[ 2 ];
+    int email_count;
+    int generation; /* of the last change */
+    } Contact;
+
+typedef struct EmailEntry
+    {
+    const char* email;
+    const Contact* contact;
+    } EmailEntry;
+
+static Contact* contacts = NULL;
+static EmailEntry* email_index = NULL; /* sorted by email */
+static int email_index_count = 0;
+static int contact_count = 100;
+static int button_order = 1;
+static int action_ok = 1;
+static int touch_interval = 0;
+static int generation = 1;
+static int suspend_count = 0;
+
+static DapiConnection** connections = NULL;
+static int* progress_intervals = NULL;
+static int num_connections = 0;
+
+static char* makeString( const char* fmt, ... )
+#ifdef __GNUC__
+    __attribute (( format( printf, 1, 2 )))
+#endif
+    ;
+
+static char* makeString( const char* fmt, ... )
+    {
+    char buf[ 256 ];
+    va_list va;
+    va_start( va, fmt );
+    vsnprintf( buf, sizeof( buf ), fmt, va );
+    va_end( va );
+    return strdup( buf );
+    }
+
+static void createContacts( void )
+    {
+    int i;
+    contacts = calloc( contact_count > 0 ? contact_count : 1, sizeof( Contact ));
+    for( i = 0;
+         i < contact_count;
+         ++i )
+        {
+        Contact* c = &contacts[ i ];
+        c->id = makeString( "fake-%08d", i );
+        c->givenname = makeString( "Given%d", i );
+        c->familyname = makeString( "Family%d", i % 97 );
+        c->fullname = makeString( "%s %s", c->givenname, c->familyname );
+        c->emails[ c->email_count++ ] = makeString( "user%d@example.com", i );
+        if( i % 3 == 0 )
+            c->emails[ c->email_count++ ] = makeString( "user%d@work.example.com", i );
+        }
+    }
+
+static int compareEmails( const void* e1, const void* e2 )
+    {
+    return strcmp((( const EmailEntry* ) e1 )->email, (( const EmailEntry* ) e2 )->email );
+    }
+
+/* The fake emails are already lowercase and never change. */
+static void createEmailIndex( void )
+    {
+    int i;
+    int j;
+    email_index = malloc(( contact_count * 2 + 1 ) * sizeof( EmailEntry ));
+    for( i = 0;
+         i < contact_count;
+         ++i )
+        for( j = 0;
+             j < contacts[ i ].email_count;
+             ++j )
+            {
+            email_index[ email_index_count ].email = contacts[ i ].emails[ j ];
+            email_index[ email_index_count ].contact = &contacts[ i ];
+            ++email_index_count;
+            }
+    qsort( email_index, email_index_count, sizeof( EmailEntry ), compareEmails );
+    }
+
+/* Like dapi_kde, accepts also "Name <address>" and ignores case and surrounding spaces. */
+static void normalizeEmail( const char* email, char* buf, int size )
+    {
+    const char* start = strchr( email, '<' );
+    const char* end = strrchr( email, '>' );
+    int len;
+    int i;
+    if( start != NULL && end != NULL && end > start )
+        email = start + 1;
+    else
+        end = email + strlen( email );
+    while( email < end && ( *email == ' ' || *email == '\t' ))
+        ++email;
+    while( end > email && ( end[ -1 ] == ' ' || end[ -1 ] == '\t' ))
+        --end;
+    len = end - email < size - 1 ? end - email : size - 1;
+    for( i = 0;
+         i < len;
+         ++i )
+        buf[ i ] = tolower(( unsigned char ) email[ i ] );
+    buf[ len ] = '\0';
+    }
+
+/* Returns the number of contacts with the email, stores their ids in ids. */
+static int findByEmail( const char* email, char** ids )
+    {
+    char normalized[ 256 ];
+    EmailEntry key;
+    const EmailEntry* found;
+    int first;
+    int count = 0;
+    normalizeEmail( email, normalized, sizeof( normalized ));
+    key.email = normalized;
+    found = bsearch( &key, email_index, email_index_count, sizeof( EmailEntry ), compareEmails );
+    if( found == NULL )
+        return 0;
+    for( first = found - email_index;
+         first > 0 && strcmp( email_index[ first - 1 ].email, normalized ) == 0;
+         --first )
+        ;
+    while( first + count < email_index_count && strcmp( email_index[ first + count ].email, normalized ) == 0 )
+        {
+        ids[ count ] = email_index[ first + count ].contact->id;
+        ++count;
+        }
+    return count;
+    }
+
+static const Contact* findContact( const char* id )
+    {
+    int i;
+    /* ids are generated with the index, but don't rely on it */
+    if( strncmp( id, "fake-", 5 ) == 0 )
+        {
+        i = atoi( id + 5 );
+        if( i >= 0 && i < contact_count && strcmp( contacts[ i ].id, id ) == 0 )
+            return &contacts[ i ];
+        }
+    return NULL;
+    }
+
+static int formatVCard( const Contact* c, char* buf, int size )
+    {
+    return snprintf( buf, size, "BEGIN:VCARD\r\nVERSION:3.0\r\nUID:%s\r\n"
+        "N:%s;%s;;;\r\nFN:%s\r\nEMAIL:%s\r\nEND:VCARD\r\n",
+        c->id, c->familyname, c->givenname, c->fullname, c->emails[ 0 ] );
+    }
+
+/* Sends the vCards of the given contacts (all if none are given) in chunks
+   with the seq of the export, unknown ids are skipped. Returns the number
+   of exported contacts. */
+static int exportVCards( DapiConnection* conn, int seq, stringarr ids, int chunk_size )
+    {
+    int total = ids.count > 0 ? ids.count : contact_count;
+    char* chunk = NULL;
+    int chunk_len = 0;
+    int in_chunk = 0;
+    int count = 0;
+    int i;
+    if( chunk_size <= 0 )
+        chunk_size = 100;
+    chunk = malloc( chunk_size * 1024 );
+    for( i = 0;
+         i < total;
+         ++i )
+        {
+        const Contact* c = ids.count > 0 ? findContact( ids.data[ i ] ) : &contacts[ i ];
+        int len;
+        if( c == NULL )
+            continue;
+        len = formatVCard( c, chunk + chunk_len, 1024 );
+        chunk_len += len < 1024 ? len : 1023;
+        ++count;
+        if( ++in_chunk == chunk_size )
+            {
+            dapi_writeReplyAddressBookVCard30Chunk( conn, seq, chunk, in_chunk, 1 );
+            chunk_len = 0;
+            in_chunk = 0;
+            }
+        }
+    if( in_chunk > 0 )
+        dapi_writeReplyAddressBookVCard30Chunk( conn, seq, chunk, in_chunk, 1 );
+    free( chunk );
+    return count;
+    }
+
+static int* progressInterval( DapiConnection* conn )
+    {
+    int i;
+    for( i = 0;
+         i < num_connections;
+         ++i )
+        if( connections[ i ] == conn )
+            return &progress_intervals[ i ];
+    return NULL;
+    }
+
+static void fakeProgress( DapiConnection* conn, int seq, const char* file )
+    {
+    const long long total = 4LL << 30;
+    int* interval = progressInterval( conn );
+    int i;
+    if( interval == NULL || *interval <= 0 )
+        return;
+    for( i = 1;
+         i <= 4;
+         ++i )
+        dapi_writeReplyTransferProgress( conn, seq, file, total * i / 4, total, total * i / 4, 1 );
+    }
+
+static void notifySubscribers( int event, char* changed_id )
+    {
+    int i;
+    for( i = 0;
+         i < num_connections;
+         ++i )
+        {
+        DapiConnection* conn = connections[ i ];
+        if( conn == NULL || !dapi_isSubscribed( conn, event ))
+            continue;
+        if( event == DAPI_COMMAND_SCREENSAVERSUSPENDED )
+            dapi_writeReplyScreensaverSuspended( conn, 0, suspend_count > 0 );
+        else if( event == DAPI_COMMAND_ADDRESSBOOKCHANGES )
+            {
+            stringarr changed;
+            changed.count = 1;
+            changed.data = &changed_id;
+            dapi_writeReplyAddressBookChanges( conn, 0, generation, changed, 1 );
+            }
+        }
+    }
+
+/* Simulates somebody editing the address book. */
+static void touchContact( void )
+    {
+    Contact* c;
+    if( contact_count == 0 )
+        return;
+    c = &contacts[ ( generation - 1 ) % contact_count ];
+    free( c->fullname );
+    c->fullname = makeString( "%s %s (%d)", c->givenname, c->familyname, generation );
+    c->generation = ++generation;
+    notifySubscribers( DAPI_COMMAND_ADDRESSBOOKCHANGES, c->id );
+    }
+
+static long long currentTimeMs( void )
+    {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( long long ) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+
+static void closeConnection( DapiConnection* conn )
+    {
+    int i;
+    for( i = 0;
+         i < num_connections;
+         ++i )
+        {
+        if( connections[ i ] == conn )
+            {
+            connections[ i ] = NULL;
+            break;
+            }
+        }
+    dapi_close( conn );
+    }
+
+static int caps[] =
+    {
+    DAPI_COMMAND_INIT,
+    DAPI_COMMAND_CAPABILITIES,
+    DAPI_COMMAND_OPENURL,
+    DAPI_COMMAND_EXECUTEURL,
+    DAPI_COMMAND_BUTTONORDER,
+    DAPI_COMMAND_RUNASUSER,
+    DAPI_COMMAND_SUSPENDSCREENSAVING,
+    DAPI_COMMAND_MAILTO,
+    DAPI_COMMAND_LOCALFILE,
+    DAPI_COMMAND_UPLOADFILE,
+    DAPI_COMMAND_REMOVETEMPORARYLOCALFILE,
+    DAPI_COMMAND_ADDRESSBOOKLIST,
+    DAPI_COMMAND_ADDRESSBOOKGETNAME,
+    DAPI_COMMAND_ADDRESSBOOKGETEMAILS,
+    DAPI_COMMAND_ADDRESSBOOKFINDBYNAME,
+    DAPI_COMMAND_ADDRESSBOOKOWNER,
+    DAPI_COMMAND_ADDRESSBOOKGETVCARD30,
+    DAPI_COMMAND_STATS,
+    DAPI_COMMAND_SHAREDMEMORY,
+    DAPI_COMMAND_LOCALFILEFD,
+    DAPI_COMMAND_PROGRESSNOTIFICATIONS,
+    DAPI_COMMAND_TRANSFERPROGRESS,
+    DAPI_COMMAND_SUBSCRIBE,
+    DAPI_COMMAND_ADDRESSBOOKCHANGES,
+    DAPI_COMMAND_SCREENSAVERSUSPENDED,
+    DAPI_COMMAND_HANDSHAKE,
+    DAPI_COMMAND_GETSETTINGS,
+    DAPI_COMMAND_ADDRESSBOOKEXPORTVCARD30,
+    DAPI_COMMAND_ADDRESSBOOKFINDBYEMAIL
+    };
+
+static const char* const settings[][ 2 ] =
+    {
+    { "Net/DoubleClickTime", "400" },
+    { "Net/DndDragThreshold", "4" },
+    { "Net/CursorBlink", "1" },
+    { "Net/CursorBlinkTime", "1000" },
+    { "Net/ThemeName", "Fake" },
+    { "Net/IconThemeName", "fake-icons" },
+    { "Gtk/FontName", "Sans 10" }
+    };
+
+/* Unknown keys get empty values. */
+static const char* findSetting( const char* key )
+    {
+    static char order[ 16 ];
+    unsigned int i;
+    if( strcmp( key, "Dapi/ButtonOrder" ) == 0 )
+        {
+        snprintf( order, sizeof( order ), "%d", button_order );
+        return order;
+        }
+    for( i = 0;
+         i < sizeof( settings ) / sizeof( settings[ 0 ] );
+         ++i )
+        if( strcmp( settings[ i ][ 0 ], key ) == 0 )
+            return settings[ i ][ 1 ];
+    return "";
+    }
+
+/* Pretends to download the url without touching the disk. */
+static int downloadToMemory( const char* url )
+    {
+    char data[ 1024 ];
+    int size = snprintf( data, sizeof( data ), "Downloaded by dapi_fake from %s\n", url );
+    int fd;
+#ifdef MFD_CLOEXEC
+    fd = memfd_create( "dapi_fake", MFD_CLOEXEC );
+#else
+    FILE* f = tmpfile();
+    fd = f != NULL ? dup( fileno( f )) : -1;
+    if( f != NULL )
+        fclose( f );
+#endif
+    if( fd < 0 )
+        return -1;
+    if( size >= ( int ) sizeof( data ))
+        size = sizeof( data ) - 1;
+    if( write( fd, data, size ) != size || lseek( fd, 0, SEEK_SET ) < 0 )
+        {
+        close( fd );
+        return -1;
+        }
+    return fd;
+    }
+
+static void processCommand( DapiConnection* conn )
+    {
+    int command;
+    int seq;
+    if( !dapi_readCommand( conn, &command, &seq ))
+        {
+        closeConnection( conn );
+        return;
+        }
+    switch( command )
+        {
+        case DAPI_COMMAND_INIT:
+            if( !dapi_readCommandInit( conn ))
+                break;
+            dapi_writeReplyInit( conn, seq, 1 );
+            return;
+        case DAPI_COMMAND_CAPABILITIES:
+            {
+            intarr capabilities;
+            if( !dapi_readCommandCapabilities( conn ))
+                break;
+            capabilities.count = sizeof( caps ) / sizeof( caps[ 0 ] );
+            capabilities.data = caps;
+            dapi_writeReplyCapabilities( conn, seq, capabilities, 1 );
+            return;
+            }
+        case DAPI_COMMAND_HANDSHAKE:
+            {
+            int client_version;
+            int client_features;
+            int version;
+            intarr capabilities;
+            if( !dapi_readCommandHandshake( conn, &client_version, &client_features ))
+                break;
+            version = client_version < DAPI_PROTOCOL_VERSION ? client_version : DAPI_PROTOCOL_VERSION;
+            capabilities.count = sizeof( caps ) / sizeof( caps[ 0 ] );
+            capabilities.data = caps;
+            dapi_writeReplyHandshake( conn, seq, version, 0, capabilities, 1 );
+            dapi_setProtocolVersion( conn, version );
+            return;
+            }
+        case DAPI_COMMAND_OPENURL:
+            {
+            char* url;
+            DapiWindowInfo winfo;
+            if( !dapi_readCommandOpenUrl( conn, &url, &winfo ))
+                break;
+            dapi_writeReplyOpenUrl( conn, seq, action_ok );
+            free( url );
+            dapi_freeWindowInfo( winfo );
+            return;
+            }
+        case DAPI_COMMAND_EXECUTEURL:
+            {
+            char* url;
+            DapiWindowInfo winfo;
+            if( !dapi_readCommandExecuteUrl( conn, &url, &winfo ))
+                break;
+            dapi_writeReplyExecuteUrl( conn, seq, action_ok );
+            free( url );
+            dapi_freeWindowInfo( winfo );
+            return;
+            }
+        case DAPI_COMMAND_BUTTONORDER:
+            if( !dapi_readCommandButtonOrder( conn ))
+                break;
+            dapi_writeReplyButtonOrder( conn, seq, button_order );
+            return;
+        case DAPI_COMMAND_RUNASUSER:
+            {
+            char* user;
+            char* cmd;
+            DapiWindowInfo winfo;
+            if( !dapi_readCommandRunAsUser( conn, &user, &cmd, &winfo ))
+                break;
+            dapi_writeReplyRunAsUser( conn, seq, action_ok );
+            free( user );
+            free( cmd );
+            dapi_freeWindowInfo( winfo );
+            return;
+            }
+        case DAPI_COMMAND_SUSPENDSCREENSAVING:
+            {
+            int suspend;
+            int was_suspended = suspend_count > 0;
+            if( !dapi_readCommandSuspendScreensaving( conn, &suspend ))
+                break;
+            suspend_count += suspend ? 1 : -1;
+            if( suspend_count < 0 )
+                suspend_count = 0;
+            dapi_writeReplySuspendScreensaving( conn, seq, action_ok );
+            if( was_suspended != ( suspend_count > 0 ))
+                notifySubscribers( DAPI_COMMAND_SCREENSAVERSUSPENDED, NULL );
+            return;
+            }
+        case DAPI_COMMAND_MAILTO:
+            {
+            char* subject;
+            char* body;
+            char* to;
+            char* cc;
+            char* bcc;
+            stringarr attachments;
+            DapiWindowInfo winfo;
+            if( !dapi_readCommandMailTo( conn, &subject, &body, &to, &cc, &bcc, &attachments, &winfo ))
+                break;
+            dapi_writeReplyMailTo( conn, seq, action_ok );
+            free( subject );
+            free( body );
+            free( to );
+            free( cc );
+            free( bcc );
+            dapi_freestringarr( attachments );
+            dapi_freeWindowInfo( winfo );
+            return;
+            }
+        case DAPI_COMMAND_LOCALFILE:
+            {
+            char* remote;
+            char* local;
+            int allow_download;
+            DapiWindowInfo winfo;
+            const char* result = NULL;
+            if( !dapi_readCommandLocalFile( conn, &remote, &local, &allow_download, &winfo ))
+                break;
+            if( !action_ok )
+                ;
+            else if( remote[ 0 ] == '/' )
+                result = remote;
+            else if( strncmp( remote, "file://", 7 ) == 0 )
+                result = remote + 7;
+            else if( allow_download )
+                {
+                result = local[ 0 ] != '\0' ? local : "/tmp/dapi_fake_download";
+                fakeProgress( conn, seq, result );
+                }
+            dapi_writeReplyLocalFile( conn, seq, result );
+            free( remote );
+            free( local );
+            dapi_freeWindowInfo( winfo );
+            return;
+            }
+        case DAPI_COMMAND_LOCALFILEFD:
+            {
+            char* remote;
+            char* local;
+            int allow_download;
+            DapiWindowInfo winfo;
+            const char* result = NULL;
+            int fd = -1;
+            if( !dapi_readCommandLocalFileFd( conn, &remote, &local, &allow_download, &winfo ))
+                break;
+            if( !action_ok )
+                ;
+            else if( remote[ 0 ] == '/' )
+                result = remote;
+            else if( strncmp( remote, "file://", 7 ) == 0 )
+                result = remote + 7;
+            if( result != NULL )
+                fd = open( result, O_RDONLY | O_CLOEXEC );
+            else if( action_ok && allow_download )
+                {
+                fakeProgress( conn, seq, "" );
+                fd = downloadToMemory( remote );
+                }
+            dapi_writeReplyLocalFileFd( conn, seq, result, fd, fd >= 0 );
+            if( fd >= 0 )
+                close( fd );
+            free( remote );
+            free( local );
+            dapi_freeWindowInfo( winfo );
+            return;
+            }
+        case DAPI_COMMAND_UPLOADFILE:
+            {
+            char* local;
+            char* file;
+            int remove_local;
+            DapiWindowInfo winfo;
+            if( !dapi_readCommandUploadFile( conn, &local, &file, &remove_local, &winfo ))
+                break;
+            if( action_ok )
+                fakeProgress( conn, seq, "" );
+            dapi_writeReplyUploadFile( conn, seq, action_ok );
+            free( local );
+            free( file );
+            dapi_freeWindowInfo( winfo );
+            return;
+            }
+        case DAPI_COMMAND_REMOVETEMPORARYLOCALFILE:
+            {
+            char* local;
+            if( !dapi_readCommandRemoveTemporaryLocalFile( conn, &local ))
+                break;
+            dapi_writeReplyRemoveTemporaryLocalFile( conn, seq, 1 );
+            free( local );
+            return;
+            }
+        case DAPI_COMMAND_ADDRESSBOOKLIST:
+            {
+            stringarr ids;
+            int i;
+            if( !dapi_readCommandAddressBookList( conn ))
+                break;
+            ids.count = contact_count;
+            ids.data = malloc( ( contact_count + 1 ) * sizeof( char* ));
+            for( i = 0;
+                 i < contact_count;
+                 ++i )
+                ids.data[ i ] = contacts[ i ].id;
+            dapi_writeReplyAddressBookList( conn, seq, ids, contact_count > 0 );
+            free( ids.data );
+            return;
+            }
+        case DAPI_COMMAND_ADDRESSBOOKGETNAME:
+            {
+            char* id;
+            const Contact* c;
+            if( !dapi_readCommandAddressBookGetName( conn, &id ))
+                break;
+            c = findContact( id );
+            if( c != NULL )
+                dapi_writeReplyAddressBookGetName( conn, seq, c->givenname, c->familyname, c->fullname, 1 );
+            else
+                dapi_writeReplyAddressBookGetName( conn, seq, NULL, NULL, NULL, 0 );
+            free( id );
+            return;
+            }
+        case DAPI_COMMAND_ADDRESSBOOKGETEMAILS:
+            {
+            char* id;
+            const Contact* c;
+            stringarr emails;
+            if( !dapi_readCommandAddressBookGetEmails( conn, &id ))
+                break;
+            c = findContact( id );
+            emails.count = c != NULL ? c->email_count : 0;
+            emails.data = c != NULL ? ( char** ) c->emails : NULL;
+            dapi_writeReplyAddressBookGetEmails( conn, seq, emails, c != NULL );
+            free( id );
+            return;
+            }
+        case DAPI_COMMAND_ADDRESSBOOKFINDBYNAME:
+            {
+            char* name;
+            stringarr ids;
+            int i;
+            if( !dapi_readCommandAddressBookFindByName( conn, &name ))
+                break;
+            ids.count = 0;
+            ids.data = malloc( ( contact_count + 1 ) * sizeof( char* ));
+            for( i = 0;
+                 i < contact_count;
+                 ++i )
+                if( strcasestr( contacts[ i ].fullname, name ) != NULL )
+                    ids.data[ ids.count++ ] = contacts[ i ].id;
+            dapi_writeReplyAddressBookFindByName( conn, seq, ids, ids.count > 0 );
+            free( ids.data );
+            free( name );
+            return;
+            }
+        case DAPI_COMMAND_ADDRESSBOOKFINDBYEMAIL:
+            {
+            char* email;
+            stringarr ids;
+            if( !dapi_readCommandAddressBookFindByEmail( conn, &email ))
+                break;
+            ids.data = malloc(( email_index_count + 1 ) * sizeof( char* ));
+            ids.count = findByEmail( email, ids.data );
+            dapi_writeReplyAddressBookFindByEmail( conn, seq, ids, ids.count > 0 );
+            free( ids.data );
+            free( email );
+            return;
+            }
+        case DAPI_COMMAND_ADDRESSBOOKOWNER:
+            if( !dapi_readCommandAddressBookOwner( conn ))
+                break;
+            dapi_writeReplyAddressBookOwner( conn, seq, contact_count > 0 ? contacts[ 0 ].id : NULL,
+                contact_count > 0 );
+            return;
+        case DAPI_COMMAND_ADDRESSBOOKGETVCARD30:
+            {
+            char* id;
+            const Contact* c;
+            char vcard[ 1024 ];
+            if( !dapi_readCommandAddressBookGetVCard30( conn, &id ))
+                break;
+            c = findContact( id );
+            if( c != NULL )
+                {
+                formatVCard( c, vcard, sizeof( vcard ));
+                dapi_writeReplyAddressBookGetVCard30( conn, seq, vcard, 1 );
+                }
+            else
+                dapi_writeReplyAddressBookGetVCard30( conn, seq, NULL, 0 );
+            free( id );
+            return;
+            }
+        case DAPI_COMMAND_ADDRESSBOOKEXPORTVCARD30:
+            {
+            stringarr ids;
+            int chunk_size;
+            int count;
+            if( !dapi_readCommandAddressBookExportVCard30( conn, &ids, &chunk_size ))
+                break;
+            count = exportVCards( conn, seq, ids, chunk_size );
+            dapi_writeReplyAddressBookExportVCard30( conn, seq, count, 1 );
+            dapi_freestringarr( ids );
+            return;
+            }
+        case DAPI_COMMAND_STATS:
+            {
+            intarr stats;
+            if( !dapi_readCommandStats( conn ))
+                break;
+            stats = dapi_getStats();
+            dapi_writeReplyStats( conn, seq, stats, 1 );
+            dapi_freeintarr( stats );
+            return;
+            }
+        case DAPI_COMMAND_PROGRESSNOTIFICATIONS:
+            {
+            int interval;
+            if( !dapi_readCommandProgressNotifications( conn, &interval ))
+                break;
+            *progressInterval( conn ) = interval;
+            dapi_writeReplyProgressNotifications( conn, seq, 1 );
+            return;
+            }
+        case DAPI_COMMAND_TRANSFERPROGRESS:
+            {
+            int transfer;
+            if( !dapi_readCommandTransferProgress( conn, &transfer ))
+                break;
+            /* transfers finish immediately */
+            dapi_writeReplyTransferProgress( conn, seq, NULL, 0, 0, 0, 0 );
+            return;
+            }
+        case DAPI_COMMAND_SUBSCRIBE:
+            {
+            intarr events;
+            if( !dapi_readCommandSubscribe( conn, &events ))
+                break;
+            dapi_setSubscriptions( conn, events );
+            dapi_writeReplySubscribe( conn, seq, 1 );
+            dapi_freeintarr( events );
+            return;
+            }
+        case DAPI_COMMAND_ADDRESSBOOKCHANGES:
+            {
+            int since;
+            stringarr changed;
+            int i;
+            if( !dapi_readCommandAddressBookChanges( conn, &since ))
+                break;
+            changed.count = 0;
+            changed.data = malloc(( contact_count + 1 ) * sizeof( char* ));
+            for( i = 0;
+                 i < contact_count;
+                 ++i )
+                if( contacts[ i ].generation > since )
+                    changed.data[ changed.count++ ] = contacts[ i ].id;
+            dapi_writeReplyAddressBookChanges( conn, seq, generation, changed, since <= generation );
+            free( changed.data );
+            return;
+            }
+        case DAPI_COMMAND_SCREENSAVERSUSPENDED:
+            if( !dapi_readCommandScreensaverSuspended( conn ))
+                break;
+            dapi_writeReplyScreensaverSuspended( conn, seq, suspend_count > 0 );
+            return;
+        case DAPI_COMMAND_GETSETTINGS:
+            {
+            stringarr keys;
+            stringarr values;
+            int i;
+            if( !dapi_readCommandGetSettings( conn, &keys ))
+                break;
+            values.count = keys.count;
+            values.data = malloc(( keys.count > 0 ? keys.count : 1 ) * sizeof( char* ));
+            for( i = 0;
+                 i < keys.count;
+                 ++i )
+                values.data[ i ] = ( char* ) findSetting( keys.data[ i ] );
+            dapi_writeReplyGetSettings( conn, seq, values, 1 );
+            dapi_freestringarr( keys );
+            free( values.data );
+            return;
+            }
+        case DAPI_COMMAND_SHAREDMEMORY:
+            {
+            int threshold;
+            if( !dapi_readCommandSharedMemory( conn, &threshold ))
+                break;
+            dapi_writeReplySharedMemory( conn, seq, dapi_setSharedMemoryThreshold( conn, threshold ));
+            return;
+            }
+        default:
+            fprintf( stderr, "Unknown command %d: %d\n", dapi_socket( conn ), command );
+            return;
+        }
+    closeConnection( conn );
+    }
+
+static void processData( int pos )
+    {
+    DapiConnection* conn = connections[ pos ];
+    int ok = dapi_receiveData( conn );
+    /* the replies to all the commands are sent together */
+    dapi_beginBatch( conn );
+    while( connections[ pos ] == conn && dapi_hasCommand( conn ))
+        processCommand( conn );
+    if( connections[ pos ] == conn && !dapi_endBatch( conn ))
+        ok = 0;
+    if( !ok && connections[ pos ] == conn )
+        closeConnection( conn );
+    }
+
+int main( int argc, char* argv[] )
+    {
+    int i;
+    int opt;
+    int mainsock;
+    int idle_timeout;
+    long long next_touch = 0;
+    long long idle_since = 0;
+    while(( opt = getopt( argc, argv, "n:o:ft:" )) != -1 )
+        {
+        switch( opt )
+            {
+            case 'n':
+                contact_count = atoi( optarg );
+                break;
+            case 'o':
+                button_order = atoi( optarg );
+                break;
+            case 'f':
+                action_ok = 0;
+                break;
+            case 't':
+                touch_interval = atoi( optarg );
+                break;
+            default:
+                fprintf( stderr, "Usage: %s [-n contacts] [-o order] [-f] [-t msecs]\n", argv[ 0 ] );
+                return 1;
+            }
+        }
+    if( contact_count < 0 )
+        contact_count = 0;
+    createContacts();
+    createEmailIndex();
+    mainsock = dapi_bindSocket();
+    if( mainsock < 0 )
+        return 2;
+    idle_timeout = dapi_idleTimeout();
+    if( touch_interval > 0 )
+        next_touch = currentTimeMs() + touch_interval;
+    for(;;)
+        {
+        fd_set in;
+        fd_set out;
+        int maxsock = mainsock;
+        int active = 0;
+        long long now = currentTimeMs();
+        long long wait = -1;
+        struct timeval timeout;
+        if( touch_interval > 0 )
+            {
+            if( now >= next_touch )
+                {
+                touchContact();
+                next_touch = now + touch_interval;
+                }
+            wait = next_touch - now;
+            }
+        FD_ZERO( &in );
+        FD_ZERO( &out );
+        FD_SET( mainsock, &in );
+        for( i = 0;
+             i < num_connections;
+             ++i )
+            if( connections[ i ] != NULL )
+                {
+                int sock = dapi_socket( connections[ i ] );
+                FD_SET( sock, &in );
+                if( dapi_hasUnsentData( connections[ i ] ))
+                    FD_SET( sock, &out );
+                if( sock > maxsock )
+                    maxsock = sock;
+                ++active;
+                }
+        if( idle_timeout > 0 && active == 0 && suspend_count == 0 )
+            {
+            if( idle_since == 0 )
+                idle_since = now;
+            if( now - idle_since >= idle_timeout )
+                return 0;
+            if( wait < 0 || idle_since + idle_timeout - now < wait )
+                wait = idle_since + idle_timeout - now;
+            }
+        else
+            idle_since = 0;
+        timeout.tv_sec = wait / 1000;
+        timeout.tv_usec = wait % 1000 * 1000;
+        if( select( maxsock + 1, &in, &out, NULL, wait >= 0 ? &timeout : NULL ) <= 0 )
+            continue;
+        for( i = 0;
+             i < num_connections;
+             ++i )
+            {
+            if( connections[ i ] != NULL && FD_ISSET( dapi_socket( connections[ i ] ), &out ))
+                {
+                if( !dapi_sendData( connections[ i ] ))
+                    closeConnection( connections[ i ] );
+                }
+            if( connections[ i ] != NULL && FD_ISSET( dapi_socket( connections[ i ] ), &in ))
+                processData( i );
+            }
+        if( FD_ISSET( mainsock, &in ))
+            {
+            DapiConnection* conn = dapi_acceptSocket( mainsock );
+            if( conn != NULL )
+                {
+                int pos;
+                for( pos = 0;
+                     pos < num_connections;
+                     ++pos )
+                    {
+                    if( connections[ pos ] == NULL )
+                        break;
+                    }
+                if( pos == num_connections )
+                    {
+                    ++num_connections;
+                    connections = realloc( connections, sizeof( DapiConnection* ) * num_connections );
+                    progress_intervals = realloc( progress_intervals, sizeof( int ) * num_connections );
+                    }
+                connections[ pos ] = conn;
+                progress_intervals[ pos ] = 0;
+                }
+            }
+        }
+    }
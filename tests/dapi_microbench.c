@@ -0,0 +1,357 @@
+/* Microbenchmark of the serialization layer.
+
+   dapi_microbench [-t target bytes per case]
+
+   Encodes and decodes commands of increasing size using the generated
+   dapi_writeCommandXYZ() and dapi_readCommandXYZ() functions, over
+   an in-memory connection (no syscalls, measures only encoding and decoding)
+   and over a socketpair with a writer thread. Reports time, syscalls
+   (send/recv/poll) and allocations (malloc/calloc/realloc) per message.
+   Counting works by interposing the functions, so it requires glibc.
+*/
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <dapi/comm.h>
+
+static volatile long syscalls = 0;
+static volatile long allocations = 0;
+
+extern void* __libc_malloc( size_t size );
+extern void* __libc_calloc( size_t n, size_t size );
+extern void* __libc_realloc( void* ptr, size_t size );
+
+void* malloc( size_t size )
+    {
+    __sync_fetch_and_add( &allocations, 1 );
+    return __libc_malloc( size );
+    }
+
+void* calloc( size_t n, size_t size )
+    {
+    __sync_fetch_and_add( &allocations, 1 );
+    return __libc_calloc( n, size );
+    }
+
+void* realloc( void* ptr, size_t size )
+    {
+    __sync_fetch_and_add( &allocations, 1 );
+    return __libc_realloc( ptr, size );
+    }
+
+ssize_t send( int fd, const void* buf, size_t len, int flags )
+    {
+    static ssize_t ( *real_send )( int, const void*, size_t, int ) = NULL;
+    if( real_send == NULL )
+        real_send = dlsym( RTLD_NEXT, "send" );
+    __sync_fetch_and_add( &syscalls, 1 );
+    return real_send( fd, buf, len, flags );
+    }
+
+ssize_t recv( int fd, void* buf, size_t len, int flags )
+    {
+    static ssize_t ( *real_recv )( int, void*, size_t, int ) = NULL;
+    if( real_recv == NULL )
+        real_recv = dlsym( RTLD_NEXT, "recv" );
+    __sync_fetch_and_add( &syscalls, 1 );
+    return real_recv( fd, buf, len, flags );
+    }
+
+int poll( struct pollfd* fds, nfds_t nfds, int timeout )
+    {
+    static int ( *real_poll )( struct pollfd*, nfds_t, int ) = NULL;
+    if( real_poll == NULL )
+        real_poll = dlsym( RTLD_NEXT, "poll" );
+    __sync_fetch_and_add( &syscalls, 1 );
+    return real_poll( fds, nfds, timeout );
+    }
+
+typedef enum { CASE_EMPTY, CASE_STRING, CASE_STRINGARR } CaseType;
+
+typedef struct Case
+    {
+    const char* name;
+    CaseType type;
+    int size; /* string length resp. number of strings */
+    } Case;
+
+static const Case cases[] =
+    {
+    { "empty (ButtonOrder)", CASE_EMPTY, 0 },
+    { "string 16 (OpenUrl)", CASE_STRING, 16 },
+    { "string 1k (OpenUrl)", CASE_STRING, 1024 },
+    { "string 64k (OpenUrl)", CASE_STRING, 65536 },
+    { "stringarr 0 (MailTo)", CASE_STRINGARR, 0 },
+    { "stringarr 10 (MailTo)", CASE_STRINGARR, 10 },
+    { "stringarr 1k (MailTo)", CASE_STRINGARR, 1000 },
+    { "stringarr 100k (MailTo)", CASE_STRINGARR, 100000 }
+    };
+
+typedef struct Payload
+    {
+    const Case* c;
+    char* string;
+    stringarr attachments;
+    DapiWindowInfo winfo;
+    int count;
+    DapiConnection* conn;
+    } Payload;
+
+static long long currentTimeNs( void )
+    {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( long long ) ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+
+static void createPayload( Payload* p, const Case* c )
+    {
+    int i;
+    p->c = c;
+    p->string = malloc( c->size + 1 );
+    memset( p->string, 'x', c->size );
+    p->string[ c->size ] = '\0';
+    p->attachments.count = c->type == CASE_STRINGARR ? c->size : 0;
+    p->attachments.data = malloc(( p->attachments.count + 1 ) * sizeof( char* ));
+    for( i = 0;
+         i < p->attachments.count;
+         ++i )
+        p->attachments.data[ i ] = "/tmp/attachment.txt";
+    dapi_windowInfoInitWindow( &p->winfo, 0x1234567 );
+    }
+
+static void freePayload( Payload* p )
+    {
+    free( p->string );
+    free( p->attachments.data );
+    }
+
+/* Size of the message on the wire, see the encoding in comm.c . */
+static int messageSize( const Payload* p )
+    {
+    int header = 3 * sizeof( int );
+    int winfo = sizeof( p->winfo.flags ) + sizeof( p->winfo.window );
+    int i;
+    int size;
+    switch( p->c->type )
+        {
+        case CASE_EMPTY:
+            return header;
+        case CASE_STRING:
+            return header + sizeof( int ) + strlen( p->string ) + winfo;
+        case CASE_STRINGARR:
+            size = header + 5 * sizeof( int ) + strlen( "subject" ) + strlen( "body" )
+                + strlen( "to@example.com" ) + sizeof( int ) + winfo;
+            for( i = 0;
+                 i < p->attachments.count;
+                 ++i )
+                size += sizeof( int ) + strlen( p->attachments.data[ i ] );
+            return size;
+        }
+    return 0;
+    }
+
+static int writeMessage( DapiConnection* conn, const Payload* p )
+    {
+    switch( p->c->type )
+        {
+        case CASE_EMPTY:
+            return dapi_writeCommandButtonOrder( conn );
+        case CASE_STRING:
+            return dapi_writeCommandOpenUrl( conn, p->string, p->winfo );
+        case CASE_STRINGARR:
+            return dapi_writeCommandMailTo( conn, "subject", "body", "to@example.com", "", "",
+                p->attachments, p->winfo );
+        }
+    return 0;
+    }
+
+static int readMessage( DapiConnection* conn, const Payload* p )
+    {
+    int command, seq;
+    if( !dapi_readCommand( conn, &command, &seq ))
+        return 0;
+    switch( p->c->type )
+        {
+        case CASE_EMPTY:
+            return dapi_readCommandButtonOrder( conn );
+        case CASE_STRING:
+            {
+            char* url;
+            DapiWindowInfo winfo;
+            if( !dapi_readCommandOpenUrl( conn, &url, &winfo ))
+                return 0;
+            free( url );
+            dapi_freeWindowInfo( winfo );
+            return 1;
+            }
+        case CASE_STRINGARR:
+            {
+            char* subject;
+            char* body;
+            char* to;
+            char* cc;
+            char* bcc;
+            stringarr attachments;
+            DapiWindowInfo winfo;
+            if( !dapi_readCommandMailTo( conn, &subject, &body, &to, &cc, &bcc, &attachments, &winfo ))
+                return 0;
+            free( subject );
+            free( body );
+            free( to );
+            free( cc );
+            free( bcc );
+            dapi_freestringarr( attachments );
+            dapi_freeWindowInfo( winfo );
+            return 1;
+            }
+        }
+    return 0;
+    }
+
+static void* writerThread( void* arg )
+    {
+    Payload* p = arg;
+    int i;
+    for( i = 0;
+         i < p->count;
+         ++i )
+        if( !writeMessage( p->conn, p ))
+            break;
+    return NULL;
+    }
+
+static void report( const char* name, const char* transport, int count, int bytes, long long time,
+    long calls, long allocs )
+    {
+    printf( "%-24s %-10s %10d %12.0f %10.2f %10.2f\n", name, transport, bytes,
+        ( double ) time / count, ( double ) calls / count, ( double ) allocs / count );
+    }
+
+static int runMemory( const Case* c, long long target )
+    {
+    Payload p;
+    DapiConnection* conn = dapi_memoryConnection();
+    int i;
+    int count;
+    int bytes;
+    long long start;
+    long calls, allocs;
+    createPayload( &p, c );
+    bytes = messageSize( &p );
+    /* the first message allocates the buffers */
+    if( !writeMessage( conn, &p ) || !dapi_hasCommand( conn ) || !readMessage( conn, &p ))
+        {
+        fprintf( stderr, "%s: in-memory transfer failed!\n", c->name );
+        return 0;
+        }
+    count = bytes > 0 ? target / bytes : 1000;
+    if( count < 10 )
+        count = 10;
+    if( count > 200000 )
+        count = 200000;
+    calls = syscalls;
+    allocs = allocations;
+    start = currentTimeNs();
+    for( i = 0;
+         i < count;
+         ++i )
+        {
+        if( !writeMessage( conn, &p ) || !dapi_hasCommand( conn ) || !readMessage( conn, &p ))
+            {
+            fprintf( stderr, "%s: in-memory transfer failed!\n", c->name );
+            return 0;
+            }
+        }
+    report( c->name, "memory", count, bytes, currentTimeNs() - start, syscalls - calls,
+        allocations - allocs );
+    dapi_close( conn );
+    freePayload( &p );
+    return bytes;
+    }
+
+static int runSocket( const Case* c, long long target, int bytes )
+    {
+    Payload p;
+    int fds[ 2 ];
+    DapiConnection* reader;
+    pthread_t thread;
+    int i;
+    long long start;
+    long calls, allocs;
+    if( socketpair( AF_UNIX, SOCK_STREAM, 0, fds ) < 0 )
+        {
+        perror( "socketpair" );
+        return 0;
+        }
+    createPayload( &p, c );
+    p.count = bytes > 0 ? target / bytes : 1000;
+    if( p.count < 10 )
+        p.count = 10;
+    if( p.count > 200000 )
+        p.count = 200000;
+    p.conn = dapi_socketConnection( fds[ 1 ] );
+    reader = dapi_socketConnection( fds[ 0 ] );
+    calls = syscalls;
+    allocs = allocations;
+    start = currentTimeNs();
+    pthread_create( &thread, NULL, writerThread, &p );
+    for( i = 0;
+         i < p.count;
+         ++i )
+        {
+        if( !readMessage( reader, &p ))
+            {
+            fprintf( stderr, "%s: socket transfer failed!\n", c->name );
+            break;
+            }
+        }
+    pthread_join( thread, NULL );
+    report( c->name, "socketpair", p.count, bytes, currentTimeNs() - start, syscalls - calls,
+        allocations - allocs );
+    dapi_close( reader );
+    dapi_close( p.conn );
+    freePayload( &p );
+    return 1;
+    }
+
+int main( int argc, char* argv[] )
+    {
+    long long target = 64 * 1024 * 1024;
+    unsigned int i;
+    int opt;
+    while(( opt = getopt( argc, argv, "t:" )) != -1 )
+        {
+        switch( opt )
+            {
+            case 't':
+                target = atoll( optarg );
+                break;
+            default:
+                fprintf( stderr, "Usage: %s [-t target bytes per case]\n", argv[ 0 ] );
+                return 1;
+            }
+        }
+    printf( "%-24s %-10s %10s %12s %10s %10s\n", "Message", "Transport", "Bytes", "ns/msg",
+        "sys/msg", "alloc/msg" );
+    for( i = 0;
+         i < sizeof( cases ) / sizeof( cases[ 0 ] );
+         ++i )
+        {
+        int bytes = runMemory( &cases[ i ], target );
+        if( bytes == 0 )
+            return 1;
+        runSocket( &cases[ i ], target, bytes );
+        }
+    return 0;
+    }
@@ -0,0 +1,151 @@
+/* Starts dapi_fake (from the directory of this test) in a temporary $HOME
+   and $XDG_RUNTIME_DIR, first by letting the library start it and checking that
+   it exits when idle, then by socket activation with a pre-bound socket
+   at the legacy location, which clients must still find. */
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+
+static char daemon_path[ 1024 ];
+static char sock_file[ 1024 ];
+static char legacy_sock_file[ 1024 ];
+
+/* With legacy set the daemon uses the socket in $HOME like older versions. */
+static int runDaemon( int listen_sock, int legacy )
+    {
+    int pid = fork();
+    if( pid == 0 )
+        {
+        if( legacy )
+            unsetenv( "XDG_RUNTIME_DIR" );
+        if( listen_sock >= 0 )
+            {
+            char buf[ 32 ];
+            dup2( listen_sock, 3 );
+            snprintf( buf, sizeof( buf ), "%d", getpid());
+            setenv( "LISTEN_PID", buf, 1 );
+            setenv( "LISTEN_FDS", "1", 1 );
+            }
+        execl( daemon_path, daemon_path, NULL );
+        _exit( 127 );
+        }
+    return pid;
+    }
+
+static int testAutoSpawn( void )
+    {
+    DapiConnection* conn;
+    setenv( "DAPI_DAEMON", daemon_path, 1 );
+    setenv( "DAPI_IDLE_TIMEOUT", "1", 1 );
+    conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Daemon not started!\n" );
+        return 0;
+        }
+    printf( "Started daemon: order %d\n", dapi_ButtonOrder( conn ));
+    dapi_close( conn );
+    sleep( 2 );
+    setenv( "DAPI_DAEMON", "", 1 );
+    conn = dapi_connect();
+    if( conn != NULL )
+        {
+        fprintf( stderr, "Daemon did not exit when idle!\n" );
+        dapi_close( conn );
+        return 0;
+        }
+    unsetenv( "DAPI_IDLE_TIMEOUT" );
+    return 1;
+    }
+
+static int testActivation( void )
+    {
+    struct sockaddr_un addr;
+    DapiConnection* conn;
+    int status;
+    int pid;
+    int pid2;
+    int sock = socket( PF_UNIX, SOCK_STREAM, 0 );
+    unlink( legacy_sock_file );
+    addr.sun_family = AF_UNIX;
+    strcpy( addr.sun_path, legacy_sock_file );
+    if( sock < 0 || bind( sock, ( struct sockaddr* ) &addr, sizeof( addr )) < 0 || listen( sock, 16 ) < 0 )
+        {
+        perror( "bind" );
+        return 0;
+        }
+    /* the connection waits in the backlog until the daemon accepts it */
+    setenv( "DAPI_DAEMON", "", 1 );
+    pid = runDaemon( sock, 1 );
+    close( sock );
+    conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect to the socket-activated daemon!\n" );
+        kill( pid, SIGTERM );
+        return 0;
+        }
+    printf( "Socket-activated daemon: order %d\n", dapi_ButtonOrder( conn ));
+    /* a second daemon must not take over the socket of a running one */
+    pid2 = runDaemon( -1, 1 );
+    waitpid( pid2, &status, 0 );
+    if( !WIFEXITED( status ) || WEXITSTATUS( status ) == 0 || dapi_ButtonOrder( conn ) == 0 )
+        {
+        fprintf( stderr, "Second daemon replaced the running one!\n" );
+        dapi_close( conn );
+        kill( pid, SIGTERM );
+        return 0;
+        }
+    dapi_close( conn );
+    kill( pid, SIGTERM );
+    waitpid( pid, NULL, 0 );
+    return 1;
+    }
+
+int main( int argc, char* argv[] )
+    {
+    char home[] = "/tmp/dapi_test_activationXXXXXX";
+    char hostname[ 256 ];
+    char lock_file[ 1100 ];
+    const char* slash = strrchr( argv[ 0 ], '/' );
+    int ret = 0;
+    ( void ) argc;
+    snprintf( daemon_path, sizeof( daemon_path ), "%.*s/dapi_fake",
+        slash != NULL ? ( int )( slash - argv[ 0 ] ) : 1, slash != NULL ? argv[ 0 ] : "." );
+    if( mkdtemp( home ) == NULL )
+        {
+        perror( "mkdtemp" );
+        return 1;
+        }
+    setenv( "HOME", home, 1 );
+    setenv( "XDG_RUNTIME_DIR", home, 1 );
+    setenv( "DISPLAY", ":7", 1 );
+    gethostname( hostname, sizeof( hostname ));
+    hostname[ sizeof( hostname ) - 1 ] = '\0';
+    snprintf( sock_file, sizeof( sock_file ), "%s/dapi-%s:7", home, hostname );
+    snprintf( legacy_sock_file, sizeof( legacy_sock_file ), "%s/.dapi-%s:7", home, hostname );
+    if( !testAutoSpawn())
+        ret = 2;
+    else if( !testActivation())
+        ret = 3;
+    unlink( sock_file );
+    unlink( legacy_sock_file );
+    snprintf( lock_file, sizeof( lock_file ), "%s.lock", sock_file );
+    unlink( lock_file );
+    snprintf( lock_file, sizeof( lock_file ), "%s.lock", legacy_sock_file );
+    unlink( lock_file );
+    if( rmdir( home ) < 0 )
+        perror( "rmdir" );
+    return ret;
+    }
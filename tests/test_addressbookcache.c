@@ -0,0 +1,151 @@
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+#include <dapi/callbacks.h>
+#include <dapi/addressbook.h>
+
+/* Returns how many times the daemon has processed the command. */
+static int commandCount( DapiConnection* conn, int command )
+    {
+    intarr stats;
+    int pos = 0;
+    int ret = 0;
+    if( !dapi_Stats( conn, &stats ))
+        return -1;
+    while( pos + 8 <= stats.count )
+        {
+        if( stats.data[ pos ] == command )
+            ret = stats.data[ pos + 1 ];
+        pos += 8 + stats.data[ pos + 7 ] * 2;
+        }
+    dapi_freeintarr( stats );
+    return ret;
+    }
+
+static char* changed_id = NULL;
+
+static void changesCallback( DapiConnection* conn, int seq, int generation, stringarr changed,
+    int ok, void* user_data )
+    {
+    ( void ) conn;
+    ( void ) user_data;
+    printf( "Event %d: generation %d, %d changed\n", seq, generation, changed.count );
+    if( ok && changed.count > 0 && changed_id == NULL )
+        changed_id = strdup( changed.data[ 0 ] );
+    }
+
+static int lookupAll( DapiConnection* conn, stringarr ids, char** names )
+    {
+    int i;
+    for( i = 0;
+         i < ids.count;
+         ++i )
+        {
+        char* givenname;
+        char* familyname;
+        char* fullname;
+        stringarr emails;
+        if( !dapi_AddressBookGetNameCached( conn, ids.data[ i ], &givenname, &familyname, &fullname )
+            || !dapi_AddressBookGetEmailsCached( conn, ids.data[ i ], &emails ))
+            return 0;
+        if( names[ i ] != NULL && strcmp( names[ i ], fullname ) != 0 )
+            {
+            fprintf( stderr, "Cached name differs: %s != %s\n", names[ i ], fullname );
+            return 0;
+            }
+        free( names[ i ] );
+        names[ i ] = fullname;
+        free( givenname );
+        free( familyname );
+        dapi_freestringarr( emails );
+        }
+    return 1;
+    }
+
+int main()
+    {
+    stringarr ids;
+    char** names;
+    int before;
+    int i;
+    int ret = 0;
+    DapiConnection* conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    if( !dapi_enableAddressBookCache( conn ))
+        {
+        printf( "Address book cache not supported by the daemon.\n" );
+        dapi_close( conn );
+        return 0;
+        }
+    dapi_setEventCallback( conn, DAPI_COMMAND_ADDRESSBOOKCHANGES, changesCallback, NULL );
+    if( !dapi_AddressBookListCached( conn, &ids ))
+        {
+        fprintf( stderr, "AddressBookList failed!\n" );
+        return 2;
+        }
+    names = calloc( ids.count + 1, sizeof( char* ));
+    if( !lookupAll( conn, ids, names ))
+        return 3;
+    before = commandCount( conn, DAPI_COMMAND_ADDRESSBOOKGETNAME );
+    if( !lookupAll( conn, ids, names ))
+        return 4;
+    if( commandCount( conn, DAPI_COMMAND_ADDRESSBOOKGETNAME ) != before )
+        {
+        fprintf( stderr, "Cached lookups reached the daemon!\n" );
+        ret = 5;
+        }
+    printf( "%d contacts cached\n", ids.count );
+    /* if the daemon changes contacts (dapi_fake -t), check that the change is seen */
+    for( i = 0;
+         i < 20 && changed_id == NULL;
+         ++i )
+        {
+        struct pollfd pfd;
+        pfd.fd = dapi_socket( conn );
+        pfd.events = POLLIN;
+        if( poll( &pfd, 1, 100 ) > 0 )
+            dapi_processData( conn );
+        }
+    if( changed_id != NULL )
+        {
+        char* givenname;
+        char* familyname;
+        char* fullname;
+        char* fullname2;
+        before = commandCount( conn, DAPI_COMMAND_ADDRESSBOOKGETNAME );
+        if( !dapi_AddressBookGetNameCached( conn, changed_id, &givenname, &familyname, &fullname ))
+            return 6;
+        free( givenname );
+        free( familyname );
+        if( !dapi_AddressBookGetNameCached( conn, changed_id, &givenname, &familyname, &fullname2 ))
+            return 6;
+        free( givenname );
+        free( familyname );
+        printf( "Changed contact %s: %s\n", changed_id, fullname );
+        if( commandCount( conn, DAPI_COMMAND_ADDRESSBOOKGETNAME ) != before + 1
+            || strcmp( fullname, fullname2 ) != 0 )
+            {
+            fprintf( stderr, "Changed contact not refetched exactly once!\n" );
+            ret = 7;
+            }
+        free( fullname );
+        free( fullname2 );
+        free( changed_id );
+        }
+    for( i = 0;
+         i < ids.count;
+         ++i )
+        free( names[ i ] );
+    free( names );
+    dapi_freestringarr( ids );
+    dapi_close( conn );
+    return ret;
+    }
@@ -0,0 +1,122 @@
+/* Sends several commands in a batch and checks that they are written
+   to the socket at once and that the replies reach their callbacks. Counting
+   the writes works by interposing send(), so it requires glibc. */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+#include <dapi/callbacks.h>
+
+static int sends = 0;
+
+ssize_t send( int fd, const void* buf, size_t len, int flags )
+    {
+    static ssize_t ( *real_send )( int, const void*, size_t, int ) = NULL;
+    if( real_send == NULL )
+        real_send = dlsym( RTLD_NEXT, "send" );
+    ++sends;
+    return real_send( fd, buf, len, flags );
+    }
+
+static int replies = 0;
+static int last_seq = 0;
+static int in_order = 1;
+
+static void gotReply( int seq )
+    {
+    if( seq <= last_seq )
+        in_order = 0;
+    last_seq = seq;
+    ++replies;
+    }
+
+static void capabilitiesCallback( DapiConnection* conn, int seq, intarr capabilities, int ok,
+    void* user_data )
+    {
+    ( void ) conn;
+    ( void ) user_data;
+    printf( "Capabilities: %d, ok %d\n", capabilities.count, ok );
+    gotReply( seq );
+    }
+
+static void buttonOrderCallback( DapiConnection* conn, int seq, int order, void* user_data )
+    {
+    ( void ) conn;
+    ( void ) user_data;
+    printf( "Order: %d\n", order );
+    gotReply( seq );
+    }
+
+static void ownerCallback( DapiConnection* conn, int seq, const char* id, int ok, void* user_data )
+    {
+    ( void ) conn;
+    ( void ) user_data;
+    printf( "Owner: %s, ok %d\n", id, ok );
+    gotReply( seq );
+    }
+
+static int waitReplies( DapiConnection* conn, int count )
+    {
+    int i;
+    for( i = 0;
+         i < 50 && replies < count;
+         ++i )
+        {
+        struct pollfd pfd;
+        pfd.fd = dapi_socket( conn );
+        pfd.events = POLLIN;
+        if( poll( &pfd, 1, 100 ) > 0 )
+            dapi_processData( conn );
+        }
+    return replies == count;
+    }
+
+int main()
+    {
+    int count = 0;
+    int before;
+    int order;
+    DapiConnection* conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    /* what an application may ask for at startup */
+    before = sends;
+    dapi_beginBatch( conn );
+    count += dapi_callbackCapabilities( conn, capabilitiesCallback, NULL ) != 0;
+    count += dapi_callbackButtonOrder( conn, buttonOrderCallback, NULL ) != 0;
+    if( dapi_hasCapability( conn, DAPI_COMMAND_ADDRESSBOOKOWNER ))
+        count += dapi_callbackAddressBookOwner( conn, ownerCallback, NULL ) != 0;
+    if( sends != before || !dapi_endBatch( conn ) || sends != before + 1 )
+        {
+        fprintf( stderr, "Batch not sent at once: %d writes!\n", sends - before );
+        return 2;
+        }
+    if( !waitReplies( conn, count ) || !in_order )
+        {
+        fprintf( stderr, "Replies missing or out of order!\n" );
+        return 3;
+        }
+    /* a blocking call inside a batch sends the batch first */
+    replies = 0;
+    dapi_beginBatch( conn );
+    dapi_callbackButtonOrder( conn, buttonOrderCallback, NULL );
+    order = dapi_ButtonOrder( conn );
+    dapi_endBatch( conn );
+    if( order == 0 || replies != 1 )
+        {
+        fprintf( stderr, "Blocking call in a batch failed!\n" );
+        return 4;
+        }
+    dapi_close( conn );
+    return 0;
+    }
@@ -5,9 +5,10 @@
 #include <dapi/calls.h>
 #include <dapi/callbacks.h>
 
-static void callback( DapiConnection* conn, int seq, int ord )
+static void callback( DapiConnection* conn, int seq, int ord, void* user_data )
     {
-    printf( "Order async: %d %d (%s)\n", seq, ord, ord == 0 ? "Failed" : ord == 1 ? "Ok/Cancel" : "Cancel/Ok" );
+    printf( "Order async: %d %d (%s) [%s]\n", seq, ord, ord == 0 ? "Failed" : ord == 1 ? "Ok/Cancel" : "Cancel/Ok",
+        ( const char* ) user_data );
     }
 
 int main()
@@ -19,9 +20,9 @@ int main()
         fprintf( stderr, "Cannot connect!\n" );
         return 1;
         }
-    seq = dapi_callbackButtonOrder( conn, callback );
+    seq = dapi_callbackButtonOrder( conn, callback, "call1" );
     printf( "Order call1: %d\n", seq );
-    seq = dapi_callbackButtonOrder( conn, callback );
+    seq = dapi_callbackButtonOrder( conn, callback, "call2" );
     printf( "Order call2: %d\n", seq );
     sleep( 1 ); /* give time to process */
     dapi_processData( conn );
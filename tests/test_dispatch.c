@@ -0,0 +1,63 @@
+#include <poll.h>
+#include <stdio.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+#include <dapi/callbacks.h>
+
+static int replies = 0;
+
+static void orderCallback( DapiConnection* conn, int seq, int order, void* user_data )
+    {
+    ( void ) conn;
+    ( void ) user_data;
+    printf( "Reply %d: order %d\n", seq, order );
+    if( order != 0 )
+        ++replies;
+    }
+
+/* Drives the connection like an event loop would, never blocking in the library. */
+int main()
+    {
+    int i;
+    int loops;
+    DapiConnection* conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    /* the calls stay in the output buffer until the event loop finds the socket writable */
+    dapi_beginBatch( conn );
+    for( i = 0;
+         i < 3;
+         ++i )
+        dapi_callbackButtonOrder( conn, orderCallback, NULL );
+    if( !( dapi_watchEvents( conn ) & POLLOUT ))
+        {
+        fprintf( stderr, "Unsent calls not reported!\n" );
+        return 2;
+        }
+    for( loops = 0;
+         loops < 100 && replies < 3;
+         ++loops )
+        {
+        struct pollfd pfd;
+        pfd.fd = dapi_socket( conn );
+        pfd.events = dapi_watchEvents( conn );
+        pfd.revents = 0;
+        if( poll( &pfd, 1, 100 ) > 0 && !dapi_dispatch( conn, pfd.revents ))
+            {
+            fprintf( stderr, "Dispatching failed!\n" );
+            return 3;
+            }
+        }
+    dapi_endBatch( conn );
+    if( replies != 3 || dapi_hasUnsentData( conn ))
+        {
+        fprintf( stderr, "Got %d replies!\n", replies );
+        return 4;
+        }
+    dapi_close( conn );
+    return 0;
+    }
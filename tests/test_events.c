@@ -0,0 +1,122 @@
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+#include <dapi/callbacks.h>
+
+static int hasCapability( DapiConnection* conn, int command )
+    {
+    intarr capabilities;
+    int ret = 0;
+    int i;
+    if( !dapi_Capabilities( conn, &capabilities ))
+        return 0;
+    for( i = 0;
+         i < capabilities.count;
+         ++i )
+        if( capabilities.data[ i ] == command )
+            ret = 1;
+    dapi_freeintarr( capabilities );
+    return ret;
+    }
+
+static int events = 0;
+static int last_suspended = -1;
+
+static void suspendedCallback( DapiConnection* conn, int seq, int suspended, void* user_data )
+    {
+    ( void ) conn;
+    ( void ) user_data;
+    printf( "Event %d: screensaver %s\n", seq, suspended ? "suspended" : "enabled" );
+    ++events;
+    last_suspended = suspended;
+    }
+
+/* Processes incoming data until the expected number of events arrives or the time runs out. */
+static int waitForEvents( DapiConnection* conn, int expected )
+    {
+    int i;
+    for( i = 0;
+         i < 50 && events < expected;
+         ++i )
+        {
+        struct pollfd pfd;
+        pfd.fd = dapi_socket( conn );
+        pfd.events = POLLIN;
+        if( poll( &pfd, 1, 100 ) < 0 )
+            return 0;
+        if( pfd.revents & ( POLLERR | POLLHUP ))
+            return 0;
+        if( pfd.revents & POLLIN )
+            dapi_processData( conn );
+        }
+    return events >= expected;
+    }
+
+int main()
+    {
+    intarr subscribe;
+    int event = DAPI_COMMAND_SCREENSAVERSUSPENDED;
+    DapiConnection* listener;
+    DapiConnection* conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    if( !hasCapability( conn, DAPI_COMMAND_SUBSCRIBE ))
+        {
+        printf( "Event subscriptions not supported by the daemon.\n" );
+        dapi_close( conn );
+        return 0;
+        }
+    listener = dapi_connectAndInit();
+    if( listener == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    subscribe.count = 1;
+    subscribe.data = &event;
+    dapi_setEventCallback( listener, DAPI_COMMAND_SCREENSAVERSUSPENDED, suspendedCallback, NULL );
+    if( !dapi_Subscribe( listener, subscribe ))
+        {
+        fprintf( stderr, "Subscribe failed!\n" );
+        return 2;
+        }
+    if( dapi_ScreensaverSuspended( listener ))
+        {
+        fprintf( stderr, "Screensaver already suspended!\n" );
+        return 3;
+        }
+    /* the result depends on the screensaver, only the state change matters here */
+    dapi_SuspendScreensaving( conn, 1 );
+    if( !waitForEvents( listener, 1 ) || last_suspended != 1 )
+        {
+        fprintf( stderr, "No event after suspending!\n" );
+        return 4;
+        }
+    dapi_SuspendScreensaving( conn, 0 );
+    if( !waitForEvents( listener, 2 ) || last_suspended != 0 )
+        {
+        fprintf( stderr, "No event after resuming!\n" );
+        return 5;
+        }
+    if( hasCapability( conn, DAPI_COMMAND_ADDRESSBOOKCHANGES ))
+        {
+        int generation;
+        stringarr changed;
+        if( !dapi_AddressBookChanges( conn, 0, &generation, &changed ))
+            {
+            fprintf( stderr, "AddressBookChanges failed!\n" );
+            return 6;
+            }
+        printf( "Address book generation %d, %d contacts\n", generation, changed.count );
+        dapi_freestringarr( changed );
+        }
+    dapi_close( listener );
+    dapi_close( conn );
+    return 0;
+    }
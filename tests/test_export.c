@@ -0,0 +1,133 @@
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+#include <dapi/callbacks.h>
+
+static int chunks = 0;
+static int vcards = 0;
+static int errors = 0;
+static int export_count = -1;
+
+static void chunkCallback( DapiConnection* conn, int seq, const char* data, int count, int ok,
+    void* user_data )
+    {
+    const char* pos;
+    int found = 0;
+    ( void ) conn;
+    ( void ) seq;
+    ( void ) user_data;
+    for( pos = data;
+         pos != NULL && ( pos = strstr( pos, "BEGIN:VCARD" )) != NULL;
+         ++pos )
+        ++found;
+    if( !ok || found != count )
+        {
+        fprintf( stderr, "Chunk %d has %d vCards instead of %d!\n", chunks, found, count );
+        ++errors;
+        }
+    ++chunks;
+    vcards += count;
+    }
+
+static void exportCallback( DapiConnection* conn, int seq, int count, int ok, void* user_data )
+    {
+    ( void ) conn;
+    ( void ) seq;
+    ( void ) user_data;
+    export_count = ok ? count : 0;
+    }
+
+/* Exports with a blocking call, the chunks come while it waits for the reply. */
+static int exportBlocking( DapiConnection* conn, stringarr ids, int chunk_size, int expected )
+    {
+    int count;
+    chunks = vcards = 0;
+    if( !dapi_AddressBookExportVCard30( conn, ids, chunk_size, &count ))
+        {
+        fprintf( stderr, "AddressBookExportVCard30 failed!\n" );
+        return 0;
+        }
+    printf( "Exported %d contacts in %d chunks of %d\n", count, chunks, chunk_size );
+    if( count != expected || vcards != expected || errors > 0
+        || ( chunk_size > 0 && chunks != ( expected + chunk_size - 1 ) / chunk_size ))
+        {
+        fprintf( stderr, "Expected %d contacts, received %d!\n", expected, vcards );
+        return 0;
+        }
+    return 1;
+    }
+
+static int exportAsync( DapiConnection* conn, stringarr ids, int expected )
+    {
+    int i;
+    chunks = vcards = 0;
+    if( !dapi_callbackAddressBookExportVCard30( conn, ids, 50, exportCallback, NULL ))
+        return 0;
+    for( i = 0;
+         i < 100 && export_count < 0;
+         ++i )
+        {
+        struct pollfd pfd;
+        pfd.fd = dapi_socket( conn );
+        pfd.events = POLLIN;
+        if( poll( &pfd, 1, 100 ) > 0 )
+            dapi_processData( conn );
+        }
+    printf( "Exported %d contacts asynchronously in %d chunks\n", export_count, chunks );
+    return export_count == expected && vcards == expected && errors == 0;
+    }
+
+int main()
+    {
+    stringarr ids;
+    stringarr some;
+    char* some_ids[ 3 ];
+    int ret = 0;
+    DapiConnection* conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    if( !dapi_hasCapability( conn, DAPI_COMMAND_ADDRESSBOOKEXPORTVCARD30 ))
+        {
+        printf( "Address book export not supported by the daemon.\n" );
+        dapi_close( conn );
+        return 0;
+        }
+    if( !dapi_AddressBookList( conn, &ids ))
+        {
+        fprintf( stderr, "AddressBookList failed!\n" );
+        return 2;
+        }
+    dapi_setVCard30ChunkCallback( conn, chunkCallback, NULL );
+    some.count = 0;
+    some.data = NULL;
+    /* no ids means all contacts */
+    if( !exportBlocking( conn, some, 7, ids.count ))
+        ret = 3;
+    else if( ids.count > 0 )
+        {
+        /* unknown contacts are skipped */
+        some_ids[ 0 ] = ids.data[ 0 ];
+        some_ids[ 1 ] = "no-such-contact";
+        some_ids[ 2 ] = ids.data[ ids.count - 1 ];
+        some.count = 3;
+        some.data = some_ids;
+        if( !exportBlocking( conn, some, 0, ids.count > 1 ? 2 : 1 ) && ids.count > 1 )
+            ret = 4;
+        }
+    some.count = 0;
+    if( ret == 0 && !exportAsync( conn, some, ids.count ))
+        {
+        fprintf( stderr, "Asynchronous export failed!\n" );
+        ret = 5;
+        }
+    dapi_freestringarr( ids );
+    dapi_close( conn );
+    return ret;
+    }
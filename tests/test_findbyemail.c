@@ -0,0 +1,98 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+
+static int contains( stringarr ids, const char* id )
+    {
+    int i;
+    for( i = 0;
+         i < ids.count;
+         ++i )
+        if( strcmp( ids.data[ i ], id ) == 0 )
+            return 1;
+    return 0;
+    }
+
+/* Looks up the email as given and in a different form that must find the same contacts. */
+static int checkEmail( DapiConnection* conn, const char* email, const char* id )
+    {
+    char other[ 512 ];
+    stringarr ids;
+    int i;
+    int len;
+    if( !dapi_AddressBookFindByEmail( conn, email, &ids ) || !contains( ids, id ))
+        {
+        fprintf( stderr, "Contact %s not found by %s!\n", id, email );
+        return 0;
+        }
+    dapi_freestringarr( ids );
+    len = snprintf( other, sizeof( other ), " Somebody <%s> ", email );
+    for( i = 0;
+         i < len;
+         ++i )
+        other[ i ] = toupper(( unsigned char ) other[ i ] );
+    if( !dapi_AddressBookFindByEmail( conn, other, &ids ) || !contains( ids, id ))
+        {
+        fprintf( stderr, "Contact %s not found by %s!\n", id, other );
+        return 0;
+        }
+    dapi_freestringarr( ids );
+    return 1;
+    }
+
+int main()
+    {
+    stringarr ids;
+    stringarr found;
+    int checked = 0;
+    int ret = 0;
+    int i;
+    DapiConnection* conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    if( !dapi_hasCapability( conn, DAPI_COMMAND_ADDRESSBOOKFINDBYEMAIL ))
+        {
+        printf( "AddressBookFindByEmail not supported by the daemon.\n" );
+        dapi_close( conn );
+        return 0;
+        }
+    if( !dapi_AddressBookList( conn, &ids ))
+        {
+        fprintf( stderr, "AddressBookList failed!\n" );
+        return 2;
+        }
+    for( i = 0;
+         i < ids.count && i < 20 && ret == 0;
+         ++i )
+        {
+        stringarr emails;
+        int j;
+        if( !dapi_AddressBookGetEmails( conn, ids.data[ i ], &emails ))
+            continue;
+        for( j = 0;
+             j < emails.count && ret == 0;
+             ++j, ++checked )
+            if( !checkEmail( conn, emails.data[ j ], ids.data[ i ] ))
+                ret = 3;
+        dapi_freestringarr( emails );
+        }
+    found.count = 0;
+    found.data = NULL;
+    if( dapi_AddressBookFindByEmail( conn, "nobody@nowhere.invalid", &found ) || found.count != 0 )
+        {
+        fprintf( stderr, "Unknown email found %d contacts!\n", found.count );
+        ret = 4;
+        }
+    dapi_freestringarr( found );
+    printf( "Checked %d emails\n", checked );
+    dapi_freestringarr( ids );
+    dapi_close( conn );
+    return ret;
+    }
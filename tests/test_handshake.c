@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+
+/* Returns how many times the daemon has processed the command. */
+static int commandCount( DapiConnection* conn, int command )
+    {
+    intarr stats;
+    int pos = 0;
+    int ret = 0;
+    if( !dapi_Stats( conn, &stats ))
+        return -1;
+    while( pos + 8 <= stats.count )
+        {
+        if( stats.data[ pos ] == command )
+            ret = stats.data[ pos + 1 ];
+        pos += 8 + stats.data[ pos + 7 ] * 2;
+        }
+    dapi_freeintarr( stats );
+    return ret;
+    }
+
+int main()
+    {
+    intarr capabilities;
+    DapiConnection* conn2;
+    int has_mailto;
+    int has_stats;
+    int before;
+    int i;
+    int ret = 0;
+    DapiConnection* conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    has_stats = dapi_hasCapability( conn, DAPI_COMMAND_STATS );
+    before = has_stats ? commandCount( conn, DAPI_COMMAND_CAPABILITIES ) : 0;
+    /* the capabilities come with the handshake, without a Capabilities call */
+    conn2 = dapi_connectAndInit();
+    if( conn2 == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    has_mailto = dapi_hasCapability( conn2, DAPI_COMMAND_MAILTO );
+    printf( "Has mailto: %d, has stats: %d\n", has_mailto, has_stats );
+    if( has_stats && dapi_hasCapability( conn, DAPI_COMMAND_HANDSHAKE )
+        && commandCount( conn, DAPI_COMMAND_CAPABILITIES ) != before )
+        {
+        fprintf( stderr, "Capabilities were requested separately!\n" );
+        ret = 2;
+        }
+    dapi_close( conn2 );
+    if( !dapi_Capabilities( conn, &capabilities ))
+        {
+        fprintf( stderr, "Capabilities call failed!\n" );
+        dapi_close( conn );
+        return 3;
+        }
+    for( i = 0;
+         i < capabilities.count;
+         ++i )
+        if( !dapi_hasCapability( conn, capabilities.data[ i ] ))
+            {
+            fprintf( stderr, "Capability %d missing!\n", capabilities.data[ i ] );
+            ret = 4;
+            }
+    if( dapi_hasCapability( conn, -1 ))
+        {
+        fprintf( stderr, "Unknown capability reported!\n" );
+        ret = 5;
+        }
+    dapi_freeintarr( capabilities );
+    dapi_close( conn );
+    return ret;
+    }
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+
+static int hasCapability( DapiConnection* conn, int command )
+    {
+    intarr capabilities;
+    int ret = 0;
+    int i;
+    if( !dapi_Capabilities( conn, &capabilities ))
+        return 0;
+    for( i = 0;
+         i < capabilities.count;
+         ++i )
+        if( capabilities.data[ i ] == command )
+            ret = 1;
+    dapi_freeintarr( capabilities );
+    return ret;
+    }
+
+int main()
+    {
+    char name[] = "/tmp/dapi_test_localfilefdXXXXXX";
+    const char contents[] = "test_localfilefd contents\n";
+    char buf[ 256 ];
+    char* result;
+    int file;
+    int tmp;
+    int len;
+    int ret = 0;
+    DapiConnection* conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    if( !hasCapability( conn, DAPI_COMMAND_LOCALFILEFD ))
+        {
+        printf( "LocalFileFd not supported by the daemon.\n" );
+        dapi_close( conn );
+        return 0;
+        }
+    tmp = mkstemp( name );
+    if( tmp < 0 || write( tmp, contents, strlen( contents )) != ( int ) strlen( contents ))
+        {
+        perror( "mkstemp" );
+        return 1;
+        }
+    close( tmp );
+    if( !dapi_LocalFileFd_Window( conn, name, "", 0, 0, &result, &file ))
+        {
+        fprintf( stderr, "LocalFileFd failed!\n" );
+        unlink( name );
+        return 2;
+        }
+    /* the file stays readable even if it's removed now */
+    unlink( name );
+    len = read( file, buf, sizeof( buf ) - 1 );
+    if( len != ( int ) strlen( contents ) || memcmp( buf, contents, len ) != 0 )
+        {
+        fprintf( stderr, "Wrong file contents!\n" );
+        ret = 3;
+        }
+    printf( "Local file: %s, fd %d\n", result, file );
+    free( result );
+    close( file );
+    result = NULL;
+    if( dapi_LocalFileFd_Window( conn, "/nonexistent/file", "", 0, 0, &result, &file ))
+        {
+        fprintf( stderr, "LocalFileFd succeeded for a nonexistent file!\n" );
+        close( file );
+        ret = 4;
+        }
+    free( result );
+    dapi_close( conn );
+    return ret;
+    }
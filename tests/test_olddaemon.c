@@ -0,0 +1,115 @@
+/* Connects to a daemon from before Handshake, emulated by a child process
+   in a temporary $HOME and $XDG_RUNTIME_DIR. Such a daemon reads one header
+   at a time, skips only the header of commands it doesn't know and closes
+   the connection when a message doesn't start with the magic, so the client
+   must connect again without Handshake. */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+
+enum { MAGIC_V1 = 0x152355 };
+
+static int readAll( int sock, void* data, int size )
+    {
+    int done = 0;
+    while( done < size )
+        {
+        int len = read( sock, ( char* ) data + done, size - done );
+        if( len <= 0 )
+            return 0;
+        done += len;
+        }
+    return 1;
+    }
+
+/* Replies only to Init and ButtonOrder, which carry no arguments. */
+static void runOldDaemon( int listen_sock )
+    {
+    for(;;)
+        {
+        int header[ 3 ];
+        int sock = accept( listen_sock, NULL, NULL );
+        if( sock < 0 )
+            _exit( 1 );
+        while( readAll( sock, header, sizeof( header )) && header[ 0 ] == MAGIC_V1 )
+            {
+            int reply[ 4 ];
+            if( header[ 1 ] != DAPI_COMMAND_INIT && header[ 1 ] != DAPI_COMMAND_BUTTONORDER )
+                continue;
+            reply[ 0 ] = MAGIC_V1;
+            reply[ 1 ] = header[ 1 ] + 1;
+            reply[ 2 ] = header[ 2 ];
+            reply[ 3 ] = 1; /* ok or the button order */
+            if( write( sock, reply, sizeof( reply )) != sizeof( reply ))
+                break;
+            }
+        close( sock );
+        }
+    }
+
+int main()
+    {
+    char home[] = "/tmp/dapi_test_olddaemonXXXXXX";
+    char hostname[ 256 ];
+    char sock_file[ 1024 ];
+    char lock_file[ 1100 ];
+    DapiConnection* conn;
+    int sock;
+    int pid;
+    int ret = 0;
+    if( mkdtemp( home ) == NULL )
+        {
+        perror( "mkdtemp" );
+        return 1;
+        }
+    setenv( "HOME", home, 1 );
+    setenv( "XDG_RUNTIME_DIR", home, 1 );
+    setenv( "DISPLAY", ":7", 1 );
+    setenv( "DAPI_DAEMON", "", 1 );
+    gethostname( hostname, sizeof( hostname ));
+    hostname[ sizeof( hostname ) - 1 ] = '\0';
+    snprintf( sock_file, sizeof( sock_file ), "%s/dapi-%s:7", home, hostname );
+    snprintf( lock_file, sizeof( lock_file ), "%s.lock", sock_file );
+    sock = dapi_bindSocket();
+    if( sock < 0 || fcntl( sock, F_SETFL, fcntl( sock, F_GETFL ) & ~O_NONBLOCK ) < 0 )
+        {
+        fprintf( stderr, "Cannot bind the socket!\n" );
+        rmdir( home );
+        return 1;
+        }
+    pid = fork();
+    if( pid == 0 )
+        runOldDaemon( sock );
+    close( sock );
+    conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect to the old daemon!\n" );
+        ret = 2;
+        }
+    else
+        {
+        int ord = dapi_ButtonOrder( conn );
+        printf( "Old daemon: protocol version %d, order %d\n", dapi_protocolVersion( conn ), ord );
+        if( dapi_protocolVersion( conn ) != 1 || ord != 1 )
+            ret = 3;
+        dapi_close( conn );
+        }
+    kill( pid, SIGTERM );
+    waitpid( pid, NULL, 0 );
+    unlink( sock_file );
+    unlink( lock_file );
+    if( rmdir( home ) < 0 )
+        perror( "rmdir" );
+    return ret;
+    }
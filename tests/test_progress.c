@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+#include <dapi/callbacks.h>
+
+static int hasCapability( DapiConnection* conn, int command )
+    {
+    intarr capabilities;
+    int ret = 0;
+    int i;
+    if( !dapi_Capabilities( conn, &capabilities ))
+        return 0;
+    for( i = 0;
+         i < capabilities.count;
+         ++i )
+        if( capabilities.data[ i ] == command )
+            ret = 1;
+    dapi_freeintarr( capabilities );
+    return ret;
+    }
+
+static int notifications = 0;
+static long long last_processed = -1;
+static int errors = 0;
+
+static void progressCallback( DapiConnection* conn, int seq, const char* file, long long processed,
+    long long total, long long readable, int ok, void* user_data )
+    {
+    ( void ) conn;
+    ( void ) user_data;
+    printf( "Progress %d: %s %lld/%lld, readable %lld\n", seq, file != NULL ? file : "", processed,
+        total, readable );
+    ++notifications;
+    if( !ok || processed < last_processed || ( total > 0 && processed > total ) || readable > processed )
+        ++errors;
+    last_processed = processed;
+    }
+
+int main()
+    {
+    char* result;
+    int ret = 0;
+    DapiConnection* conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    if( !hasCapability( conn, DAPI_COMMAND_PROGRESSNOTIFICATIONS ))
+        {
+        printf( "Progress notifications not supported by the daemon.\n" );
+        dapi_close( conn );
+        return 0;
+        }
+    dapi_setProgressCallback( conn, progressCallback, NULL );
+    if( !dapi_ProgressNotifications( conn, 100 ))
+        {
+        fprintf( stderr, "ProgressNotifications failed!\n" );
+        return 2;
+        }
+    /* notifications come while the blocking call waits for its reply */
+    result = dapi_LocalFile_Window( conn, "http://www.example.com/big.iso", "", 1, 0 );
+    printf( "Download: %s, %d notifications\n", result != NULL ? result : "(failed)", notifications );
+    if( result != NULL )
+        dapi_RemoveTemporaryLocalFile( conn, result );
+    free( result );
+    if( errors > 0 )
+        {
+        fprintf( stderr, "Invalid progress notifications!\n" );
+        ret = 3;
+        }
+    dapi_close( conn );
+    return ret;
+    }
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+
+/* Writes messages in the given encoding over an in-memory connection and checks
+   that they are read back unchanged. */
+static int roundTrip( int version )
+    {
+    DapiConnection* conn = dapi_memoryConnection();
+    DapiWindowInfo winfo;
+    DapiWindowInfo winfo2;
+    intarr stats;
+    intarr stats2;
+    int values[] = { 0, 1, -1, 127, 128, -129, 0x7fffffff, -0x7fffffff - 1 };
+    char* remote;
+    char* local;
+    char* result;
+    int allow_download;
+    int command, seq;
+    int file;
+    int ok;
+    int ret = 1;
+    if( conn == NULL )
+        return 0;
+    dapi_setProtocolVersion( conn, version );
+    dapi_windowInfoInitWindow( &winfo, ( long ) 0x7654321 );
+    if( !dapi_writeCommandLocalFile( conn, "http://www.example.com/", "", 1, winfo )
+        || !dapi_hasCommand( conn ) || !dapi_readCommand( conn, &command, &seq )
+        || command != DAPI_COMMAND_LOCALFILE
+        || !dapi_readCommandLocalFile( conn, &remote, &local, &allow_download, &winfo2 ))
+        {
+        dapi_close( conn );
+        return 0;
+        }
+    if( strcmp( remote, "http://www.example.com/" ) != 0 || strcmp( local, "" ) != 0
+        || allow_download != 1 || winfo2.flags != winfo.flags || winfo2.window != winfo.window )
+        ret = 0;
+    free( remote );
+    free( local );
+    stats.count = sizeof( values ) / sizeof( values[ 0 ] );
+    stats.data = values;
+    dapi_writeReplyStats( conn, 5, stats, 1 );
+    if( !dapi_hasCommand( conn ) || !dapi_readCommand( conn, &command, &seq )
+        || command != DAPI_REPLY_STATS || seq != 5 || !dapi_readReplyStats( conn, &stats2, &ok ))
+        {
+        dapi_close( conn );
+        return 0;
+        }
+    if( !ok || stats2.count != stats.count
+        || memcmp( stats2.data, stats.data, stats.count * sizeof( int )) != 0 )
+        ret = 0;
+    dapi_freeintarr( stats2 );
+    /* two bools, with a descriptor and without one */
+    dapi_writeReplyLocalFileFd( conn, 6, "/tmp/file", STDIN_FILENO, 1 );
+    dapi_writeReplyLocalFileFd( conn, 7, "", -1, 0 );
+    for( seq = 6;
+         seq <= 7;
+         ++seq )
+        {
+        int seq2;
+        if( !dapi_hasCommand( conn ) || !dapi_readCommand( conn, &command, &seq2 )
+            || seq2 != seq || !dapi_readReplyLocalFileFd( conn, &result, &file, &ok ))
+            {
+            dapi_close( conn );
+            return 0;
+            }
+        if( ok != ( seq == 6 ) || ( file >= 0 ) != ( seq == 6 ))
+            ret = 0;
+        if( file >= 0 )
+            close( file );
+        free( result );
+        }
+    dapi_close( conn );
+    return ret;
+    }
+
+int main()
+    {
+    DapiConnection* conn;
+    int version;
+    int ret = 0;
+    if( !roundTrip( 1 ) || !roundTrip( 2 ))
+        {
+        fprintf( stderr, "Messages changed when read back!\n" );
+        return 2;
+        }
+    conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    version = dapi_protocolVersion( conn );
+    printf( "Protocol version: %d\n", version );
+    /* older daemons may know Handshake but not the newest version */
+    if( version < 1 || version > DAPI_PROTOCOL_VERSION
+        || ( !dapi_hasCapability( conn, DAPI_COMMAND_HANDSHAKE ) && version != 1 ))
+        {
+        fprintf( stderr, "Invalid protocol version!\n" );
+        ret = 3;
+        }
+    if( dapi_ButtonOrder( conn ) == 0 )
+        {
+        fprintf( stderr, "Call failed after the handshake!\n" );
+        ret = 4;
+        }
+    dapi_close( conn );
+    return ret;
+    }
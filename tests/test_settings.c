@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+
+static const char* const keys[] =
+    {
+    "Dapi/ButtonOrder",
+    "Net/DoubleClickTime",
+    "Net/ThemeName",
+    "Net/IconThemeName",
+    "Gtk/FontName",
+    "Dapi/NoSuchSetting"
+    };
+
+int main()
+    {
+    stringarr request;
+    stringarr values;
+    int count = sizeof( keys ) / sizeof( keys[ 0 ] );
+    int ret = 0;
+    int i;
+    DapiConnection* conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    if( !dapi_hasCapability( conn, DAPI_COMMAND_GETSETTINGS ))
+        {
+        printf( "GetSettings not supported by the daemon.\n" );
+        dapi_close( conn );
+        return 0;
+        }
+    request.count = count;
+    request.data = ( char** ) keys;
+    if( !dapi_GetSettings( conn, request, &values ))
+        {
+        fprintf( stderr, "GetSettings failed!\n" );
+        dapi_close( conn );
+        return 2;
+        }
+    if( values.count != count )
+        {
+        fprintf( stderr, "Got %d values for %d keys!\n", values.count, count );
+        ret = 3;
+        }
+    else if( atoi( values.data[ 0 ] ) != dapi_ButtonOrder( conn ))
+        {
+        fprintf( stderr, "Button order differs: %s\n", values.data[ 0 ] );
+        ret = 4;
+        }
+    else if( values.data[ count - 1 ][ 0 ] != '\0' )
+        {
+        fprintf( stderr, "Unknown setting has a value: %s\n", values.data[ count - 1 ] );
+        ret = 5;
+        }
+    for( i = 0;
+         i < values.count && i < count;
+         ++i )
+        printf( "%s: %s\n", keys[ i ], values.data[ i ] );
+    dapi_freestringarr( values );
+    /* no keys, no values */
+    request.count = 0;
+    if( !dapi_GetSettings( conn, request, &values ) || values.count != 0 )
+        {
+        fprintf( stderr, "GetSettings without keys failed!\n" );
+        ret = 6;
+        }
+    else
+        dapi_freestringarr( values );
+    dapi_close( conn );
+    return ret;
+    }
@@ -0,0 +1,179 @@
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+#include <dapi/callbacks.h>
+#include <dapi/addressbook.h>
+
+static void* getShared( void* arg )
+    {
+    *( DapiConnection** ) arg = dapi_sharedConnection();
+    return NULL;
+    }
+
+/* Both processes (or threads) make calls at the same time, with a shared socket
+   they would get each other's replies. */
+static int makeCalls( DapiConnection* conn )
+    {
+    int i;
+    for( i = 0;
+         i < 1000;
+         ++i )
+        if( dapi_ButtonOrder( conn ) == 0 )
+            return 0;
+    return 1;
+    }
+
+static void* makeCallsThread( void* arg )
+    {
+    return makeCalls(( DapiConnection* ) arg ) ? arg : NULL;
+    }
+
+static int change_events = 0;
+static volatile int reading_cache;
+
+static void changesCallback( DapiConnection* conn, int seq, int generation, stringarr changed,
+    int ok, void* user_data )
+    {
+    ++change_events;
+    }
+
+/* Reads all the names from the cache, while the main thread dispatches
+   the events changing it (with dapi_fake -t). */
+static void* readCacheThread( void* arg )
+    {
+    DapiConnection* conn = arg;
+    void* ret = arg;
+    int i;
+    for( i = 0;
+         i < 200 && ret != NULL;
+         ++i )
+        {
+        stringarr ids;
+        int j;
+        if( !dapi_AddressBookListCached( conn, &ids ))
+            {
+            ret = NULL;
+            break;
+            }
+        for( j = 0;
+             j < ids.count;
+             ++j )
+            {
+            char* givenname;
+            char* familyname;
+            char* fullname;
+            if( !dapi_AddressBookGetNameCached( conn, ids.data[ j ], &givenname, &familyname, &fullname ))
+                {
+                ret = NULL;
+                break;
+                }
+            free( givenname );
+            free( familyname );
+            free( fullname );
+            }
+        dapi_freestringarr( ids );
+        }
+    reading_cache = 0;
+    return ret;
+    }
+
+static int testCacheThreads( DapiConnection* conn )
+    {
+    pthread_t thread;
+    void* thread_ret;
+    if( !dapi_enableAddressBookCache( conn ))
+        {
+        printf( "Address book cache not supported by the daemon.\n" );
+        return 1;
+        }
+    dapi_setEventCallback( conn, DAPI_COMMAND_ADDRESSBOOKCHANGES, changesCallback, NULL );
+    reading_cache = 1;
+    pthread_create( &thread, NULL, readCacheThread, conn );
+    while( reading_cache )
+        {
+        struct pollfd pfd;
+        pfd.fd = dapi_socket( conn );
+        pfd.events = POLLIN;
+        if( poll( &pfd, 1, 10 ) > 0 )
+            dapi_dispatch( conn, pfd.revents );
+        }
+    pthread_join( thread, &thread_ret );
+    printf( "Cache read while dispatching %d change events\n", change_events );
+    return thread_ret != NULL;
+    }
+
+int main()
+    {
+    DapiConnection* conn;
+    DapiConnection* conn2;
+    DapiConnection* thread_conn;
+    pthread_t thread;
+    void* thread_ret;
+    int pid;
+    int status;
+    conn = dapi_sharedConnection();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    pthread_create( &thread, NULL, getShared, &thread_conn );
+    pthread_join( thread, NULL );
+    conn2 = dapi_sharedConnection();
+    if( conn2 != conn || thread_conn != conn )
+        {
+        fprintf( stderr, "Shared connection not reused!\n" );
+        return 2;
+        }
+    dapi_close( conn2 );
+    dapi_close( thread_conn );
+    /* still referenced once */
+    if( dapi_ButtonOrder( conn ) == 0 )
+        {
+        fprintf( stderr, "Shared connection closed too early!\n" );
+        return 3;
+        }
+    pid = fork();
+    if( pid == 0 )
+        _exit( makeCalls( conn ) ? 0 : 1 );
+    if( !makeCalls( conn ))
+        {
+        fprintf( stderr, "Calls in the parent failed!\n" );
+        return 4;
+        }
+    waitpid( pid, &status, 0 );
+    if( !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+        {
+        fprintf( stderr, "Calls in the child failed!\n" );
+        return 5;
+        }
+    /* calls on the shared connection from several threads take turns */
+    pthread_create( &thread, NULL, makeCallsThread, conn );
+    if( !makeCalls( conn ))
+        {
+        fprintf( stderr, "Calls in the main thread failed!\n" );
+        return 6;
+        }
+    pthread_join( thread, &thread_ret );
+    if( thread_ret == NULL )
+        {
+        fprintf( stderr, "Calls in the thread failed!\n" );
+        return 7;
+        }
+    /* the address book cache is shared by the threads too */
+    if( !testCacheThreads( conn ))
+        {
+        fprintf( stderr, "Cache lookups in the thread failed!\n" );
+        return 8;
+        }
+    printf( "Shared connection: order %d\n", dapi_ButtonOrder( conn ));
+    dapi_close( conn );
+    return 0;
+    }
@@ -0,0 +1,107 @@
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+#include <dapi/callbacks.h>
+
+static int compare( stringarr a, stringarr b )
+    {
+    int i;
+    if( a.count != b.count )
+        return 0;
+    for( i = 0;
+         i < a.count;
+         ++i )
+        if( strcmp( a.data[ i ], b.data[ i ] ) != 0 )
+            return 0;
+    return 1;
+    }
+
+static int async_done = 0;
+
+static void listCallback( DapiConnection* conn, int seq, stringarr ids, int ok, void* user_data )
+    {
+    ( void ) conn;
+    ( void ) seq;
+    async_done = ok && compare( *( const stringarr* ) user_data, ids ) ? 1 : -1;
+    }
+
+static int hasCapability( DapiConnection* conn, int command )
+    {
+    intarr capabilities;
+    int ret = 0;
+    int i;
+    if( !dapi_Capabilities( conn, &capabilities ))
+        return 0;
+    for( i = 0;
+         i < capabilities.count;
+         ++i )
+        if( capabilities.data[ i ] == command )
+            ret = 1;
+    dapi_freeintarr( capabilities );
+    return ret;
+    }
+
+int main()
+    {
+    stringarr plain_ids;
+    stringarr shared_ids;
+    int ret = 0;
+    DapiConnection* plain = dapi_connectAndInit();
+    DapiConnection* shared = dapi_connectAndInit();
+    if( plain == NULL || shared == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    if( !hasCapability( plain, DAPI_COMMAND_ADDRESSBOOKLIST ) || !dapi_enableSharedMemory( shared, 1024 ))
+        {
+        printf( "Shared memory or address book not supported by the daemon.\n" );
+        dapi_close( plain );
+        dapi_close( shared );
+        return 0;
+        }
+    if( !dapi_AddressBookList( plain, &plain_ids ) || !dapi_AddressBookList( shared, &shared_ids ))
+        {
+        fprintf( stderr, "AddressBookList failed!\n" );
+        return 2;
+        }
+    printf( "Contacts: %d\n", shared_ids.count );
+    if( !compare( plain_ids, shared_ids ))
+        {
+        fprintf( stderr, "Replies differ!\n" );
+        ret = 3;
+        }
+    /* small replies are still passed inline */
+    if( dapi_ButtonOrder( shared ) == 0 )
+        {
+        fprintf( stderr, "ButtonOrder failed!\n" );
+        ret = 4;
+        }
+    if( dapi_callbackAddressBookList( shared, listCallback, &plain_ids ) == 0 )
+        {
+        fprintf( stderr, "Async AddressBookList failed!\n" );
+        return 5;
+        }
+    while( async_done == 0 )
+        {
+        struct pollfd pfd;
+        pfd.fd = dapi_socket( shared );
+        pfd.events = POLLIN;
+        if( poll( &pfd, 1, -1 ) < 0 || ( pfd.revents & ( POLLERR | POLLHUP )))
+            break;
+        dapi_processData( shared );
+        }
+    if( async_done <= 0 )
+        {
+        fprintf( stderr, "Async reply differs!\n" );
+        ret = 6;
+        }
+    dapi_freestringarr( plain_ids );
+    dapi_freestringarr( shared_ids );
+    dapi_close( plain );
+    dapi_close( shared );
+    return ret;
+    }
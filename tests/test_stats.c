@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+
+/* Returns the lower bound of the bucket containing the given fraction of all calls. */
+static int percentile( const int* buckets, int nbuckets, int count, double fraction )
+    {
+    int sum = 0;
+    int i;
+    for( i = 0;
+         i < nbuckets;
+         ++i )
+        {
+        sum += buckets[ i * 2 + 1 ];
+        if( sum >= count * fraction )
+            return dapi_statsBucketValue( buckets[ i * 2 ] );
+        }
+    return 0;
+    }
+
+static long long bytes( const int* data )
+    {
+    return ( unsigned int ) data[ 0 ] | ( long long ) data[ 1 ] << 32;
+    }
+
+int main()
+    {
+    intarr stats;
+    int i;
+    int pos;
+    int ret = 0;
+    DapiConnection* conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    for( i = 0;
+         i < 100;
+         ++i )
+        dapi_ButtonOrder( conn );
+    /* the daemon doesn't reply to this one, so it must not show up as in flight */
+    dapi_writeCommandAddressBookVCard30Chunk( conn );
+    if( !dapi_Stats( conn, &stats ))
+        {
+        fprintf( stderr, "Stats call failed!\n" );
+        dapi_close( conn );
+        return 2;
+        }
+    printf( "Command  Count  InFlight  BytesIn  BytesOut  p50(us)  p99(us)\n" );
+    pos = 0;
+    while( pos + 8 <= stats.count )
+        {
+        int command = stats.data[ pos ];
+        int count = stats.data[ pos + 1 ];
+        int nbuckets = stats.data[ pos + 7 ];
+        const int* buckets = stats.data + pos + 8;
+        if( pos + 8 + nbuckets * 2 > stats.count )
+            break;
+        if( command == DAPI_COMMAND_ADDRESSBOOKVCARD30CHUNK )
+            {
+            fprintf( stderr, "Command without a reply counted!\n" );
+            ret = 3;
+            }
+        printf( "%7d %6d %9d %8lld %9lld %8d %8d\n", command, count, stats.data[ pos + 2 ],
+            bytes( stats.data + pos + 3 ), bytes( stats.data + pos + 5 ),
+            percentile( buckets, nbuckets, count, 0.5 ), percentile( buckets, nbuckets, count, 0.99 ));
+        pos += 8 + nbuckets * 2;
+        }
+    dapi_freeintarr( stats );
+    dapi_close( conn );
+    return ret;
+    }
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <dapi/comm.h>
+#include <dapi/calls.h>
+#include <dapi/callbacks.h>
+
+static void callback( DapiConnection* conn, int seq, int ord, void* user_data )
+    {
+    printf( "Cancelled call %d got a reply!\n", seq );
+    }
+
+/* A ButtonOrder reply in protocol version 1, which is used without Handshake. */
+static void buttonOrderReply( int data[ 4 ], int seq, int ord )
+    {
+    data[ 0 ] = 0x152355; /* magic */
+    data[ 1 ] = DAPI_REPLY_BUTTONORDER;
+    data[ 2 ] = seq;
+    data[ 3 ] = ord;
+    }
+
+/* The reply to the first call arrives only partly before the timeout and the rest
+   comes later, the next call must still get its own reply. */
+static int testLateReply( void )
+    {
+    int data[ 8 ];
+    int ord;
+    int ok;
+    int sv[ 2 ];
+    DapiConnection* conn;
+    if( socketpair( PF_UNIX, SOCK_STREAM, 0, sv ) < 0 )
+        return 0;
+    conn = dapi_socketConnection( sv[ 0 ] );
+    if( conn == NULL )
+        return 0;
+    dapi_setTimeout( conn, 200 );
+    buttonOrderReply( data, 1, 2 );
+    buttonOrderReply( data + 4, 2, 1 );
+    ok = write( sv[ 1 ], data, 10 ) == 10;
+    ord = dapi_ButtonOrder( conn );
+    if( ord != 0 )
+        {
+        printf( "Late reply: the call did not time out\n" );
+        ok = 0;
+        }
+    ok = ok && write( sv[ 1 ], ( char* ) data + 10, sizeof( data ) - 10 ) == sizeof( data ) - 10;
+    ord = dapi_ButtonOrder( conn );
+    printf( "Late reply: order %d (%s)\n", ord, ord == 1 ? "Ok" : "Failed" );
+    dapi_close( conn );
+    close( sv[ 1 ] );
+    return ok && ord == 1;
+    }
+
+static void progress( DapiConnection* conn, int seq, const char* file, long long processed,
+    long long total, long long readable, int ok, void* user_data )
+    {
+    printf( "Progress of call %d passed on after it was given up!\n", seq );
+    ++*( int* ) user_data;
+    }
+
+/* Replies and progress notifications for a cancelled and a timed out call
+   arrive only later, they must all be dropped. */
+static int testDroppedReplies( void )
+    {
+    int ord;
+    int seq;
+    int ok = 1;
+    int progress_count = 0;
+    int sv[ 2 ];
+    DapiConnection* conn;
+    DapiConnection* peer;
+    if( socketpair( PF_UNIX, SOCK_STREAM, 0, sv ) < 0 )
+        return 0;
+    conn = dapi_socketConnection( sv[ 0 ] );
+    peer = dapi_socketConnection( sv[ 1 ] );
+    if( conn == NULL || peer == NULL )
+        return 0;
+    dapi_setTimeout( conn, 200 );
+    dapi_setProgressCallback( conn, progress, &progress_count );
+    seq = dapi_callbackButtonOrder( conn, callback, NULL );
+    if( !dapi_cancel( conn, seq ) || dapi_cancel( conn, seq ))
+        {
+        printf( "Dropped replies: cancelling failed\n" );
+        ok = 0;
+        }
+    if( dapi_ButtonOrder( conn ) != 0 )
+        {
+        printf( "Dropped replies: the call did not time out\n" );
+        ok = 0;
+        }
+    dapi_writeReplyTransferProgress( peer, seq, "", 1, 2, 1, 1 );
+    dapi_writeReplyButtonOrder( peer, seq, 2 );
+    dapi_writeReplyTransferProgress( peer, seq + 1, "", 1, 2, 1, 1 );
+    dapi_writeReplyButtonOrder( peer, seq + 1, 2 );
+    dapi_writeReplyButtonOrder( peer, seq + 2, 1 );
+    ord = dapi_ButtonOrder( conn );
+    printf( "Dropped replies: order %d (%s)\n", ord, ord == 1 && progress_count == 0 ? "Ok" : "Failed" );
+    dapi_close( conn );
+    dapi_close( peer );
+    return ok && ord == 1 && progress_count == 0;
+    }
+
+static void nestedCall( DapiConnection* conn, int seq, int ord, void* user_data )
+    {
+    /* a longer timeout must not extend the deadline of the call waiting outside */
+    dapi_setTimeout( conn, 5000 );
+    *( int* ) user_data = dapi_ButtonOrder( conn );
+    dapi_setTimeout( conn, 200 );
+    }
+
+/* A blocking call made from a callback run while another call waits for its reply
+   gets no reply, both must give up at the deadline of the outer call. */
+static int testNestedCall( void )
+    {
+    int ord;
+    int seq;
+    int nested = -1;
+    int sv[ 2 ];
+    time_t start;
+    int elapsed;
+    DapiConnection* conn;
+    DapiConnection* peer;
+    if( socketpair( PF_UNIX, SOCK_STREAM, 0, sv ) < 0 )
+        return 0;
+    conn = dapi_socketConnection( sv[ 0 ] );
+    peer = dapi_socketConnection( sv[ 1 ] );
+    if( conn == NULL || peer == NULL )
+        return 0;
+    dapi_setTimeout( conn, 200 );
+    seq = dapi_callbackButtonOrder( conn, nestedCall, &nested );
+    dapi_writeReplyButtonOrder( peer, seq, 1 );
+    start = time( NULL );
+    alarm( 5 ); /* without a deadline the outer call would wait forever */
+    ord = dapi_ButtonOrder( conn );
+    alarm( 0 );
+    elapsed = time( NULL ) - start;
+    printf( "Nested call: %s\n", ord == 0 && nested == 0 && elapsed < 3 ? "Ok" : "Failed" );
+    dapi_close( conn );
+    dapi_close( peer );
+    return ord == 0 && nested == 0 && elapsed < 3;
+    }
+
+int main()
+    {
+    int seq;
+    int ord;
+    DapiConnection* conn = dapi_connectAndInit();
+    if( conn == NULL )
+        {
+        fprintf( stderr, "Cannot connect!\n" );
+        return 1;
+        }
+    dapi_setTimeout( conn, 1000 );
+    seq = dapi_callbackButtonOrder( conn, callback, NULL );
+    printf( "Cancel %d: %s\n", seq, dapi_cancel( conn, seq ) ? "Ok" : "Failed" );
+    /* the reply to the cancelled call arrives first and is discarded */
+    ord = dapi_ButtonOrder( conn );
+    printf( "Order: %d (%s)\n", ord, ord == 0 ? "Failed or timed out" : ord == 1 ? "Ok/Cancel" : "Cancel/Ok" );
+    dapi_processData( conn );
+    dapi_close( conn );
+    return testLateReply() && testDroppedReplies() && testNestedCall() ? 0 : 1;
+    }